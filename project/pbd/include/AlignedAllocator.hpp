@@ -0,0 +1,125 @@
+#pragma once
+
+#include "AllocationCounter.hpp"
+#include "Arena.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+namespace pbd
+{
+    //std::allocator replacement that hands out storage aligned to Alignment
+    //bytes, so solver arrays start on a cache line and can be loaded with
+    //aligned SIMD instructions. Given an arena it takes the storage from
+    //there while it lasts and from the heap after that. Arrays moved or
+    //swapped keep their arena; copies go to the heap, so a copy never ends
+    //up in an arena that dies before it.
+    template <typename T, std::size_t Alignment = 64>
+    class AlignedAllocator
+    {
+    public:
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::false_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        template <typename U>
+        struct rebind
+        {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        AlignedAllocator() = default;
+
+        explicit AlignedAllocator(Arena* arena) :
+            mArena(arena)
+        {}
+
+        template <typename U>
+        AlignedAllocator(AlignedAllocator<U, Alignment> const& other) :
+            mArena(other.arena())
+        {}
+
+        AlignedAllocator select_on_container_copy_construction() const
+        {
+            return AlignedAllocator();
+        }
+
+        Arena* arena() const
+        {
+            return mArena;
+        }
+
+        T* allocate(std::size_t n)
+        {
+            if (n == 0)
+            {
+                return nullptr;
+            }
+
+            std::size_t bytes = n * sizeof(T);
+            if (mArena)
+            {
+                void* ptr = mArena->allocate(bytes, Alignment);
+                if (ptr)
+                {
+                    return static_cast<T*>(ptr);
+                }
+            }
+#if defined(_MSC_VER)
+            void* ptr = _aligned_malloc(bytes, Alignment);
+#else
+            void* ptr = nullptr;
+            if (posix_memalign(&ptr, Alignment, bytes) != 0)
+            {
+                ptr = nullptr;
+            }
+#endif
+            if (!ptr)
+            {
+                throw std::bad_alloc();
+            }
+            countAllocation();
+            return static_cast<T*>(ptr);
+        }
+
+        void deallocate(T* ptr, std::size_t n)
+        {
+            if (mArena && mArena->owns(ptr))
+            {
+                mArena->release(ptr, n * sizeof(T));
+                return;
+            }
+#if defined(_MSC_VER)
+            _aligned_free(ptr);
+#else
+            std::free(ptr);
+#endif
+        }
+
+    private:
+        Arena* mArena = nullptr;
+    };
+
+    template <typename T, typename U, std::size_t A>
+    bool operator==(AlignedAllocator<T, A> const& a, AlignedAllocator<U, A> const& b)
+    {
+        return a.arena() == b.arena();
+    }
+
+    template <typename T, typename U, std::size_t A>
+    bool operator!=(AlignedAllocator<T, A> const& a, AlignedAllocator<U, A> const& b)
+    {
+        return a.arena() != b.arena();
+    }
+
+    using FloatArray = std::vector<float, AlignedAllocator<float>>;
+    using IntArray = std::vector<int, AlignedAllocator<int>>;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+namespace pbd
+{
+    //number of heap allocations made by the process so far. AlignedAllocator
+    //counts its own; plain operator new is only counted in the headless
+    //tools, which link a replacement (CountingNew.cpp) so they can check
+    //that stepping does not allocate. The library leaves operator new alone.
+    std::size_t allocationCount();
+    void countAllocation();
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+namespace pbd
+{
+    //bump allocator over one block of memory, either its own or a slice of
+    //a larger block someone else owns (see ClothBatch). Allocations are
+    //carved off the end in order and only come back all together when the
+    //arena goes away; release() takes back just the latest one, so an
+    //array growing at the end of the block wastes nothing. When the block
+    //is full allocate() returns nullptr and counts the bytes it turned
+    //away, and AlignedAllocator falls back to the heap. An arena is not
+    //thread-safe, it belongs to whatever it is sized for.
+    class Arena
+    {
+    public:
+        //a block of its own of bytes, aligned to kArenaAlignment
+        explicit Arena(std::size_t bytes);
+        //a slice of someone else's block, which has to outlive the arena
+        Arena(void* block, std::size_t bytes);
+        ~Arena();
+
+        Arena(Arena const&) = delete;
+        Arena& operator=(Arena const&) = delete;
+
+        //bytes from the block starting on a multiple of alignment (a power
+        //of two), or nullptr when they do not fit
+        void* allocate(std::size_t bytes, std::size_t alignment);
+        //gives the memory back if it is the latest allocation
+        void release(void* ptr, std::size_t bytes);
+        bool owns(void const* ptr) const;
+
+        std::size_t capacity() const;
+        std::size_t used() const;
+        //bytes asked for that did not fit
+        std::size_t overflow() const;
+
+    private:
+        char* mBlock;
+        std::size_t mCapacity;
+        std::size_t mUsed = 0;
+        std::size_t mOverflow = 0;
+        bool mOwned;
+    };
+
+    //alignment of an arena's own block and of the arrays in it
+    const std::size_t kArenaAlignment = 64;
+
+    //bytes an arena needs for an allocation of bytes, which start on a
+    //cache line
+    std::size_t arenaBytes(std::size_t bytes);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "AlignedAllocator.hpp"
+#include "Vector3.hpp"
+
+#include <vector>
+
+namespace pbd
+{
+    struct Aabb
+    {
+        Vector3 min;
+        Vector3 max;
+    };
+
+    //bounding volume hierarchy over a static triangle mesh, built top down
+    //with a binned surface area heuristic. Nodes live in one flat array with
+    //the two children of an inner node next to each other.
+    class Bvh
+    {
+    public:
+        void build(std::vector<Vector3> const& vertices,
+            std::vector<unsigned int> const& indices);
+
+        //appends to out the triangles whose bounds overlap box. The solver
+        //calls this once for the bounds of a whole batch of particles and
+        //then tests the batch against the short candidate list.
+        void query(Aabb const& box, IntArray& out) const;
+
+        bool empty() const;
+
+    private:
+        struct Node
+        {
+            Aabb bounds;
+            //first triangle for a leaf, left child for an inner node
+            int leftFirst;
+            //triangles in a leaf, 0 for an inner node
+            int count;
+        };
+
+        void subdivide(int node, int depth, std::vector<Aabb> const& triBounds,
+            std::vector<Vector3> const& centroids);
+
+        std::vector<Node> mNodes;
+        std::vector<int> mTriangles;
+    };
+}
@@ -1,47 +1,155 @@
 #pragma once
 
-#include "Particle.hpp"
+#include "Scene.hpp"
+#include "SimCache.hpp"
+#include "SimulationThread.hpp"
+#include "Solver.hpp"
+#include "SurfaceMesh.hpp"
+#include "ThreadPool.hpp"
 
 #include <atlas/utils/Geometry.hpp>
 #include <atlas/gl/Buffer.hpp>
 #include <atlas/gl/VertexArrayObject.hpp>
 
+#include <atomic>
+#include <memory>
+
 namespace pbd
 {
+    //Surface draws the cloth as a lit triangle mesh, Particles draws a small
+    //proxy at every particle with one instanced call for debugging
+    enum class ClothView
+    {
+        Surface,
+        Particles
+    };
 
+    //the solver runs on a SimulationThread of its own. Drawing uses the
+    //newest frame it has published, and everything that changes the
+    //solver is sent to it as a command, so a slow step never stalls the
+    //viewer.
     class Cloth : public atlas::utils::Geometry
     {
     public:
-        Cloth();
+        //sets the solver up from scene (see applyScene); the scene is kept
+        //for resets and supplies the cache file names and the step size
+        Cloth(Scene const& scene);
+        ~Cloth();
+
+        Cloth(Cloth const&) = delete;
+        Cloth& operator=(Cloth const&) = delete;
 
         void setPosition(atlas::math::Point const& pos);
+        //loads a static triangle mesh (relative to DataDirectory) that the
+        //cloth collides with
+        void addMeshCollider(std::string const& filename, float thickness);
 
+        //starts or pauses the simulation thread
+        void setPlaying(bool play);
+        //picks up the newest frame of the simulation thread; the thread
+        //keeps its own fixed step rate whatever t is
         void updateGeometry(atlas::core::Time<> const& t) override;
         void renderGeometry(atlas::math::Matrix4 const& projection,
             atlas::math::Matrix4 const& view) override;
         void drawGui() override;
 
+        //times the solver phases and the render upload/draw into profiler
+        void setProfiler(Profiler* profiler);
+
+        //while recording every solver step is appended to a cache file.
+        //During playback the cloth is drawn from a cache and the solver is
+        //left alone; the cache must hold the same number of particles.
+        bool startRecording(std::string const& path, bool quantize);
+        void stopRecording();
+        bool startPlayback(std::string const& path);
+        void stopPlayback();
+        bool playingBack() const;
+        //moves the playback position (seconds), clamped to the recording
+        void seek(float time);
+        float playbackTime() const;
+
+        //saves or restores the full solver state (see
+        //Solver::saveCheckpoint). Once a state has been loaded it becomes
+        //the scene's starting state, so resetting the cloth goes back to it
+        //instead of the flat grid.
+        bool saveState(std::string const& path);
+        bool loadState(std::string const& path);
+
+        void setView(ClothView view);
+        ClothView view() const;
+
         void resetGeometry() override;
 
     private:
-        float mag(atlas::math::Vector v);
-        //atlas::math::Vector normal(int p1, int p2, int p3);
-        void constrainDistance(int p1, int p2);
-
-        std::vector<Particle> mParticles;
-        std::vector<unsigned int> mIndices;
-        atlas::gl::Buffer mVertexBuffer;
-        atlas::gl::Buffer mIndexBuffer;
-        atlas::gl::VertexArrayObject mVao;
-
-        GLsizei mIndexCount;
-        atlas::math::Point mPosition;
-        float mMass = 1.0f;
-        float mWidth = 10.0f;
-        float mLength = 10.0f;
-        float mHeight = 10.0f;
-        float mG = -9.8f;
-        float mRest = 1.0f;
-        float mRadius = 2.0f;
+        //uniform locations looked up once after linking
+        struct ShaderUniforms
+        {
+            GLint model;
+            GLint projection;
+            GLint view;
+            GLint colour;
+            GLint scale;
+        };
+
+        //applies scene to the solver, making new buffers when the cloth
+        //changes shape
+        bool setUp(Scene const& scene);
+        //takes the newest frame, remaking the buffers if its shape is new
+        void refresh();
+        void createSurface();
+        void createParticles();
+        void loadShader(std::string const& vertexShader,
+            ShaderUniforms& uniforms);
+        FramePair currentFrames();
+        void renderSurface(atlas::math::Matrix4 const& projection,
+            atlas::math::Matrix4 const& view);
+        void renderParticles(atlas::math::Matrix4 const& projection,
+            atlas::math::Matrix4 const& view);
+
+        //only touched through mSim once it is running
+        Solver mSolver;
+        std::unique_ptr<SimulationThread> mSim;
+        std::uint64_t mShape = 0;
+        Scene mScene;
+        Profiler* mProfiler = nullptr;
+        ClothView mView = ClothView::Surface;
+
+        //the surface vertices are written into a ring of buffers, each
+        //holding every position followed by every normal. A frame maps the
+        //next buffer with an invalidating map, so the driver hands back
+        //fresh storage instead of waiting for draws still reading it.
+        static const int kSurfaceRing = 3;
+
+        SurfaceMesh mSurface;
+        ThreadPool mPool;
+        GLuint mSurfaceBuffers[kSurfaceRing] = {};
+        GLuint mSurfaceVaos[kSurfaceRing] = {};
+        atlas::gl::Buffer mSurfaceIndexBuffer;
+        int mSurfaceSlot = 0;
+        GLsizei mSurfaceIndexCount;
+        ShaderUniforms mSurfaceUniforms;
+
+        //low-poly proxy mesh plus one position per particle
+        std::vector<float> mInstanceData;
+        atlas::gl::Buffer mProxyBuffer;
+        atlas::gl::Buffer mProxyIndexBuffer;
+        atlas::gl::Buffer mInstanceBuffer;
+        atlas::gl::VertexArrayObject mParticleVao;
+        GLsizei mProxyIndexCount;
+        ShaderUniforms mParticleUniforms;
+
+        //what the controls show, kept here so drawing them does not need
+        //the simulation thread
+        float mCompliance[kConstraintTypeCount];
+        bool mEnabled[kConstraintTypeCount];
+
+        //written on the simulation thread while recording
+        SimCacheWriter mRecorder;
+        bool mRecording = false;
+        std::atomic<int> mRecordedFrames;
+        SimCacheReader mPlayer;
+        float mPlaybackTime = 0.0f;
+        float mStepSize = 1.0f / 60.0f;
+        bool mQuantize = false;
     };
 }
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Scene.hpp"
+#include "Solver.hpp"
+#include "SurfaceMesh.hpp"
+#include "ThreadPool.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pbd
+{
+    //many independent copies of a cloth simulated together, such as the
+    //capes and flags of a crowd. Each instance is a whole Solver stepped on
+    //one thread, and the batch spreads the instances over its own pool with
+    //work stealing (see ThreadPool::parallelForDynamic): a 10 x 10 cloth is
+    //far too small to split across cores, but hundreds of them keep every
+    //core busy. The solvers sit in one contiguous block and share one
+    //surface layout, instance i's vertices following those of instance
+    //i - 1, so the whole batch is drawn from a single buffer. Their
+    //particle and scratch arrays are pooled as well: setUp makes one
+    //allocation for all of them and carves a slice per instance (see
+    //Solver::useStorage), so each instance's arrays sit together and
+    //apart from the others', and only the thread stepping an instance
+    //touches its slice.
+    class ClothBatch
+    {
+    public:
+        ClothBatch();
+
+        //builds scene.instances copies of scene (see applyScene), laid out
+        //on a square scene.instanceSpacing apart in x and z. scene.threads
+        //is the number of threads stepping the batch, 0 for every core; the
+        //instances themselves always solve on one thread. On failure the
+        //batch is left empty.
+        bool setUp(Scene const& scene, std::string& error);
+        //puts every instance back to the scene's starting state
+        bool reset(std::string& error);
+
+        void step(float dt);
+        //the instances' stats combined: iterations and sleeping tiles
+        //summed, the maximum error the largest of any instance and the rms
+        //error over all
+        StepStats lastStepStats() const;
+
+        std::size_t size() const;
+        int threadCount() const;
+        Solver& instance(std::size_t i);
+        Solver const& instance(std::size_t i) const;
+        //where instance i is drawn; every instance simulates in the scene's
+        //own frame, so the offset never changes how it moves
+        Vector3 const& offset(std::size_t i) const;
+
+        //vertices of all instances together and the triangles over them
+        std::size_t vertexCount() const;
+        std::vector<unsigned int> const& triangles() const;
+        //writes every instance's positions blended by alpha (see
+        //SurfaceMesh::write) and moved by its offset, and the unit normals,
+        //three floats per vertex each
+        void write(float alpha, float* positions, float* normals);
+
+    private:
+        Scene mScene;
+        //ahead of the instances, which keep their arrays in it
+        std::unique_ptr<Arena> mStorage;
+        std::vector<Solver> mInstances;
+        std::vector<std::string> mErrors;
+        std::vector<Vector3> mOffsets;
+        std::vector<SurfaceMesh> mSurfaces;
+        std::vector<std::size_t> mFirstVertex;
+        std::vector<unsigned int> mTriangles;
+        std::unique_ptr<ThreadPool> mPool;
+    };
+}
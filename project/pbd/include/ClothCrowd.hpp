@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ClothBatch.hpp"
+#include "Scene.hpp"
+
+#include <atlas/utils/Geometry.hpp>
+#include <atlas/gl/Buffer.hpp>
+
+namespace pbd
+{
+    //draws a ClothBatch: the surfaces of all instances go into one buffer
+    //and out in a single draw call, however many instances there are
+    class ClothCrowd : public atlas::utils::Geometry
+    {
+    public:
+        //sets the batch up from scene (see ClothBatch::setUp)
+        ClothCrowd(Scene const& scene);
+        ~ClothCrowd();
+
+        ClothCrowd(ClothCrowd const&) = delete;
+        ClothCrowd& operator=(ClothCrowd const&) = delete;
+
+        ClothBatch const& batch() const;
+
+        void updateGeometry(atlas::core::Time<> const& t) override;
+        void setInterpolation(float alpha);
+        void renderGeometry(atlas::math::Matrix4 const& projection,
+            atlas::math::Matrix4 const& view) override;
+        void drawGui() override;
+
+        //times the step and the render upload/draw into profiler
+        void setProfiler(Profiler* profiler);
+
+        void resetGeometry() override;
+
+    private:
+        void createSurface();
+
+        ClothBatch mBatch;
+        Profiler* mProfiler = nullptr;
+
+        //same buffer ring as Cloth's surface, sized for the whole batch
+        static const int kSurfaceRing = 3;
+
+        GLuint mSurfaceBuffers[kSurfaceRing] = {};
+        GLuint mSurfaceVaos[kSurfaceRing] = {};
+        atlas::gl::Buffer mSurfaceIndexBuffer;
+        int mSurfaceSlot = 0;
+        GLsizei mSurfaceIndexCount = 0;
+        GLint mModelUniform;
+        GLint mProjectionUniform;
+        GLint mViewUniform;
+        GLint mColourUniform;
+
+        float mAlpha = 1.0f;
+        double mStepMs = 0.0;
+    };
+}
@@ -1,25 +1,36 @@
 #pragma once
 
 #include "Cloth.hpp"
+#include "ClothCrowd.hpp"
+#include "FixedStepClock.hpp"
+#include "Profiler.hpp"
+#include "Scene.hpp"
 #include "Sphere.hpp"
 
 #include <atlas/tools/ModellingScene.hpp>
-#include <atlas/utils/FPSCounter.hpp>
+
+#include <memory>
 
 namespace pbd
 {
+    //a scene with more than one instance is simulated and drawn as a
+    //ClothCrowd instead of the single Cloth
     class ClothScene : public atlas::tools::ModellingScene
     {
     public:
-        ClothScene();
+        ClothScene(Scene const& scene);
 
         void updateScene(double time) override;
         void renderScene() override;
 
     private:
         bool mPlay;
-        atlas::utils::FPSCounter mAnimCounter;
+        Scene mScene;
+        FixedStepClock mClock;
+        Profiler mProfiler;
+        PhaseHistory mPhases;
         Cloth mCloth;
+        std::unique_ptr<ClothCrowd> mCrowd;
         Sphere mSphere;
     };
 }
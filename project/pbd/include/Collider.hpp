@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Bvh.hpp"
+#include "ParticleSet.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace pbd
+{
+    struct SphereCollider
+    {
+        Vector3 center;
+        float radius;
+    };
+
+    //sphere swept along the segment a-b
+    struct CapsuleCollider
+    {
+        Vector3 a;
+        Vector3 b;
+        float radius;
+    };
+
+    //oriented box; axes must be orthonormal
+    struct BoxCollider
+    {
+        Vector3 center;
+        Vector3 axes[3];
+        Vector3 halfExtents;
+    };
+
+    //particles are kept on the side the normal points to,
+    //i.e. dot(normal, x) >= offset
+    struct PlaneCollider
+    {
+        Vector3 normal;
+        float offset;
+    };
+
+    //static triangle mesh; particles are kept at least thickness away from
+    //its surface, on the side they started the step on. Triangles are found
+    //through a BVH built on creation.
+    class MeshCollider
+    {
+    public:
+        MeshCollider(std::vector<Vector3> vertices,
+            std::vector<unsigned int> indices, float thickness);
+
+        Bvh const& bvh() const;
+        float thickness() const;
+        std::vector<Vector3> const& vertices() const;
+        std::vector<unsigned int> const& indices() const;
+
+        Aabb const& triangleBounds(int t) const;
+        //closest point on triangle t to p
+        Vector3 closestPoint(int t, Vector3 const& p) const;
+        Vector3 faceNormal(int t) const;
+        //parameter in [0, 1] where the segment from-to crosses triangle t,
+        //or a negative value when it does not
+        float intersect(int t, Vector3 const& from, Vector3 const& to) const;
+
+    private:
+        std::vector<Vector3> mVertices;
+        std::vector<unsigned int> mIndices;
+        std::vector<Aabb> mTriangleBounds;
+        Bvh mBvh;
+        float mThickness;
+    };
+
+    //every collision shape in the scene. collide() projects the predicted
+    //positions of a range of particles out of all of them.
+    class ColliderSet
+    {
+    public:
+        void clear();
+
+        std::size_t addSphere(SphereCollider const& sphere);
+        std::size_t addCapsule(CapsuleCollider const& capsule);
+        std::size_t addBox(BoxCollider const& box);
+        std::size_t addPlane(PlaneCollider const& plane);
+        std::size_t addMesh(MeshCollider mesh);
+
+        std::vector<SphereCollider>& spheres();
+        std::vector<CapsuleCollider>& capsules();
+        std::vector<BoxCollider>& boxes();
+        std::vector<PlaneCollider>& planes();
+        std::vector<SphereCollider> const& spheres() const;
+        std::vector<CapsuleCollider> const& capsules() const;
+        std::vector<BoxCollider> const& boxes() const;
+        std::vector<PlaneCollider> const& planes() const;
+        std::vector<MeshCollider> const& meshes() const;
+
+        //candidates is scratch space for the mesh queries, passed in so
+        //that concurrent callers each use their own
+        void collide(ParticleSet& particles, std::size_t begin,
+            std::size_t end, IntArray& candidates) const;
+
+    private:
+        void collideMesh(MeshCollider const& mesh, ParticleSet& particles,
+            std::size_t begin, std::size_t end,
+            IntArray& candidates) const;
+
+        std::vector<SphereCollider> mSpheres;
+        std::vector<CapsuleCollider> mCapsules;
+        std::vector<BoxCollider> mBoxes;
+        std::vector<PlaneCollider> mPlanes;
+        std::vector<MeshCollider> mMeshes;
+    };
+}
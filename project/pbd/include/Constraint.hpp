@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace pbd
+{
+    //families of cloth constraints. Structural constraints keep grid
+    //neighbours apart, shear constraints keep the cell diagonals, and
+    //bending constraints act on the two triangles either side of an
+    //interior edge. Each family has its own compliance and is stored in
+    //its own contiguous batches.
+    enum class ConstraintType
+    {
+        Structural,
+        Shear,
+        Bending
+    };
+
+    const int kConstraintTypeCount = 3;
+
+    const char* constraintTypeName(ConstraintType type);
+
+    //distance constraint between particles i and j, built once when the
+    //cloth is created or reset and then iterated directly by the solver.
+    //stiffness scales the correction in the Jacobi kernels; the solver sets
+    //it from the compliance of the constraint's family.
+    struct DistanceConstraint
+    {
+        int i;
+        int j;
+        float restLength;
+        float stiffness;
+    };
+
+    using ConstraintList = std::vector<DistanceConstraint>;
+
+    //distance constraint for every edge of the triangles (three particle
+    //indices per triangle), with the rest length taken from x, y, z. The
+    //list is sorted by end points so consecutive constraints touch nearby
+    //particles.
+    ConstraintList buildEdgeConstraints(std::vector<unsigned int> const& triangles,
+        float const* x, float const* y, float const* z);
+
+    //isometric bending (Bergou et al. 2006) on the triangles (p[0], p[1],
+    //p[2]) and (p[1], p[0], p[3]) sharing the edge p[0]-p[1]. The bending
+    //energy is C = 1/2 sum_ij q_ij x_i.x_j with q built from the rest
+    //shape, so it costs no trigonometry while solving.
+    struct BendingConstraint
+    {
+        int p[4];
+        float q[4][4];
+        float rest;
+    };
+
+    using BendingList = std::vector<BendingConstraint>;
+
+    //builds the bending constraint for the edge a-b with opposite vertices
+    //c and d from the rest positions
+    BendingConstraint makeBendingConstraint(int a, int b, int c, int d,
+        float const* x, float const* y, float const* z);
+
+    //bending constraint for every edge shared by two triangles (three
+    //particle indices per triangle), with rest shape taken from x, y, z
+    BendingList buildBendingConstraints(std::vector<unsigned int> const& triangles,
+        float const* x, float const* y, float const* z);
+
+    //which particles of a constraint are pinned (inverse mass 0). Partial
+    //distance constraints are stored with the pinned particle as i, so the
+    //solver only ever moves j.
+    enum class PinPattern
+    {
+        None,
+        Partial,
+        All
+    };
+
+    //contiguous range of constraints of one colour. No two constraints in a
+    //parallel batch touch the same particle, so they can be projected
+    //concurrently with the same result as projecting them in order.
+    struct ConstraintBatch
+    {
+        std::size_t begin;
+        std::size_t end;
+        bool parallel;
+        ConstraintType type;
+        PinPattern pins;
+    };
+
+    //greedily colours the constraint graph and reorders constraints so that
+    //each colour is contiguous. Constraints that do not fit in the available
+    //colours end up in a trailing batch that must be solved serially.
+    //Batches are tagged with type and start at offset, for lists that are
+    //appended to a larger one.
+    std::vector<ConstraintBatch> colourConstraints(ConstraintList& constraints,
+        std::size_t particleCount, ConstraintType type, std::size_t offset = 0);
+    std::vector<ConstraintBatch> colourConstraints(BendingList& constraints,
+        std::size_t particleCount, ConstraintType type, std::size_t offset = 0);
+
+    //splits every batch by pin pattern (reordering the constraints inside
+    //it), so that each batch can be solved with a kernel specialized for
+    //its pattern and batches with every particle pinned can be skipped
+    std::vector<ConstraintBatch> splitByPins(ConstraintList& constraints,
+        std::vector<ConstraintBatch> const& batches, float const* invMass);
+    std::vector<ConstraintBatch> splitByPins(BendingList& constraints,
+        std::vector<ConstraintBatch> const& batches, float const* invMass);
+}
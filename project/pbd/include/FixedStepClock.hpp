@@ -0,0 +1,28 @@
+#pragma once
+
+namespace pbd
+{
+    //turns variable frame times into a whole number of fixed physics steps.
+    //Leftover time is carried to the next frame and exposed as alpha() so
+    //the renderer can interpolate between the last two physics states.
+    //At most maxSteps steps run per frame; time beyond that is dropped so a
+    //slow frame cannot make the next one slower still.
+    class FixedStepClock
+    {
+    public:
+        explicit FixedStepClock(float stepSize = 1.0f / 60.0f, int maxSteps = 4);
+
+        //number of physics steps to run for a frame that took frameTime
+        int advance(float frameTime);
+        void reset();
+
+        float stepSize() const;
+        //fraction of a step the render time is past the latest state
+        float alpha() const;
+
+    private:
+        float mStepSize;
+        int mMaxSteps;
+        float mAccumulator;
+    };
+}
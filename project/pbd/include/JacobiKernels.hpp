@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Constraint.hpp"
+
+#include <cstddef>
+
+namespace pbd
+{
+    //inputs and outputs of the Jacobi distance kernel. For every constraint k
+    //in [begin, end) the kernel writes the correction that particle i should
+    //receive per unit inverse mass into corrX/Y/Z[k]; particle j receives the
+    //negated value. Nothing is written to the particles, so any range of
+    //constraints can be processed concurrently.
+    struct DistanceKernelArgs
+    {
+        DistanceConstraint const* constraints;
+        float const* predX;
+        float const* predY;
+        float const* predZ;
+        float const* invMass;
+        float* corrX;
+        float* corrY;
+        float* corrZ;
+    };
+
+    using DistanceKernel = void (*)(DistanceKernelArgs const& args,
+        std::size_t begin, std::size_t end);
+
+    //width in constraints of the widest kernel. The kernels load unaligned
+    //and finish any range with a scalar remainder, so ranges may start
+    //anywhere; the solver splits work into multiples of this width so that
+    //only the last chunk has a remainder.
+    const std::size_t kDistanceKernelWidth = 8;
+
+    //picks the widest kernel the running CPU supports (AVX2, SSE2 or scalar)
+    DistanceKernel selectDistanceKernel();
+    const char* distanceKernelName(DistanceKernel kernel);
+
+    void distanceKernelScalar(DistanceKernelArgs const& args,
+        std::size_t begin, std::size_t end);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Vector3.hpp"
+
+#include <string>
+#include <vector>
+
+namespace pbd
+{
+    //reads the vertex positions and faces of a Wavefront OBJ file without
+    //going through atlas, so the headless tools can load meshes. Polygons
+    //are split into triangle fans; normals, texture coordinates, groups and
+    //materials are ignored.
+    bool loadObj(std::string const& path, std::vector<Vector3>& vertices,
+        std::vector<unsigned int>& indices);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace pbd
+{
+    //order the particles are stored in. Input keeps the order the grid or
+    //mesh was built in. Morton sorts them along a Z-order curve through
+    //their rest positions and Rcm numbers them by reverse Cuthill-McKee on
+    //the mesh edges; both keep particles that share constraints close in
+    //memory, which matters for meshes whose vertex order is arbitrary.
+    enum class ParticleOrder
+    {
+        Input,
+        Morton,
+        Rcm
+    };
+
+    const char* particleOrderName(ParticleOrder order);
+
+    //the functions below return order[new index] = old index
+
+    //sorted by the 30 bit Morton code of each position quantised to a
+    //1024^3 grid over the bounding box, ties kept in input order
+    std::vector<int> mortonOrder(float const* x, float const* y,
+        float const* z, std::size_t count);
+
+    //reverse Cuthill-McKee over the edges of the triangles (three indices
+    //per triangle). Each connected component is started from a
+    //pseudo-peripheral vertex; particles on no triangle go last.
+    std::vector<int> rcmOrder(std::vector<unsigned int> const& triangles,
+        std::size_t count);
+}
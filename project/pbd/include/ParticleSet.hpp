@@ -0,0 +1,74 @@
+#pragma once
+
+#include "AlignedAllocator.hpp"
+#include "Vector3.hpp"
+
+#include <vector>
+
+namespace pbd
+{
+    //structure-of-arrays particle storage. Every attribute is a separate
+    //contiguous, cache-line aligned array so that the solver passes only
+    //stream the components they touch. An inverse mass of 0 pins a particle.
+    class ParticleSet
+    {
+    public:
+        void clear();
+        void reserve(std::size_t n);
+        std::size_t add(float mass, Vector3 const& position);
+        std::size_t size() const;
+
+        void setMovable(std::size_t i, bool b);
+        bool movable(std::size_t i) const;
+
+        Vector3 position(std::size_t i) const;
+        Vector3 prediction(std::size_t i) const;
+        Vector3 velocity(std::size_t i) const;
+        void setPosition(std::size_t i, Vector3 const& p);
+
+        //copies the positions into the previous-state arrays; the solver
+        //does this at the start of every step
+        void storePrevious();
+        //position blended from the previous state (alpha = 0) to the
+        //current one (alpha = 1)
+        Vector3 interpolated(std::size_t i, float alpha) const;
+
+        //reorders every array so that particle k becomes the old particle
+        //order[k]; order must be a permutation of 0 .. size() - 1
+        void permute(std::vector<int> const& order);
+
+        //calls fn on every per-particle array, the private masses
+        //included, for code that stores or restores the whole set
+        template <typename Fn>
+        void forEachArray(Fn fn)
+        {
+            fn(mPosX); fn(mPosY); fn(mPosZ);
+            fn(mPredX); fn(mPredY); fn(mPredZ);
+            fn(mVelX); fn(mVelY); fn(mVelZ);
+            fn(mPrevX); fn(mPrevY); fn(mPrevZ);
+            fn(mInvMass);
+            fn(mMass);
+        }
+
+        template <typename Fn>
+        void forEachArray(Fn fn) const
+        {
+            fn(mPosX); fn(mPosY); fn(mPosZ);
+            fn(mPredX); fn(mPredY); fn(mPredZ);
+            fn(mVelX); fn(mVelY); fn(mVelZ);
+            fn(mPrevX); fn(mPrevY); fn(mPrevZ);
+            fn(mInvMass);
+            fn(mMass);
+        }
+
+        FloatArray mPosX, mPosY, mPosZ;
+        FloatArray mPredX, mPredY, mPredZ;
+        FloatArray mVelX, mVelY, mVelZ;
+        FloatArray mPrevX, mPrevY, mPrevZ;
+        FloatArray mInvMass;
+
+    private:
+        //kept so that a pinned particle can be released again
+        FloatArray mMass;
+    };
+}
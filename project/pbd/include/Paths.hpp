@@ -1,7 +0,0 @@
-#pragma once
-
-namespace pbd
-{
-    constexpr const char ShaderDirectory[] = "/home/jomondogu/CSC473/pbd-master/project/pbd/shaders/";
-    constexpr const char DataDirectory[] = "/home/jomondogu/CSC473/pbd-master/data/";
-}
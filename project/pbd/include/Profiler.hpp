@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace pbd
+{
+    //one timed scope; times are nanoseconds since the profiler was created.
+    //name must outlive the profiler (string literals in practice).
+    struct ProfileEvent
+    {
+        const char* name;
+        std::uint64_t start;
+        std::uint64_t end;
+        std::uint32_t thread;
+    };
+
+    //fixed size ring of the most recent events. Recording claims a slot
+    //with one atomic increment and never blocks or allocates, so it can sit
+    //on the hot path of any thread; once full the oldest events are
+    //overwritten. Readers take snapshots and skip slots that are being
+    //rewritten while they read.
+    class Profiler
+    {
+    public:
+        //capacity is rounded up to a power of two
+        explicit Profiler(std::size_t capacity = 1 << 16);
+
+        Profiler(Profiler const&) = delete;
+        Profiler& operator=(Profiler const&) = delete;
+
+        std::uint64_t now() const;
+        void record(const char* name, std::uint64_t start, std::uint64_t end);
+        void clear();
+
+        //events still in the ring, oldest first
+        void snapshot(std::vector<ProfileEvent>& events) const;
+        //events recorded since cursor (0 for all) that are still in the
+        //ring, oldest first; cursor is moved past them
+        void collect(std::uint64_t& cursor, std::vector<ProfileEvent>& events) const;
+
+        //writes the ring in the Chrome trace event format, for
+        //chrome://tracing or Perfetto
+        bool writeChromeTrace(const char* path) const;
+
+    private:
+        //fields are relaxed atomics so that a reader racing a writer gets
+        //a stale or torn event (which the sequence check then rejects)
+        //rather than undefined behaviour
+        struct Slot
+        {
+            std::atomic<std::uint64_t> sequence;
+            std::atomic<const char*> name;
+            std::atomic<std::uint64_t> start;
+            std::atomic<std::uint64_t> end;
+            std::atomic<std::uint32_t> thread;
+        };
+
+        bool read(std::uint64_t index, ProfileEvent& event) const;
+
+        std::unique_ptr<Slot[]> mSlots;
+        std::size_t mMask;
+        std::atomic<std::uint64_t> mHead;
+        std::int64_t mOrigin;
+    };
+
+    //rolling per-frame totals of each event name, for plotting. Every
+    //update() sums the events recorded since the previous one into a new
+    //frame; names are added as they first show up.
+    class PhaseHistory
+    {
+    public:
+        explicit PhaseHistory(std::size_t frames = 120);
+
+        void update(Profiler const& profiler);
+
+        std::size_t phaseCount() const;
+        const char* name(std::size_t phase) const;
+        //milliseconds per frame as a ring of frames() values; offset() is
+        //the index of the oldest one
+        float const* samples(std::size_t phase) const;
+        std::size_t frames() const;
+        std::size_t offset() const;
+        float average(std::size_t phase) const;
+
+    private:
+        std::size_t mFrames;
+        std::size_t mFrame = 0;
+        std::uint64_t mCursor = 0;
+        std::vector<const char*> mNames;
+        std::vector<std::vector<float>> mSamples;
+        std::vector<ProfileEvent> mEvents;
+    };
+
+    //times the enclosing scope; does nothing when profiler is null
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer(Profiler* profiler, const char* name) :
+            mProfiler(profiler),
+            mName(name),
+            mStart(profiler ? profiler->now() : 0)
+        {}
+
+        ~ScopedTimer()
+        {
+            if (mProfiler)
+            {
+                mProfiler->record(mName, mStart, mProfiler->now());
+            }
+        }
+
+        ScopedTimer(ScopedTimer const&) = delete;
+        ScopedTimer& operator=(ScopedTimer const&) = delete;
+
+    private:
+        Profiler* mProfiler;
+        const char* mName;
+        std::uint64_t mStart;
+    };
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Collider.hpp"
+#include "Solver.hpp"
+
+#include <string>
+#include <vector>
+
+namespace pbd
+{
+    //setting a scene may or may not give; unset ones leave the solver as
+    //it is, with its defaults or the state of a restored checkpoint
+    template <typename T>
+    struct SceneValue
+    {
+        T value = T();
+        bool set = false;
+
+        SceneValue& operator=(T const& v)
+        {
+            value = v;
+            set = true;
+            return *this;
+        }
+    };
+
+    struct SceneMesh
+    {
+        std::string path;
+        float thickness;
+    };
+
+    //everything needed to set up and run a simulation: the cloth, the
+    //colliders, the solver settings and where results go. Scenes are read
+    //from text files (see loadScene) so that variants can be run without
+    //rebuilding. A default constructed scene is the cloth dropped on a
+    //sphere of radius 2 at (-5, 0, 0) above the ground plane.
+    struct Scene
+    {
+        Scene();
+
+        //cloth grid, an OBJ mesh to use instead (when mesh is not empty),
+        //or a checkpoint to start from
+        std::string mesh;
+        SceneValue<ParticleOrder> order;
+        SceneValue<int> width;
+        SceneValue<int> length;
+        SceneValue<float> spacing;
+        SceneValue<float> height;
+        SceneValue<float> mass;
+        SceneValue<std::vector<int>> pins;
+        std::string state;
+
+        //solver
+        SceneValue<int> threads;
+        SceneValue<SolverMode> mode;
+        SceneValue<float> relaxation;
+        SceneValue<int> substeps;
+        SceneValue<int> iterations;
+        SceneValue<float> tolerance;
+        SceneValue<ErrorNorm> norm;
+        SceneValue<int> levels;
+        SceneValue<int> levelIterations;
+        SceneValue<Acceleration> acceleration;
+        SceneValue<float> spectralRadius;
+        SceneValue<float> gravity;
+        SceneValue<float> damping;
+        SceneValue<bool> selfCollision;
+        SceneValue<float> thickness;
+        SceneValue<bool> sleep;
+        SceneValue<float> sleepSpeed;
+        SceneValue<float> sleepError;
+        SceneValue<int> sleepSteps;
+        SceneValue<float> compliance[kConstraintTypeCount];
+        SceneValue<bool> enabled[kConstraintTypeCount];
+
+        //colliders. The first collider a scene file gives replaces the
+        //defaults; a scene restoring a checkpoint without colliders of its
+        //own keeps the checkpoint's.
+        bool customColliders = false;
+        std::vector<SphereCollider> spheres;
+        std::vector<CapsuleCollider> capsules;
+        std::vector<BoxCollider> boxes;
+        std::vector<PlaneCollider> planes;
+        std::vector<SceneMesh> meshes;
+
+        //copies of the cloth simulated side by side (see ClothBatch),
+        //instanceSpacing apart
+        int instances = 1;
+        float instanceSpacing = 25.0f;
+
+        //run length and output files, empty when off
+        int steps = 600;
+        float stepSize = 1.0f / 60.0f;
+        std::string timings;
+        std::string trace;
+        std::string record;
+        bool quantize = false;
+        std::string checkpoint;
+    };
+
+    //reads a scene file: [section] headers followed by "key = value" lines,
+    //with # starting a comment. Sections are cloth, solver, batch, output
+    //and one per collider (sphere, capsule, box, plane, mesh); see data/drape.scene.
+    //File names in the scene are relative to the scene file. On failure
+    //error holds "file:line: reason" and scene is unspecified.
+    bool loadScene(std::string const& path, Scene& scene, std::string& error);
+
+    //sets solver up as scene describes: restores the checkpoint or builds
+    //the grid, replaces the colliders and applies the settings given
+    bool applyScene(Scene const& scene, Solver& solver, std::string& error);
+}
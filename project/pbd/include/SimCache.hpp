@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ParticleSet.hpp"
+#include "SurfaceMesh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace pbd
+{
+    //binary cache of particle positions, one frame per solver step.
+    //
+    //A 64 byte header (magic, version, flags, particle count, frame count,
+    //frame size, frame time) is followed by the frames. Every frame has
+    //the same size, so the header is the whole index and frame k is at
+    //64 + k * frameBytes. A raw frame is the x, y and z arrays as floats.
+    //A quantized frame stores the frame's bounds (min and step per axis,
+    //6 floats) followed by the three arrays as 16 bit offsets, about half
+    //the size at an error of at most half a step.
+    class SimCacheWriter
+    {
+    public:
+        SimCacheWriter() = default;
+        ~SimCacheWriter();
+
+        SimCacheWriter(SimCacheWriter const&) = delete;
+        SimCacheWriter& operator=(SimCacheWriter const&) = delete;
+
+        bool open(std::string const& path, std::size_t particleCount,
+            float frameTime, bool quantize);
+        //appends the current positions; the particle count must match
+        bool append(ParticleSet const& particles);
+        //writes the final frame count into the header
+        bool close();
+
+        bool isOpen() const;
+        std::size_t frameCount() const;
+
+    private:
+        std::FILE* mFile = nullptr;
+        std::size_t mParticleCount = 0;
+        std::size_t mFrameCount = 0;
+        float mFrameTime = 0.0f;
+        bool mQuantize = false;
+        std::vector<std::uint16_t> mQuantized;
+    };
+
+    //memory maps a cache for playback. Raw frames are read in place, so
+    //seeking costs nothing; quantized frames are decoded on demand into one
+    //of two buffers (by frame parity), so a frame and its successor can be
+    //used together.
+    class SimCacheReader
+    {
+    public:
+        SimCacheReader() = default;
+        ~SimCacheReader();
+
+        SimCacheReader(SimCacheReader const&) = delete;
+        SimCacheReader& operator=(SimCacheReader const&) = delete;
+
+        bool open(std::string const& path);
+        void close();
+
+        bool isOpen() const;
+        std::size_t particleCount() const;
+        std::size_t frameCount() const;
+        float frameTime() const;
+        bool quantized() const;
+        //length of the recording in seconds
+        float duration() const;
+
+        //positions of one frame, valid until the frame two after it of
+        //the same parity is requested or the reader is closed
+        void positions(std::size_t frame, float const*& x, float const*& y,
+            float const*& z);
+        //the two frames around time (clamped to the recording) and the
+        //blend factor between them
+        FramePair at(float time);
+
+    private:
+        unsigned char const* frameData(std::size_t frame) const;
+
+        void* mMapping = nullptr;
+        std::size_t mSize = 0;
+#if defined(_WIN32)
+        void* mFileHandle = nullptr;
+        void* mMapHandle = nullptr;
+#endif
+        std::size_t mParticleCount = 0;
+        std::size_t mFrameCount = 0;
+        std::size_t mFrameBytes = 0;
+        float mFrameTime = 0.0f;
+        bool mQuantized = false;
+
+        FloatArray mDecoded[2][3];
+        std::size_t mDecodedFrame[2] = {~std::size_t(0), ~std::size_t(0)};
+    };
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Solver.hpp"
+#include "SurfaceMesh.hpp"
+#include "TripleBuffer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pbd
+{
+    //one published solver state: the particle positions before and after
+    //the latest step, so the renderer can blend between them
+    struct SimFrame
+    {
+        //the six position arrays share an arena of the frame's own,
+        //declared first so that it outlives them
+        std::unique_ptr<Arena> arena;
+        FloatArray prevX, prevY, prevZ;
+        FloatArray x, y, z;
+        //triangles over the particles. They are only copied when the
+        //cloth has been rebuilt with a different shape, which also changes
+        //shape.
+        std::vector<unsigned int> triangles;
+        std::uint64_t shape = 0;
+        //steps run since the thread started, and the last one's stats
+        std::uint64_t steps = 0;
+        StepStats stats = {0, 0, 0.0f, 0.0f, 0};
+        double stepMs = 0.0;
+        std::chrono::steady_clock::time_point time;
+
+        std::size_t size() const;
+        FramePair interpolation(float alpha) const;
+        //makes room for count particles, in a new arena if they do not
+        //fit the current one; the positions are left to be overwritten
+        void reserve(std::size_t count);
+    };
+
+    //steps a solver on a thread of its own at a fixed rate, so that a slow
+    //step never holds up the thread drawing it. Every step is published
+    //through a triple buffer, and the reading thread picks up the latest
+    //complete frame with update() without waiting. Everything else, from
+    //play and reset to changing settings, goes to the simulation thread as
+    //commands that run between steps. Once handed over, the solver must
+    //only be touched through commands.
+    class SimulationThread
+    {
+    public:
+        using Command = std::function<void(Solver&)>;
+        using StepHook = std::function<void(Solver const&)>;
+
+        //starts paused, with the solver's current state published
+        SimulationThread(Solver& solver, float stepSize);
+        ~SimulationThread();
+
+        SimulationThread(SimulationThread const&) = delete;
+        SimulationThread& operator=(SimulationThread const&) = delete;
+
+        void play();
+        void pause();
+        bool playing() const;
+        float stepSize() const;
+
+        //queues command to run on the simulation thread before the next
+        //step; commands run in the order they were posted
+        void post(Command command);
+        //runs command on the simulation thread and waits until it has
+        //finished and its result is published. Must not be called from a
+        //command or a step hook.
+        void call(Command const& command);
+        //hook run on the simulation thread after every step, e.g. to record
+        //it; an empty hook removes it
+        void setStepHook(StepHook hook);
+
+        //reader side: picks up the newest published frame, false if there
+        //is nothing newer than frame()
+        bool update();
+        SimFrame const& frame() const;
+        //how far the render time is past frame() as a fraction of a step,
+        //for blending between its two states
+        float alpha() const;
+
+    private:
+        void run();
+        void checkShape();
+        void publish();
+
+        Solver& mSolver;
+        float mStepSize;
+        TripleBuffer<SimFrame> mFrames;
+        StepHook mStepHook;
+
+        //simulation thread side of the published frames
+        std::vector<unsigned int> mTriangles;
+        std::size_t mParticleCount = 0;
+        std::uint64_t mShape = 0;
+        std::uint64_t mSteps = 0;
+        double mStepMs = 0.0;
+
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        std::condition_variable mDone;
+        std::deque<Command> mCommands;
+        //commands posted so far and how many of them have run and been
+        //published, for call()
+        std::uint64_t mPosted = 0;
+        std::uint64_t mCompleted = 0;
+        std::atomic<bool> mPlaying;
+        bool mStop;
+        std::thread mThread;
+    };
+}
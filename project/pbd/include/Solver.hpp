@@ -0,0 +1,444 @@
+#pragma once
+
+#include "Arena.hpp"
+#include "Collider.hpp"
+#include "Constraint.hpp"
+#include "JacobiKernels.hpp"
+#include "ParticleOrder.hpp"
+#include "ParticleSet.hpp"
+#include "Profiler.hpp"
+#include "SpatialHash.hpp"
+#include "ThreadPool.hpp"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pbd
+{
+    //GaussSeidel projects constraints one colour batch at a time, each
+    //seeing the corrections of the batches before it. Jacobi computes every
+    //correction from the same predictions with the SIMD kernels and applies
+    //the per-particle average, scaled by the relaxation factor.
+    enum class SolverMode
+    {
+        GaussSeidel,
+        Jacobi
+    };
+
+    //norm of the constraint violation the early exit compares against
+    //the tolerance
+    enum class ErrorNorm
+    {
+        Max,
+        Rms
+    };
+
+    //how each substep's iterations are sped up. Chebyshev blends every
+    //iteration's result with the one two iterations back, by a weight that
+    //follows the Chebyshev recurrence for the spectral radius (Wang 2015).
+    //Momentum uses that recurrence's limit as a fixed weight from the
+    //start.
+    enum class Acceleration
+    {
+        None,
+        Chebyshev,
+        Momentum
+    };
+
+    //what the last call to step() did. Errors are relative stretch,
+    //|length - restLength| / restLength, measured after the final iteration
+    //of the last substep. sleepingTiles is counted after the step.
+    struct StepStats
+    {
+        int substeps;
+        int iterations;
+        float maxError;
+        float rmsError;
+        int sleepingTiles;
+    };
+
+    //particles per sleep tile, see Solver::setSleeping
+    const std::size_t kSleepTileSize = 64;
+
+    //GL-free position based dynamics solver for a rectangular cloth grid.
+    //Owns the particle state, the constraints and the collision shapes so
+    //that it can be stepped without a window (see headless.cpp). By default
+    //the scene holds a sphere of radius 2 and the ground plane y = 0.
+    class Solver
+    {
+    public:
+        Solver();
+
+        //number of particles along each side of the grid (10 x 10 by
+        //default); resets the cloth, switching back from a mesh if need be
+        void setGridSize(int width, int length);
+
+        //replaces the grid with a triangle mesh (three vertex indices per
+        //triangle) at its rest shape, and resets. Every mesh edge becomes a
+        //structural constraint and every edge between two triangles a
+        //bending constraint; meshes have no shear constraints. The mass is
+        //spread over the vertices by triangle area.
+        void setClothMesh(std::vector<Vector3> vertices,
+            std::vector<unsigned int> triangles);
+
+        //storage order of the particles built by reset(), taking effect on
+        //the next reset. Pins, the sphere position and so on still refer to
+        //the grid or mesh order; inputIndices() maps particles back to it.
+        void setParticleOrder(ParticleOrder order);
+        ParticleOrder particleOrder() const;
+        //grid or mesh vertex index of each particle
+        std::vector<int> const& inputIndices() const;
+
+        //shape of the cloth built by reset(), taking effect on the next
+        //reset: total mass, distance between neighbouring particles (the
+        //rest length of the structural constraints) and starting height
+        void setClothMass(float mass);
+        void setSpacing(float spacing);
+        void setClothHeight(float height);
+        //particles pinned by reset(), as indices into the grid (row-major,
+        //length particles per row) or mesh. Empty pins the two corners of
+        //the first row of a grid, which is the default, and nothing on a
+        //mesh.
+        void setPins(std::vector<int> pins);
+        void setGravity(float g);
+        float gravity() const;
+        //share of the velocity lost per second, as v / (1 + damping dt)
+        //every substep; 0 (the default) keeps all of it. Colliders have no
+        //friction, so without some damping cloth never comes to rest.
+        void setDamping(float damping);
+        float damping() const;
+
+        //moves the sphere the cloth is dropped on (the first sphere collider)
+        void setSpherePosition(Vector3 const& pos);
+        //the colliders may be changed through this, so it wakes every tile
+        ColliderSet& colliders();
+
+        //number of threads used for constraint projection and collision,
+        //including the calling thread. 1 solves everything serially.
+        void setThreadCount(int threads);
+        int threadCount() const;
+
+        void setSolverMode(SolverMode mode);
+        SolverMode solverMode() const;
+        //over-relaxation applied to the averaged Jacobi corrections
+        void setRelaxation(float omega);
+        const char* kernelName() const;
+
+        //particle-particle self collision keeps particles at least
+        //thickness apart, except pairs that already rest closer than that
+        //(neighbours on a fine cloth), which the constraints look after.
+        //Off by default, since it rebuilds a spatial hash every substep. A
+        //thickness of 0 (the default) follows the cloth: 0.4 of the grid
+        //spacing or of a mesh's mean edge length, so imported garments of
+        //any scale get a sensible one.
+        void setSelfCollision(bool enabled, float thickness);
+        bool selfCollision() const;
+        //as given, 0 when following the cloth
+        float selfCollisionThickness() const;
+        //the thickness in use
+        float contactThickness() const;
+
+        //each step is split into substeps of dt / substeps, and each
+        //substep runs up to maxIterations solver iterations
+        void setSubsteps(int substeps);
+        void setMaxIterations(int iterations);
+        int substeps() const;
+        int maxIterations() const;
+        //stops iterating a substep once the chosen norm of the constraint
+        //error is below tolerance; a tolerance of 0 always runs every
+        //iteration
+        void setTolerance(float tolerance, ErrorNorm norm);
+        float tolerance() const;
+        ErrorNorm errorNorm() const;
+
+        //hierarchical position based dynamics (Mueller 2008). Up to
+        //levels - 1 coarser copies of the cloth are built, each from about
+        //a quarter of the particles of the one below (an independent set
+        //of its constraint graph, pins first), joined by distance
+        //constraints that only resist stretching. Every substep then runs
+        //coarseIterations iterations on each coarse level, coarsest first,
+        //and hands every level's corrections down to the particles it
+        //left out, weighted by rest distance, before the usual iterations
+        //on the full cloth. Corrections then cross the cloth in a few
+        //sweeps instead of one edge per iteration. 1 level (the default)
+        //is the flat solver.
+        void setHierarchy(int levels, int coarseIterations);
+        int hierarchyLevels() const;
+        int coarseIterations() const;
+        //levels actually built, the full cloth included; coarsening stops
+        //early once a level is small
+        int builtLevels() const;
+
+        //accelerates the iterations of every substep, in either solver
+        //mode. The first few iterations run plain. With a spectral radius
+        //of 0 the first substep estimates it from how fast their
+        //corrections shrink; after that each substep compares how fast the
+        //accelerated corrections shrink with the rate the radius predicts
+        //and moves the radius up or down towards what it measured. A
+        //radius above 0 is used as given. Should the corrections grow while
+        //accelerated, the rest of the substep runs plain and the radius is
+        //lowered. None (the default) leaves the iterations as they are.
+        void setAcceleration(Acceleration acceleration, float spectralRadius);
+        Acceleration acceleration() const;
+        //the radius in use, the latest estimate when estimating
+        float spectralRadius() const;
+        //substeps that fell back to plain iterations since the last reset
+        int accelerationFallbacks() const;
+
+        //XPBD compliance (inverse stiffness) of a constraint family. Zero is
+        //rigid; larger values let the family give under load by the same
+        //amount whatever the step size and iteration count.
+        void setCompliance(ConstraintType type, float compliance);
+        float compliance(ConstraintType type) const;
+        //disabled families are not built; changing this rebuilds the
+        //constraints but keeps the particle state
+        void setConstraintEnabled(ConstraintType type, bool enabled);
+        bool constraintEnabled(ConstraintType type) const;
+
+        //times each phase of step() into profiler; null (the default)
+        //turns the timers off
+        void setProfiler(Profiler* profiler);
+
+        //lets cloth at rest stop costing anything. The particles are split
+        //into tiles of kSleepTileSize in storage order, which are compact
+        //patches under the Morton and RCM orders and strips of rows on a
+        //grid. A tile whose kinetic energy per unit mass stays below
+        //speed^2 / 2 and whose constraints stay within error relative
+        //stretch for steps steps in a row falls asleep: its particles hold
+        //still as if pinned and are left out of prediction, projection and
+        //collision. A moving or overstretched neighbour, a self collision
+        //contact, or any change to the settings or colliders wakes it.
+        //Off by default.
+        void setSleeping(bool enabled, float speed, float error, int steps);
+        bool sleepEnabled() const;
+        float sleepSpeed() const;
+        float sleepError() const;
+        int sleepSteps() const;
+        //wakes every tile and restarts their windows
+        void wake();
+        std::size_t tileCount() const;
+        std::size_t sleepingTileCount() const;
+
+        //once the solver is set up, stepping does not allocate; neither
+        //does reset() while the cloth's shape settings stay the same
+        void step(float dt);
+        void reset();
+        StepStats const& lastStepStats() const;
+
+        //binary snapshot of the whole simulation: settings, particle state
+        //(velocities and pins included), the built constraints and the
+        //colliders. Loading one replaces the current state, so a settled
+        //cloth can be restored instead of simulated again; a failed load
+        //leaves the solver untouched. Thread count and profiler are not
+        //part of the state. Checkpoints are raw memory and only meant to
+        //be read back by the same build. Sleeping tiles are not part of the
+        //state either, a loaded cloth starts awake.
+        bool saveCheckpoint(std::string const& path) const;
+        bool loadCheckpoint(std::string const& path);
+
+        ParticleSet const& particles() const;
+        int width() const;
+        int length() const;
+        //structural constraints followed by shear constraints
+        ConstraintList const& constraints() const;
+        BendingList const& bendingConstraints() const;
+        //triangle list over the grid (three particle indices per triangle)
+        //for drawing the cloth surface
+        std::vector<unsigned int> const& triangles() const;
+
+        //the particle and scratch arrays, the self collision grid and
+        //neighbour lists and the collider candidate lists live in one
+        //arena. After anything that sizes them (a rebuild, a new thread
+        //count, self collision or acceleration turned on) they are copied
+        //into a block that just holds them, if some no longer fit the old
+        //one; steps never do. storageBytes() is what that block needs, and
+        //useStorage() moves the arrays into bytes of memory at block
+        //instead, which must be cache line aligned and outlive the solver
+        //(see ClothBatch).
+        std::size_t storageBytes() const;
+        void useStorage(void* block, std::size_t bytes);
+        //whether every array is in the arena
+        bool storagePooled() const;
+
+    private:
+        int substep(float dt);
+        void measureError(float& maxError, float& rmsError);
+        void buildParticles();
+        void buildGrid();
+        void buildMesh();
+        void buildConstraints();
+        void buildGridConstraints(ConstraintList& structural,
+            ConstraintList& shear);
+        void buildJacobiAdjacency();
+        void buildHierarchy();
+        void solveHierarchy();
+        void startAcceleration();
+        void accelerateIteration(int iter);
+        void finishAcceleration();
+        void reserveScratch();
+        void reserveCandidates(std::size_t chunks);
+        void projectConstraints();
+        void projectBatch(ConstraintBatch const& batch);
+        template <ConstraintType Type, PinPattern Pins>
+        void projectRange(std::size_t begin, std::size_t end, float alpha);
+        void projectJacobi();
+        void updateJacobiStiffness();
+        void applyJacobiRange(std::size_t begin, std::size_t end);
+        void findSelfCollisions();
+        void solveSelfCollisions();
+        void selfCollisionRange(std::size_t begin, std::size_t end);
+        //whether i and j lie closer than the thickness in the rest shape;
+        //those are held apart by the cloth's own constraints, and pushing
+        //them further would only fight them
+        bool restingClose(std::size_t i, std::size_t j, float thicknessSq) const;
+        void collide();
+        void buildSleepTiles();
+        template <typename Self, typename Fn>
+        static void forEachArray(Self& self, Fn fn);
+        void packStorage(std::unique_ptr<Arena> arena);
+        void settleStorage();
+        void buildActiveLists();
+        void updateSleep();
+        void setTileAsleep(std::size_t tile, bool asleep);
+        template <typename Fn>
+        void forEachAwakeRange(Fn const& fn);
+        std::vector<ConstraintBatch> const& distanceBatches() const;
+        std::vector<ConstraintBatch> const& bendingBatches() const;
+        template <PinPattern Pins>
+        void constrainDistance(DistanceConstraint const& c, float& lambda,
+            float alpha);
+        void constrainBending(BendingConstraint const& c, float& lambda,
+            float alpha);
+
+        //declared first so that it outlives the arrays it holds
+        std::unique_ptr<Arena> mArena;
+        ParticleSet mParticles;
+        ConstraintList mConstraints;
+        std::size_t mStructuralCount = 0;
+        BendingList mBendings;
+        std::vector<unsigned int> mTriangles;
+        //positions the cloth was built in, which constraints rebuilt later
+        //take their rest shape from
+        FloatArray mRestX, mRestY, mRestZ;
+        std::vector<ConstraintBatch> mBatches;
+        std::vector<ConstraintBatch> mBendingBatches;
+
+        //compliance per family (indexed by ConstraintType), the per-substep
+        //alpha / dt^2 and the accumulated multipliers of the current substep
+        float mCompliance[kConstraintTypeCount] = {0.0f, 0.01f, 0.1f};
+        bool mEnabled[kConstraintTypeCount] = {true, true, true};
+        float mAlpha[kConstraintTypeCount] = {0.0f, 0.0f, 0.0f};
+        FloatArray mLambda;
+        FloatArray mBendingLambda;
+        std::unique_ptr<ThreadPool> mPool;
+
+        SolverMode mMode = SolverMode::GaussSeidel;
+        float mRelaxation = 1.5f;
+        DistanceKernel mKernel;
+        FloatArray mCorrX, mCorrY, mCorrZ;
+        //constraints touching each particle in CSR form, entries are
+        //(constraint << 1) | side where side 1 means the particle is j
+        std::vector<int> mAdjacencyOffsets;
+        std::vector<int> mAdjacency;
+        FloatArray mInvDegree;
+
+        bool mSelfCollision = false;
+        float mThicknessSetting = 0.0f;
+        float mThickness = 0.4f;
+        SpatialHash mHash;
+        FloatArray mSelfX, mSelfY, mSelfZ;
+        //mesh collider candidates, one list per thread
+        std::vector<IntArray> mCandidates;
+
+        //sleep tiles, see setSleeping. A sleeping particle has its inverse
+        //mass zeroed, mAwakeInvMass keeps the real one. While any tile
+        //sleeps the batches are replaced by their runs of constraints that
+        //still have a movable particle, and the per-particle passes only
+        //visit the awake ranges (always at least [0, count) otherwise).
+        struct ParticleRange
+        {
+            std::size_t begin;
+            std::size_t end;
+        };
+        bool mSleepEnabled = false;
+        float mSleepSpeed = 0.05f;
+        float mSleepError = 0.01f;
+        int mSleepSteps = 30;
+        std::size_t mSleepingTiles = 0;
+        FloatArray mAwakeInvMass;
+        std::vector<char> mTileAsleep;
+        std::vector<char> mTileBusy;
+        std::vector<int> mTileQuiet;
+        //pairs of tiles joined by a constraint
+        std::vector<std::pair<int, int>> mTileLinks;
+        std::vector<ParticleRange> mAwakeRanges;
+        std::vector<ConstraintBatch> mActiveBatches;
+        std::vector<ConstraintBatch> mActiveBendingBatches;
+        std::size_t mActiveCount = 0;
+
+        //coarse levels of the hierarchy, finest first. Particles keep their
+        //indices on every level. children are the particles of the level
+        //below left off this one, each with its parents here (CSR, weights
+        //summing to one).
+        struct HierarchyLevel
+        {
+            std::vector<int> particles;
+            ConstraintList constraints;
+            std::vector<ConstraintBatch> batches;
+            std::vector<int> children;
+            std::vector<int> parentOffsets;
+            std::vector<int> parents;
+            std::vector<float> weights;
+        };
+        int mLevels = 1;
+        int mCoarseIterations = 16;
+        std::vector<HierarchyLevel> mHierarchy;
+        //predictions before the coarse levels ran, so that each level
+        //hands down everything its particles have moved
+        FloatArray mStartX, mStartY, mStartZ;
+
+        //the iterates one and two iterations back, and where the current
+        //substep's acceleration is
+        Acceleration mAcceleration = Acceleration::None;
+        float mRadiusSetting = 0.0f;
+        float mSpectralRadius = 0.0f;
+        int mAccelerationFallbacks = 0;
+        FloatArray mCurrX, mCurrY, mCurrZ;
+        FloatArray mPrevX, mPrevY, mPrevZ;
+        std::vector<double> mResidualSum;
+        bool mAccelerating = false;
+        float mOmega = 1.0f;
+        float mResidualFirst = 0.0f;
+        float mResidualStart = 0.0f;
+        float mResidualLast = 0.0f;
+        float mWarmupRadius = 0.0f;
+        int mAcceleratedIterations = 0;
+
+        int mSubsteps = 1;
+        int mMaxIterations = 100;
+        float mTolerance = 0.0f;
+        ErrorNorm mNorm = ErrorNorm::Max;
+        StepStats mStats = {0, 0, 0.0f, 0.0f, 0};
+        std::vector<float> mErrorMax;
+        std::vector<double> mErrorSum;
+
+        Profiler* mProfiler = nullptr;
+        ColliderSet mColliders;
+        float mMass = 1.0f;
+        float mWidth = 10.0f;
+        float mLength = 10.0f;
+        float mHeight = 10.0f;
+        float mG = -9.8f;
+        float mDamping = 0.0f;
+        float mRest = 1.0f;
+        std::vector<int> mPins;
+        std::vector<Vector3> mMeshVertices;
+        std::vector<unsigned int> mMeshTriangles;
+        ParticleOrder mOrder = ParticleOrder::Input;
+        std::vector<int> mInputIndex;
+        //set by anything that changes what reset() builds, see reset()
+        bool mShapeChanged = true;
+    };
+}
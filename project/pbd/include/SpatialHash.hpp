@@ -0,0 +1,72 @@
+#pragma once
+
+#include "AlignedAllocator.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace pbd
+{
+    //uniform grid over particle positions, stored as a hash table so that it
+    //needs no bounds. build() sorts the particles into buckets with a
+    //parallel counting sort; findNeighbours() then turns the table into a
+    //per-particle neighbour list (CSR) that the solver reuses for every
+    //iteration of a substep instead of querying the grid again.
+    class SpatialHash
+    {
+    public:
+        //sets storage aside for count particles sorted by chunks threads,
+        //with neighbours entries in all their lists together, so building
+        //within that does not allocate
+        void reserve(std::size_t count, std::size_t neighbours,
+            std::size_t chunks);
+
+        void build(float const* x, float const* y, float const* z,
+            std::size_t count, float cellSize, ThreadPool* pool);
+
+        //every particle j != i with |x_i - x_j| < radius ends up in i's
+        //list; radius must not exceed the cell size passed to build()
+        void findNeighbours(float const* x, float const* y, float const* z,
+            float radius, ThreadPool* pool);
+
+        IntArray const& neighbourOffsets() const;
+        IntArray const& neighbours() const;
+
+        //calls fn on every array, for the solver to keep them in its arena
+        template <typename Fn>
+        void forEachArray(Fn fn)
+        {
+            fn(mCellX); fn(mCellY); fn(mCellZ);
+            fn(mBucket); fn(mBucketStart); fn(mChunkCounts); fn(mSorted);
+            fn(mNeighbourOffsets); fn(mNeighbours);
+        }
+
+        template <typename Fn>
+        void forEachArray(Fn fn) const
+        {
+            fn(mCellX); fn(mCellY); fn(mCellZ);
+            fn(mBucket); fn(mBucketStart); fn(mChunkCounts); fn(mSorted);
+            fn(mNeighbourOffsets); fn(mNeighbours);
+        }
+
+    private:
+        std::size_t bucket(int cx, int cy, int cz) const;
+        int countNeighbours(std::size_t i, float const* x, float const* y,
+            float const* z, float radiusSq, int* out) const;
+
+        float mInvCellSize = 1.0f;
+        std::size_t mCount = 0;
+        std::size_t mTableMask = 0;
+        std::size_t mChunks = 1;
+
+        IntArray mCellX, mCellY, mCellZ;
+        IntArray mBucket;
+        IntArray mBucketStart;
+        IntArray mChunkCounts;
+        IntArray mSorted;
+
+        IntArray mNeighbourOffsets;
+        IntArray mNeighbours;
+    };
+}
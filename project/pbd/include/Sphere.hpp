@@ -14,6 +14,7 @@ namespace pbd
         Sphere(std::string const& textureFile);
 
         void setPosition(atlas::math::Point const& pos);
+        void setRadius(float radius);
         void renderGeometry(atlas::math::Matrix4 const& projection,
             atlas::math::Matrix4 const& view) override;
 
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ParticleSet.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace pbd
+{
+    //two consecutive position states (structure of arrays) and the blend
+    //factor between them, e.g. the solver's previous and current state or
+    //two frames of a SimCache
+    struct FramePair
+    {
+        float const* prevX;
+        float const* prevY;
+        float const* prevZ;
+        float const* x;
+        float const* y;
+        float const* z;
+        float alpha;
+
+        Vector3 at(std::size_t i) const
+        {
+            return Vector3(prevX[i] + (x[i] - prevX[i])*alpha,
+                prevY[i] + (y[i] - prevY[i])*alpha,
+                prevZ[i] + (z[i] - prevZ[i])*alpha);
+        }
+    };
+
+    FramePair interpolation(ParticleSet const& particles, float alpha);
+
+    //triangle surface over the particles used for drawing. build() stores
+    //the triangles touching each vertex (CSR) so that write() can produce
+    //positions and area-weighted normals in a single pass over the
+    //vertices: every vertex gathers from its own triangles, so the pass
+    //splits across threads without atomics and always sums in the same
+    //order.
+    class SurfaceMesh
+    {
+    public:
+        void build(std::vector<unsigned int> const& triangles,
+            std::size_t vertexCount);
+
+        //writes the particle positions blended by alpha (see
+        //ParticleSet::interpolated) and their unit normals, three floats per
+        //vertex each, straight into the destination (e.g. a mapped buffer)
+        void write(ParticleSet const& particles, float alpha, float* positions,
+            float* normals, ThreadPool* pool) const;
+        void write(FramePair const& frames, float* positions, float* normals,
+            ThreadPool* pool) const;
+
+        std::size_t vertexCount() const;
+        std::vector<unsigned int> const& triangles() const;
+
+    private:
+        void writeRange(FramePair const& frames, float* positions,
+            float* normals, std::size_t begin, std::size_t end) const;
+
+        std::vector<unsigned int> mTriangles;
+        std::vector<int> mOffsets;
+        std::vector<int> mAdjacency;
+    };
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pbd
+{
+    //persistent pool of worker threads used by the solver. parallelFor splits
+    //[0, count) into one contiguous chunk per thread (the calling thread takes
+    //the first one) and returns once every chunk is done. The split depends
+    //only on count and the thread count, so runs are reproducible.
+    //parallelForDynamic is for items of uneven cost, such as whole solvers
+    //of different sizes: every thread starts on its own chunk but takes
+    //one item at a time, and a thread that runs out steals the back half
+    //of the largest chunk left. Which thread runs an item then varies from
+    //run to run, so the items must not depend on each other.
+    class ThreadPool
+    {
+    public:
+        //non-owning reference to a callable taking (begin, end). A task only
+        //runs while parallelFor is being called, so unlike std::function,
+        //which puts larger captures on the heap, nothing is copied.
+        class Task
+        {
+        public:
+            template <typename Fn>
+            Task(Fn const& fn) :
+                mObject(&fn),
+                mCall(&call<Fn>)
+            {}
+
+            void operator()(std::size_t begin, std::size_t end) const
+            {
+                mCall(mObject, begin, end);
+            }
+
+        private:
+            template <typename Fn>
+            static void call(void const* object, std::size_t begin,
+                std::size_t end)
+            {
+                (*static_cast<Fn const*>(object))(begin, end);
+            }
+
+            void const* mObject;
+            void (*mCall)(void const*, std::size_t, std::size_t);
+        };
+
+        explicit ThreadPool(std::size_t threadCount);
+        ~ThreadPool();
+
+        ThreadPool(ThreadPool const&) = delete;
+        ThreadPool& operator=(ThreadPool const&) = delete;
+
+        std::size_t size() const;
+        void parallelFor(std::size_t count, Task const& task);
+        void parallelForDynamic(std::size_t count, Task const& task);
+
+    private:
+        //[begin, end) of the items a thread has left, packed into one word
+        //(begin in the high half) so that the owner taking the front and a
+        //thief taking the back agree through a single compare and swap.
+        //Padded to a cache line so neighbouring threads do not contend.
+        struct StealRange
+        {
+            std::atomic<std::uint64_t> range;
+            char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+        };
+
+        void run(std::size_t count, Task const& task, bool dynamic);
+        void workerLoop(std::size_t index);
+        void runChunk(std::size_t index);
+        void runStealing(std::size_t index);
+        bool steal(std::size_t index);
+
+        std::vector<std::thread> mWorkers;
+        std::mutex mMutex;
+        std::condition_variable mStart;
+        std::condition_variable mDone;
+
+        Task const* mTask;
+        std::size_t mCount;
+        bool mDynamic;
+        std::unique_ptr<StealRange[]> mRanges;
+        std::atomic<std::uint64_t> mGeneration;
+        std::atomic<std::size_t> mPending;
+        bool mStop;
+    };
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+
+namespace pbd
+{
+    //hands the latest value from one writer thread to one reader thread
+    //without either side waiting. The writer fills back() and publish()
+    //swaps it with the middle slot; the reader's update() swaps the middle
+    //slot with front() when something new has been published since. The
+    //reader therefore always sees the newest complete value, and values
+    //published in between are dropped.
+    template <typename T>
+    class TripleBuffer
+    {
+    public:
+        TripleBuffer() :
+            mMiddle(1),
+            mBack(2),
+            mFront(0)
+        {}
+
+        TripleBuffer(TripleBuffer const&) = delete;
+        TripleBuffer& operator=(TripleBuffer const&) = delete;
+
+        //writer side
+        T& back()
+        {
+            return mSlots[mBack];
+        }
+
+        void publish()
+        {
+            mBack = mMiddle.exchange(mBack | kFresh, std::memory_order_acq_rel) & kIndex;
+        }
+
+        //reader side; false when nothing new was published
+        bool update()
+        {
+            if (!(mMiddle.load(std::memory_order_relaxed) & kFresh))
+            {
+                return false;
+            }
+            mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & kIndex;
+            return true;
+        }
+
+        T const& front() const
+        {
+            return mSlots[mFront];
+        }
+
+    private:
+        //the middle slot's index, with kFresh set while the reader has not
+        //taken it yet
+        static const int kIndex = 3;
+        static const int kFresh = 4;
+
+        T mSlots[3];
+        std::atomic<int> mMiddle;
+        int mBack;
+        int mFront;
+    };
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cmath>
+
+namespace pbd
+{
+    //minimal 3-vector used by the solver so that it does not depend on
+    //atlas (and through it GL) for its math
+    struct Vector3
+    {
+        Vector3() : x(0.0f), y(0.0f), z(0.0f) {}
+        Vector3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+        Vector3& operator+=(Vector3 const& v)
+        {
+            x += v.x; y += v.y; z += v.z;
+            return *this;
+        }
+
+        Vector3& operator-=(Vector3 const& v)
+        {
+            x -= v.x; y -= v.y; z -= v.z;
+            return *this;
+        }
+
+        Vector3& operator*=(float s)
+        {
+            x *= s; y *= s; z *= s;
+            return *this;
+        }
+
+        float x;
+        float y;
+        float z;
+    };
+
+    inline Vector3 operator+(Vector3 const& a, Vector3 const& b)
+    {
+        return Vector3(a.x + b.x, a.y + b.y, a.z + b.z);
+    }
+
+    inline Vector3 operator-(Vector3 const& a, Vector3 const& b)
+    {
+        return Vector3(a.x - b.x, a.y - b.y, a.z - b.z);
+    }
+
+    inline Vector3 operator-(Vector3 const& a)
+    {
+        return Vector3(-a.x, -a.y, -a.z);
+    }
+
+    inline Vector3 operator*(Vector3 const& a, float s)
+    {
+        return Vector3(a.x*s, a.y*s, a.z*s);
+    }
+
+    inline Vector3 operator*(float s, Vector3 const& a)
+    {
+        return Vector3(a.x*s, a.y*s, a.z*s);
+    }
+
+    inline Vector3 operator/(Vector3 const& a, float s)
+    {
+        return Vector3(a.x/s, a.y/s, a.z/s);
+    }
+
+    inline float dot(Vector3 const& a, Vector3 const& b)
+    {
+        return a.x*b.x + a.y*b.y + a.z*b.z;
+    }
+
+    inline Vector3 cross(Vector3 const& a, Vector3 const& b)
+    {
+        return Vector3(a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x);
+    }
+
+    inline float mag(Vector3 const& v)
+    {
+        return std::sqrt(dot(v, v));
+    }
+
+    inline Vector3 normalize(Vector3 const& v)
+    {
+        return v/mag(v);
+    }
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+#include "LayoutLocations.glsl"
+layout(location = VERTICES_LAYOUT_LOCATION) in vec3 position;
+layout(location = NORMALS_LAYOUT_LOCATION) in vec3 normal;
+layout(location = INSTANCES_LAYOUT_LOCATION) in vec3 offset;
+
+out VertexData
+{
+    vec3 position;
+    vec3 normal;
+} outData;
+
+#include "UniformMatrices.glsl"
+
+uniform float particleScale;
+
+void main()
+{
+    //one instance per particle, the proxy is scaled and moved to it
+    vec4 world = model * vec4(position * particleScale + offset, 1.0);
+    gl_Position = projection * view * world;
+
+    outData.position = world.xyz;
+    outData.normal = (transpose(inverse(model)) * vec4(normal, 0)).xyz;
+}
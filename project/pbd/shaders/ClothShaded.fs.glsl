@@ -0,0 +1,33 @@
+#version 330 core
+
+in VertexData
+{
+    vec3 position;
+    vec3 normal;
+} inData;
+
+uniform vec3 materialColour;
+
+out vec4 fragColour;
+
+vec3 shadedColour()
+{
+    vec3 lightPosition = vec3(0, 20, 10);
+    vec3 lightColour = vec3(1, 1, 1);
+    float ambient = 0.25;
+
+    //the cloth is seen from both sides
+    vec3 n = normalize(inData.normal);
+    if (!gl_FrontFacing)
+    {
+        n = -n;
+    }
+    vec3 l = normalize(lightPosition - inData.position);
+    float diffuse = max(dot(n, l), 0.0);
+    return (ambient + (1.0 - ambient) * diffuse) * lightColour * materialColour;
+}
+
+void main()
+{
+    fragColour = vec4(shadedColour(), 1.0);
+}
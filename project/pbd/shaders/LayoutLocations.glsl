@@ -4,5 +4,6 @@
 #define VERTICES_LAYOUT_LOCATION 0
 #define NORMALS_LAYOUT_LOCATION 1
 #define TEXTURES_LAYOUT_LOCATION 2
+#define INSTANCES_LAYOUT_LOCATION 3
 
 #endif
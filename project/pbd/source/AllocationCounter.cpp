@@ -0,0 +1,21 @@
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+
+namespace pbd
+{
+    namespace
+    {
+        std::atomic<std::size_t> allocations(0);
+    }
+
+    std::size_t allocationCount()
+    {
+        return allocations.load(std::memory_order_relaxed);
+    }
+
+    void countAllocation()
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,76 @@
+#include "Arena.hpp"
+#include "AlignedAllocator.hpp"
+
+#include <cstdint>
+
+namespace pbd
+{
+    Arena::Arena(std::size_t bytes) :
+        mBlock(AlignedAllocator<char, kArenaAlignment>().allocate(bytes)),
+        mCapacity(bytes),
+        mOwned(true)
+    {}
+
+    Arena::Arena(void* block, std::size_t bytes) :
+        mBlock(static_cast<char*>(block)),
+        mCapacity(bytes),
+        mOwned(false)
+    {}
+
+    Arena::~Arena()
+    {
+        if (mOwned)
+        {
+            AlignedAllocator<char, kArenaAlignment>().deallocate(mBlock, mCapacity);
+        }
+    }
+
+    void* Arena::allocate(std::size_t bytes, std::size_t alignment)
+    {
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(mBlock);
+        std::uintptr_t start = (base + mUsed + alignment - 1) & ~(std::uintptr_t)(alignment - 1);
+        std::size_t offset = (std::size_t)(start - base);
+        if (!mBlock || offset > mCapacity || bytes > mCapacity - offset)
+        {
+            mOverflow += bytes;
+            return nullptr;
+        }
+        mUsed = offset + bytes;
+        return mBlock + offset;
+    }
+
+    void Arena::release(void* ptr, std::size_t bytes)
+    {
+        char* p = static_cast<char*>(ptr);
+        if (p + bytes == mBlock + mUsed)
+        {
+            mUsed = (std::size_t)(p - mBlock);
+        }
+    }
+
+    bool Arena::owns(void const* ptr) const
+    {
+        char const* p = static_cast<char const*>(ptr);
+        return mBlock && p >= mBlock && p < mBlock + mCapacity;
+    }
+
+    std::size_t Arena::capacity() const
+    {
+        return mCapacity;
+    }
+
+    std::size_t Arena::used() const
+    {
+        return mUsed;
+    }
+
+    std::size_t Arena::overflow() const
+    {
+        return mOverflow;
+    }
+
+    std::size_t arenaBytes(std::size_t bytes)
+    {
+        return (bytes + kArenaAlignment - 1) & ~(kArenaAlignment - 1);
+    }
+}
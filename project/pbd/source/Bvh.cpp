@@ -0,0 +1,255 @@
+#include "Bvh.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace pbd
+{
+    namespace
+    {
+        const int kBins = 16;
+        const int kMaxLeafSize = 4;
+        //query traversal keeps at most one pending sibling per level, so
+        //capping the build depth keeps the fixed size stack sufficient
+        const int kStackSize = 64;
+        const int kMaxDepth = kStackSize - 2;
+
+        Aabb emptyBox()
+        {
+            return {Vector3(FLT_MAX, FLT_MAX, FLT_MAX),
+                Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX)};
+        }
+
+        void grow(Aabb& box, Vector3 const& p)
+        {
+            box.min = Vector3(std::min(box.min.x, p.x), std::min(box.min.y, p.y),
+                std::min(box.min.z, p.z));
+            box.max = Vector3(std::max(box.max.x, p.x), std::max(box.max.y, p.y),
+                std::max(box.max.z, p.z));
+        }
+
+        void grow(Aabb& box, Aabb const& other)
+        {
+            grow(box, other.min);
+            grow(box, other.max);
+        }
+
+        float area(Aabb const& box)
+        {
+            Vector3 e = box.max - box.min;
+            if (e.x < 0.0f)
+            {
+                return 0.0f;
+            }
+            return 2.0f * (e.x*e.y + e.y*e.z + e.z*e.x);
+        }
+
+        float axis(Vector3 const& v, int a)
+        {
+            return (a == 0) ? v.x : ((a == 1) ? v.y : v.z);
+        }
+
+        bool overlaps(Aabb const& a, Aabb const& b)
+        {
+            return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+                a.min.y <= b.max.y && a.max.y >= b.min.y &&
+                a.min.z <= b.max.z && a.max.z >= b.min.z;
+        }
+    }
+
+    void Bvh::build(std::vector<Vector3> const& vertices,
+        std::vector<unsigned int> const& indices)
+    {
+        int triCount = (int)(indices.size() / 3);
+        mNodes.clear();
+        mTriangles.resize(triCount);
+        if (triCount == 0)
+        {
+            return;
+        }
+
+        std::vector<Aabb> triBounds(triCount);
+        std::vector<Vector3> centroids(triCount);
+        for (int t = 0; t < triCount; ++t)
+        {
+            Vector3 const& a = vertices[indices[3*t]];
+            Vector3 const& b = vertices[indices[3*t + 1]];
+            Vector3 const& c = vertices[indices[3*t + 2]];
+            triBounds[t] = emptyBox();
+            grow(triBounds[t], a);
+            grow(triBounds[t], b);
+            grow(triBounds[t], c);
+            centroids[t] = (a + b + c) / 3.0f;
+            mTriangles[t] = t;
+        }
+
+        mNodes.reserve(2 * triCount);
+        Node root;
+        root.leftFirst = 0;
+        root.count = triCount;
+        root.bounds = emptyBox();
+        for (int t = 0; t < triCount; ++t)
+        {
+            grow(root.bounds, triBounds[t]);
+        }
+        mNodes.push_back(root);
+        subdivide(0, 0, triBounds, centroids);
+    }
+
+    void Bvh::subdivide(int node, int depth, std::vector<Aabb> const& triBounds,
+        std::vector<Vector3> const& centroids)
+    {
+        int first = mNodes[node].leftFirst;
+        int count = mNodes[node].count;
+        if (count <= kMaxLeafSize || depth >= kMaxDepth)
+        {
+            return;
+        }
+
+        Aabb centroidBox = emptyBox();
+        for (int k = first; k < first + count; ++k)
+        {
+            grow(centroidBox, centroids[mTriangles[k]]);
+        }
+
+        //binned SAH: the cheapest of the bin boundaries on all three axes
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        int bestSplit = 0;
+        for (int a = 0; a < 3; ++a)
+        {
+            float lo = axis(centroidBox.min, a);
+            float hi = axis(centroidBox.max, a);
+            if (hi <= lo)
+            {
+                continue;
+            }
+
+            Aabb binBounds[kBins];
+            int binCounts[kBins] = {};
+            for (int b = 0; b < kBins; ++b)
+            {
+                binBounds[b] = emptyBox();
+            }
+
+            float scale = kBins / (hi - lo);
+            for (int k = first; k < first + count; ++k)
+            {
+                int t = mTriangles[k];
+                int b = std::min(kBins - 1,
+                    (int)((axis(centroids[t], a) - lo) * scale));
+                binCounts[b]++;
+                grow(binBounds[b], triBounds[t]);
+            }
+
+            float leftArea[kBins - 1];
+            int leftCount[kBins - 1];
+            Aabb box = emptyBox();
+            int sum = 0;
+            for (int b = 0; b < kBins - 1; ++b)
+            {
+                sum += binCounts[b];
+                grow(box, binBounds[b]);
+                leftArea[b] = area(box);
+                leftCount[b] = sum;
+            }
+
+            box = emptyBox();
+            sum = 0;
+            for (int b = kBins - 1; b > 0; --b)
+            {
+                sum += binCounts[b];
+                grow(box, binBounds[b]);
+                float cost = leftCount[b - 1] * leftArea[b - 1] + sum * area(box);
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = a;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        if (bestAxis < 0 || bestCost >= count * area(mNodes[node].bounds))
+        {
+            return;
+        }
+
+        float lo = axis(centroidBox.min, bestAxis);
+        float scale = kBins / (axis(centroidBox.max, bestAxis) - lo);
+        auto middle = std::partition(mTriangles.begin() + first,
+            mTriangles.begin() + first + count, [&](int t)
+        {
+            int b = std::min(kBins - 1,
+                (int)((axis(centroids[t], bestAxis) - lo) * scale));
+            return b < bestSplit;
+        });
+
+        int leftCount = (int)(middle - (mTriangles.begin() + first));
+        if (leftCount == 0 || leftCount == count)
+        {
+            return;
+        }
+
+        int left = (int)mNodes.size();
+        Node children[2];
+        children[0].leftFirst = first;
+        children[0].count = leftCount;
+        children[1].leftFirst = first + leftCount;
+        children[1].count = count - leftCount;
+        for (auto& child : children)
+        {
+            child.bounds = emptyBox();
+            for (int k = child.leftFirst; k < child.leftFirst + child.count; ++k)
+            {
+                grow(child.bounds, triBounds[mTriangles[k]]);
+            }
+        }
+        mNodes.push_back(children[0]);
+        mNodes.push_back(children[1]);
+
+        mNodes[node].leftFirst = left;
+        mNodes[node].count = 0;
+
+        subdivide(left, depth + 1, triBounds, centroids);
+        subdivide(left + 1, depth + 1, triBounds, centroids);
+    }
+
+    void Bvh::query(Aabb const& box, IntArray& out) const
+    {
+        if (mNodes.empty())
+        {
+            return;
+        }
+
+        int stack[kStackSize];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            Node const& node = mNodes[stack[--top]];
+            if (!overlaps(node.bounds, box))
+            {
+                continue;
+            }
+
+            if (node.count > 0)
+            {
+                for (int k = node.leftFirst; k < node.leftFirst + node.count; ++k)
+                {
+                    out.push_back(mTriangles[k]);
+                }
+            }
+            else
+            {
+                stack[top++] = node.leftFirst;
+                stack[top++] = node.leftFirst + 1;
+            }
+        }
+    }
+
+    bool Bvh::empty() const
+    {
+        return mNodes.empty();
+    }
+}
@@ -1,10 +1,3 @@
-/*
-  TODO:
-    - render mesh w/vertices at particle positions
-      - if possible in atlas framework?
-    - add more constraints (stretch, bend, etc.)
-*/
-
 #include "Cloth.hpp"
 #include "Paths.hpp"
 #include "LayoutLocations.glsl"
@@ -12,573 +5,622 @@
 #include <atlas/utils/Mesh.hpp>
 #include <atlas/core/GLFW.hpp>
 #include <atlas/utils/GUI.hpp>
+#include <algorithm>
+#include <cstdio>
 #include <math.h>
+#include <memory>
+#include <thread>
 
 namespace pbd
 {
 
-    Cloth::Cloth() :
-        mVertexBuffer(GL_ARRAY_BUFFER),
-        mIndexBuffer(GL_ELEMENT_ARRAY_BUFFER)
+    Cloth::Cloth(Scene const& scene) :
+        mScene(scene),
+        mPool(std::max(1u, std::thread::hardware_concurrency())),
+        mSurfaceIndexBuffer(GL_ELEMENT_ARRAY_BUFFER),
+        mProxyBuffer(GL_ARRAY_BUFFER),
+        mProxyIndexBuffer(GL_ELEMENT_ARRAY_BUFFER),
+        mInstanceBuffer(GL_ARRAY_BUFFER),
+        mRecordedFrames(0)
+    {
+        std::string error;
+        if (!applyScene(mScene, mSolver, error))
+        {
+            //keep going with the default cloth
+            std::fprintf(stderr, "%s\n", error.c_str());
+        }
+        for (int t = 0; t < kConstraintTypeCount; t++){
+            ConstraintType type = static_cast<ConstraintType>(t);
+            mCompliance[t] = mSolver.compliance(type);
+            mEnabled[t] = mSolver.constraintEnabled(type);
+        }
+        mQuantize = mScene.quantize;
+        mStepSize = mScene.stepSize;
+
+        //the thread starts paused with the first frame already published
+        mSim.reset(new SimulationThread(mSolver, mStepSize));
+        mSim->update();
+        mShape = mSim->frame().shape;
+        createSurface();
+        createParticles();
+
+        loadShader("ClothSurface.vs.glsl", mSurfaceUniforms);
+        loadShader("ClothParticle.vs.glsl", mParticleUniforms);
+        mModel = atlas::math::Matrix4(1.0f);
+    }
+
+    Cloth::~Cloth()
+    {
+        //the step hook writes to mRecorder, so the thread has to stop first
+        mSim.reset();
+        glDeleteVertexArrays(kSurfaceRing, mSurfaceVaos);
+        glDeleteBuffers(kSurfaceRing, mSurfaceBuffers);
+    }
+
+    void Cloth::createSurface()
     {
-        using atlas::utils::Mesh;
         namespace gl = atlas::gl;
-        namespace math = atlas::math;
 
-        Mesh sphere;
-        std::string path{ DataDirectory };
-        path = path + "sphere.obj";
-        Mesh::fromFile(path, sphere);
+        SimFrame const& frame = mSim->frame();
+        std::size_t count = frame.size();
+        mSurface.build(frame.triangles, count);
+        auto const& triangles = mSurface.triangles();
+        mSurfaceIndexCount = static_cast<GLsizei>(triangles.size());
+
+        mSurfaceIndexBuffer.bindBuffer();
+        mSurfaceIndexBuffer.bufferData(gl::size<GLuint>(triangles.size()),
+            triangles.data(), GL_STATIC_DRAW);
+        mSurfaceIndexBuffer.unBindBuffer();
+
+        //attribute layout is fixed per buffer, so it is set up only here.
+        //Loading a state of a different size comes back through here;
+        //deleting the zero names of the first call is a no-op.
+        glDeleteVertexArrays(kSurfaceRing, mSurfaceVaos);
+        glDeleteBuffers(kSurfaceRing, mSurfaceBuffers);
+        glGenBuffers(kSurfaceRing, mSurfaceBuffers);
+        glGenVertexArrays(kSurfaceRing, mSurfaceVaos);
+        for (int k = 0; k < kSurfaceRing; k++){
+            glBindVertexArray(mSurfaceVaos[k]);
+            glBindBuffer(GL_ARRAY_BUFFER, mSurfaceBuffers[k]);
+            glBufferData(GL_ARRAY_BUFFER, gl::size<float>(6*count), nullptr,
+                GL_STREAM_DRAW);
+            glVertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
+                GL_FALSE, gl::stride<float>(3), gl::bufferOffset<float>(0));
+            glVertexAttribPointer(NORMALS_LAYOUT_LOCATION, 3, GL_FLOAT,
+                GL_FALSE, gl::stride<float>(3), gl::bufferOffset<float>(3*count));
+            glEnableVertexAttribArray(VERTICES_LAYOUT_LOCATION);
+            glEnableVertexAttribArray(NORMALS_LAYOUT_LOCATION);
+            mSurfaceIndexBuffer.bindBuffer();
+        }
 
-        mIndexCount = static_cast<GLsizei>(sphere.indices().size());
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mSurfaceIndexBuffer.unBindBuffer();
+    }
 
-        std::vector<float> data;
-        for (std::size_t i = 0; i < sphere.vertices().size(); ++i)
-        {
-            data.push_back(sphere.vertices()[i].x);
-            data.push_back(sphere.vertices()[i].y);
-            data.push_back(sphere.vertices()[i].z);
+    void Cloth::createParticles()
+    {
+        namespace gl = atlas::gl;
 
-            data.push_back(sphere.normals()[i].x);
-            data.push_back(sphere.normals()[i].y);
-            data.push_back(sphere.normals()[i].z);
-        }
+        //unit octahedron, flat shaded so every face has its own vertices
+        const float corners[6][3] =
+        {
+            {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}
+        };
+        const int faces[8][3] =
+        {
+            {0, 2, 4}, {4, 2, 1}, {1, 2, 5}, {5, 2, 0},
+            {4, 3, 0}, {1, 3, 4}, {5, 3, 1}, {0, 3, 5}
+        };
 
-        //create Particle vector grid
-        for(int i = 0; i < (int)mWidth; i++){
-            for (int j = 0; j < (int)mLength; j++){
-                float mass = mMass/(mWidth*mLength);
-                atlas::math::Vector pos;
-                pos = atlas::math::Vector(mWidth*((float)i/mWidth) - mWidth/2.0f,mHeight,mLength*((float)j/mLength) - mLength/2.0f);
-                Particle p(mass, pos);
-                mParticles.push_back(p);
+        std::vector<float> data;
+        std::vector<GLuint> indices;
+        for (int f = 0; f < 8; f++){
+            Vector3 v[3];
+            for (int k = 0; k < 3; k++){
+                float const* c = corners[faces[f][k]];
+                v[k] = Vector3(c[0], c[1], c[2]);
+            }
+            Vector3 n = normalize(cross(v[1] - v[0], v[2] - v[0]));
+            for (int k = 0; k < 3; k++){
+                data.push_back(v[k].x);
+                data.push_back(v[k].y);
+                data.push_back(v[k].z);
+                data.push_back(n.x);
+                data.push_back(n.y);
+                data.push_back(n.z);
+                indices.push_back(static_cast<GLuint>(indices.size()));
             }
         }
+        mProxyIndexCount = static_cast<GLsizei>(indices.size());
+        mInstanceData.assign(3*mSim->frame().size(), 0.0f);
 
-        mParticles[0].setMovable(false);
-        mParticles[mWidth-1].setMovable(false);
-        mParticles[mWidth-1].mPosition += (mParticles[0].mPosition - mParticles[mWidth-1].mPosition)*(1/(2*mWidth));
-
-        mVao.bindVertexArray();
-        mVertexBuffer.bindBuffer();
-        mVertexBuffer.bufferData(gl::size<float>(data.size()), data.data(),
+        mParticleVao.bindVertexArray();
+        mProxyBuffer.bindBuffer();
+        mProxyBuffer.bufferData(gl::size<float>(data.size()), data.data(),
             GL_STATIC_DRAW);
-        mVertexBuffer.vertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
-            GL_FALSE, gl::stride<float>(8), gl::bufferOffset<float>(0));
-        mVertexBuffer.vertexAttribPointer(NORMALS_LAYOUT_LOCATION, 3, GL_FLOAT,
-            GL_FALSE, gl::stride<float>(8), gl::bufferOffset<float>(3));
-
-        mVao.enableVertexAttribArray(VERTICES_LAYOUT_LOCATION);
-        mVao.enableVertexAttribArray(NORMALS_LAYOUT_LOCATION);
-
-        mIndexBuffer.bindBuffer();
-        mIndexBuffer.bufferData(gl::size<GLuint>(sphere.indices().size()),
-            sphere.indices().data(), GL_STATIC_DRAW);
+        mProxyBuffer.vertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
+            GL_FALSE, gl::stride<float>(6), gl::bufferOffset<float>(0));
+        mProxyBuffer.vertexAttribPointer(NORMALS_LAYOUT_LOCATION, 3, GL_FLOAT,
+            GL_FALSE, gl::stride<float>(6), gl::bufferOffset<float>(3));
+
+        mParticleVao.enableVertexAttribArray(VERTICES_LAYOUT_LOCATION);
+        mParticleVao.enableVertexAttribArray(NORMALS_LAYOUT_LOCATION);
+
+        //per-instance particle positions, advanced once per proxy
+        mInstanceBuffer.bindBuffer();
+        mInstanceBuffer.bufferData(gl::size<float>(mInstanceData.size()),
+            mInstanceData.data(), GL_DYNAMIC_DRAW);
+        mInstanceBuffer.vertexAttribPointer(INSTANCES_LAYOUT_LOCATION, 3,
+            GL_FLOAT, GL_FALSE, gl::stride<float>(3), gl::bufferOffset<float>(0));
+        mParticleVao.enableVertexAttribArray(INSTANCES_LAYOUT_LOCATION);
+        glVertexAttribDivisor(INSTANCES_LAYOUT_LOCATION, 1);
+
+        mProxyIndexBuffer.bindBuffer();
+        mProxyIndexBuffer.bufferData(gl::size<GLuint>(indices.size()),
+            indices.data(), GL_STATIC_DRAW);
+
+        mParticleVao.unBindVertexArray();
+        mProxyIndexBuffer.unBindBuffer();
+        mInstanceBuffer.unBindBuffer();
+    }
 
-        mIndexBuffer.unBindBuffer();
-        mVertexBuffer.unBindBuffer();
-        mVao.unBindVertexArray();
+    void Cloth::loadShader(std::string const& vertexShader,
+        ShaderUniforms& uniforms)
+    {
+        namespace gl = atlas::gl;
 
         std::vector<gl::ShaderUnit> shaders
         {
-            {std::string(ShaderDirectory) + "Cloth.vs.glsl", GL_VERTEX_SHADER},
-            {std::string(ShaderDirectory) + "Cloth.fs.glsl", GL_FRAGMENT_SHADER}
+            {std::string(ShaderDirectory) + vertexShader, GL_VERTEX_SHADER},
+            {std::string(ShaderDirectory) + "ClothShaded.fs.glsl", GL_FRAGMENT_SHADER}
         };
 
         mShaders.emplace_back(shaders);
-        mShaders[0].setShaderIncludeDir(ShaderDirectory);
-        mShaders[0].compileShaders();
-        mShaders[0].linkShaders();
-
-        auto var = mShaders[0].getUniformVariable("model");
-        mUniforms.insert(UniformKey("model", var));
-        var = mShaders[0].getUniformVariable("projection");
-        mUniforms.insert(UniformKey("projection", var));
-        var = mShaders[0].getUniformVariable("view");
-        mUniforms.insert(UniformKey("view", var));
-
-        mShaders[0].disableShaders();
-        mModel = math::Matrix4(1.0f);
+        auto& shader = mShaders.back();
+        shader.setShaderIncludeDir(ShaderDirectory);
+        shader.compileShaders();
+        shader.linkShaders();
+
+        uniforms.model = shader.getUniformVariable("model");
+        uniforms.projection = shader.getUniformVariable("projection");
+        uniforms.view = shader.getUniformVariable("view");
+        uniforms.colour = shader.getUniformVariable("materialColour");
+        uniforms.scale = shader.getUniformVariable("particleScale");
+
+        shader.disableShaders();
     }
 
     void Cloth::setPosition(atlas::math::Point const& pos)
     {
-        mPosition = pos;
+        Vector3 p(pos.x, pos.y, pos.z);
+        mSim->post([p](Solver& solver) { solver.setSpherePosition(p); });
     }
 
-    void Cloth::updateGeometry(atlas::core::Time<> const& t)
+    void Cloth::addMeshCollider(std::string const& filename, float thickness)
     {
-        //for each particle in mesh:
-          //particle.velocity = particle.velocity + t*(particle.weight)*(external forces)*(particle.position)
-            //Symplectic Euler: vi(t0 + t) = vi(t0) + t(fi/mi)t0
-        for (uint i = 0; i < mParticles.size(); i++){
-            if (mParticles[i].mMovable){
-                mParticles[i].mVelocity += t.deltaTime*atlas::math::Vector(0.0f,mG,0.0f);
-            }else{
-                mParticles[i].mVelocity = atlas::math::Vector(0.0f,0.0f,0.0f);
-            }
-        }
+        using atlas::utils::Mesh;
 
-        //for each particle in mesh:
-          //particle.posprediction = particle.position + t*particle.velocity
-            //Symplectic Euler: xi(t0 + t) = xi(t0) + t(vi(t0 + t))
-        for (uint i = 0; i < mParticles.size(); i++){
-            mParticles[i].mPrediction = mParticles[i].mPosition + t.deltaTime*mParticles[i].mVelocity;
-        }
+        Mesh mesh;
+        Mesh::fromFile(std::string(DataDirectory) + filename, mesh);
 
-        //iteratively:
-          //project constraints onto each particle.posprediction
-        int iterations = 100;
-        for (int iter = 0; iter < iterations; iter++){
-            for(int i = 0; i < (int)mWidth; i++){
-                for(int j = 0; j < (int)mLength; j++){
-                    int index = j*(int)mWidth+i;
-                    if(i > 0){
-                        constrainDistance(index, index-1);
-                    }
-                    if(i < mWidth-1){
-                        constrainDistance(index, index+1);
-                    }
-                    if(j > 0){
-                        constrainDistance(index, index-(int)mWidth);
-                    }
-                    if(j < mHeight-1){
-                        constrainDistance(index, index+(int)mWidth);
-                    }
-                }
-            }
-
-            //for each particle in mesh:
-              //update particle.posprediction based on collision constraints
-            for (uint i = 0; i < mParticles.size(); i++){
-                //collision constraint with sphere of radius 2 at position
-                atlas::math::Vector outvector = mParticles[i].mPrediction - mPosition;
-                if (mag(outvector) < mRadius){
-                    mParticles[i].mPrediction += normalize(outvector)*(mRadius-mag(outvector));
-                }
-
-                //collision with "ground" at y = 0
-                if (mParticles[i].mPrediction.y < 0.0f){
-                    mParticles[i].mPrediction.y = 0.0f;
-                }
-            }
+        std::vector<Vector3> vertices;
+        vertices.reserve(mesh.vertices().size());
+        for (auto const& v : mesh.vertices())
+        {
+            vertices.push_back(Vector3(v.x, v.y, v.z));
         }
 
-        //for each particle in mesh:
-          //particle.velocity = (particle.posprediction - particle.position)/t
-          //particle.position = particle.posprediction
-        for (uint i = 0; i < mParticles.size(); i++){
-            if(mParticles[i].mMovable){
-                mParticles[i].mVelocity = (mParticles[i].mPrediction - mParticles[i].mPosition)/t.deltaTime;
-                mParticles[i].mPosition = mParticles[i].mPrediction;
-            }
+        std::vector<unsigned int> indices(mesh.indices().begin(),
+            mesh.indices().end());
+        if (!vertices.empty() && !indices.empty())
+        {
+            //the tree is built here rather than stalling the solver
+            auto collider = std::make_shared<MeshCollider>(std::move(vertices),
+                std::move(indices), thickness);
+            mSim->post([collider](Solver& solver)
+            {
+                solver.colliders().addMesh(std::move(*collider));
+            });
         }
-
     }
 
-    void Cloth::renderGeometry(atlas::math::Matrix4 const& projection,
-        atlas::math::Matrix4 const& view)
+    void Cloth::setPlaying(bool play)
     {
-        //currently renders small spheres at particle positions
-        namespace math = atlas::math;
-
-        mShaders[0].hotReloadShaders();
-        if (!mShaders[0].shaderProgramValid())
+        if (play == mSim->playing())
         {
             return;
         }
-
-        mShaders[0].enableShaders();
-
-        mVao.bindVertexArray();
-        mIndexBuffer.bindBuffer();
-
-        for (uint i = 0; i < mParticles.size(); i++){
-            auto mModeli = glm::translate(mModel, mParticles[i].mPosition) * glm::scale(atlas::math::Matrix4(1.0f), atlas::math::Vector(0.1f));
-            glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &mModeli[0][0]);
-            glUniformMatrix4fv(mUniforms["projection"], 1, GL_FALSE,
-                &projection[0][0]);
-            glUniformMatrix4fv(mUniforms["view"], 1, GL_FALSE, &view[0][0]);
-            const math::Vector grey{ 0.5f, 0.5f, 0.5f };
-            glUniform3fv(mUniforms["materialColour"], 1, &grey[0]);
-
-            glDrawElements(GL_TRIANGLES, mIndexCount, GL_UNSIGNED_INT, 0);
+        if (play)
+        {
+            mSim->play();
         }
+        else
+        {
+            mSim->pause();
+        }
+    }
 
-        mIndexBuffer.unBindBuffer();
-        mVao.unBindVertexArray();
-
-        mShaders[0].disableShaders();
+    void Cloth::updateGeometry(atlas::core::Time<> const&)
+    {
+        refresh();
     }
 
-    void Cloth::drawGui(){
-        ImGui::SetNextWindowSize(ImVec2(300, 200), ImGuiSetCond_FirstUseEver);
-        ImGui::Begin("Cloth Controls");
-        ImGui::End();
+    void Cloth::refresh()
+    {
+        mSim->update();
+        if (mSim->frame().shape != mShape)
+        {
+            mShape = mSim->frame().shape;
+            createSurface();
+            createParticles();
+        }
     }
 
-    void Cloth::resetGeometry()
+    bool Cloth::startRecording(std::string const& path, bool quantize)
     {
-        mParticles.clear();
-        for(int i = 0; i < (int)mWidth; i++){
-            for (int j = 0; j < (int)mLength; j++){
-                float mass = mMass/(mWidth*mLength);
-                atlas::math::Vector pos;
-                pos = atlas::math::Vector(mWidth*((float)i/mWidth) - mWidth/2.0f,mHeight,mLength*((float)j/mLength) - mLength/2.0f);
-                Particle p(mass, pos);
-                mParticles.push_back(p);
+        //the hook goes in first and skips steps until the file is open, so
+        //no step falls between the first frame and the appended ones
+        mSim->setStepHook([this](Solver const& solver)
+        {
+            if (mRecorder.isOpen() && mRecorder.append(solver.particles()))
+            {
+                mRecordedFrames++;
             }
+        });
+
+        //the first frame is the state recording starts from
+        bool ok = false;
+        float stepSize = mStepSize;
+        mSim->call([&](Solver& solver)
+        {
+            ok = mRecorder.open(path, solver.particles().size(), stepSize,
+                quantize) && mRecorder.append(solver.particles());
+            mRecordedFrames = ok ? 1 : 0;
+        });
+        if (!ok)
+        {
+            mSim->setStepHook(SimulationThread::StepHook());
+            mSim->call([this](Solver&) { mRecorder.close(); });
+            return false;
         }
+        mRecording = true;
+        return true;
     }
 
-    float Cloth::mag(atlas::math::Vector v)
+    void Cloth::stopRecording()
     {
-        return sqrt(v.x*v.x + v.y*v.y + v.z*v.z);
+        mSim->setStepHook(SimulationThread::StepHook());
+        mSim->call([this](Solver&) { mRecorder.close(); });
+        mRecording = false;
     }
 
-    void Cloth::constrainDistance(int p1, int p2)
+    bool Cloth::startPlayback(std::string const& path)
     {
-        atlas::math::Vector line = mParticles[p2].mPrediction - mParticles[p1].mPrediction;
-        float distance = mag(line);
-        atlas::math::Vector correction = line*(1 - mRest/distance);
-        if(mParticles[p1].mMovable && mParticles[p1].mMovable){
-            correction = 0.5f * correction;
-            mParticles[p1].mPrediction += correction;
-            mParticles[p2].mPrediction -= correction;
-        }else if(!mParticles[p1].mMovable){
-            mParticles[p2].mPrediction -= correction;
-        }else{
-            mParticles[p1].mPrediction += correction;
+        if (!mPlayer.open(path) ||
+            mPlayer.particleCount() != mSim->frame().size())
+        {
+            mPlayer.close();
+            return false;
         }
+        mPlaybackTime = 0.0f;
+        return true;
     }
-}
-/*
 
-#include "Cloth.hpp"
-#include "Paths.hpp"
-#include "LayoutLocations.glsl"
+    void Cloth::stopPlayback()
+    {
+        mPlayer.close();
+    }
 
-#include <atlas/utils/Mesh.hpp>
-#include <atlas/core/GLFW.hpp>
-#include <atlas/utils/GUI.hpp>
-#include <math.h>
+    bool Cloth::playingBack() const
+    {
+        return mPlayer.isOpen();
+    }
 
-namespace pbd
-{
+    void Cloth::seek(float time)
+    {
+        float end = mPlayer.duration();
+        mPlaybackTime = (time < 0.0f) ? 0.0f : (time > end) ? end : time;
+    }
 
-    Cloth::Cloth() :
-        mVertexBuffer(GL_ARRAY_BUFFER),
-        mIndexBuffer(GL_ELEMENT_ARRAY_BUFFER)
+    float Cloth::playbackTime() const
     {
-        using atlas::utils::Mesh;
-        namespace gl = atlas::gl;
-        namespace math = atlas::math;
+        return mPlaybackTime;
+    }
 
-        Mesh sphere;
-        std::string path{ DataDirectory };
-        path = path + "sphere.obj";
-        Mesh::fromFile(path, sphere);
-
-        mIndexCount = static_cast<GLsizei>(sphere.indices().size());
-
-        //create Particle vector grid
-        for(int i = 0; i < (int)mLength; i++){
-            for (int j = 0; j < (int)mWidth; j++){
-                float mass = mMass/(mWidth*mLength);
-                atlas::math::Vector pos;
-                pos = atlas::math::Vector(mWidth*((float)i/mWidth) - mWidth/2.0f,mHeight,mLength*((float)j/mLength) - mLength/2.0f);
-                Particle p(mass, pos);
-                mParticles.push_back(p);
-            }
-        }
+    bool Cloth::saveState(std::string const& path)
+    {
+        bool ok = false;
+        mSim->call([&](Solver& solver) { ok = solver.saveCheckpoint(path); });
+        return ok;
+    }
 
-        mParticles[0].setMovable(false);
-        mParticles[mWidth-1].setMovable(false);
-        mParticles[mWidth-1].mPosition += (mParticles[0].mPosition - mParticles[mWidth-1].mPosition)*(1/(2*mWidth));
+    bool Cloth::loadState(std::string const& path)
+    {
+        Scene scene = mScene;
+        scene.state = path;
+        if (!setUp(scene))
+        {
+            return false;
+        }
+        mScene = scene;
+        return true;
+    }
 
-        for(int i = 0; i < (int)mLength - 1; i++){
-            for(int j = 0; j < (int)mWidth - 1; j++){
-                mIndices.push_back(j);
-                mIndices.push_back(j + i);
-                mIndices.push_back(j + 1);
-                mIndices.push_back(j + i + 1);
+    bool Cloth::setUp(Scene const& scene)
+    {
+        bool ok = false;
+        std::string error;
+        mSim->call([&](Solver& solver)
+        {
+            ok = applyScene(scene, solver, error);
+            for (int t = 0; t < kConstraintTypeCount; t++){
+                ConstraintType type = static_cast<ConstraintType>(t);
+                mCompliance[t] = solver.compliance(type);
+                mEnabled[t] = solver.constraintEnabled(type);
             }
+        });
+        if (!ok)
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return false;
         }
 
-        mIndexCount = static_cast<GLsizei>(mIndices.size());
-
-        std::vector<float> data;
-
-        for (std::size_t i = 0; i < mParticles.size(); ++i)
-        {
-            data.push_back(mParticles[i].mPosition.x);
-            data.push_back(mParticles[i].mPosition.y);
-            data.push_back(mParticles[i].mPosition.z);
-
-            atlas::math::Vector norm;
-            if(i % ((int)mWidth-1) == 0 && i % ((int)mLength-1) == 0){
-                norm = normal(i, i-1, i-(int)mLength);
-            }else if(i % ((int)mWidth-1) == 0){
-                norm = normal(i, i+(int)mLength, i+(int)mLength);
-            }else if(i % ((int)mLength-1) == 0){
-                norm = normal(i, i-(int)mLength+1, i+1);
-            }else{
-                norm = normal(i, i+1, i+(int)mLength);
+        //call() returns once the new state is published. A different cloth
+        //needs new buffers, and recordings or caches of the old one no
+        //longer fit it.
+        std::uint64_t shape = mShape;
+        refresh();
+        if (mShape != shape)
+        {
+            if (mRecording)
+            {
+                stopRecording();
             }
-            data.push_back(norm.x);
-            data.push_back(norm.y);
-            data.push_back(norm.z);
+            stopPlayback();
         }
+        return true;
+    }
 
-        mVao.bindVertexArray();
-        mVertexBuffer.bindBuffer();
-        mVertexBuffer.bufferData(gl::size<float>(data.size()), data.data(),
-            GL_STATIC_DRAW);
-        mVertexBuffer.vertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
-            GL_FALSE, gl::stride<float>(8), gl::bufferOffset<float>(0));
-        mVertexBuffer.vertexAttribPointer(NORMALS_LAYOUT_LOCATION, 3, GL_FLOAT,
-            GL_FALSE, gl::stride<float>(8), gl::bufferOffset<float>(3));
-
-        mVao.enableVertexAttribArray(VERTICES_LAYOUT_LOCATION);
-        mVao.enableVertexAttribArray(NORMALS_LAYOUT_LOCATION);
-
-        mIndexBuffer.bindBuffer();
-        mIndexBuffer.bufferData(gl::size<GLuint>(sphere.indices().size()),
-            mIndices.data(), GL_STATIC_DRAW);
-
-        mIndexBuffer.unBindBuffer();
-        mVertexBuffer.unBindBuffer();
-        mVao.unBindVertexArray();
+    FramePair Cloth::currentFrames()
+    {
+        return mPlayer.isOpen() ? mPlayer.at(mPlaybackTime) :
+            mSim->frame().interpolation(mSim->alpha());
+    }
 
-        std::vector<gl::ShaderUnit> shaders
-        {
-            {std::string(ShaderDirectory) + "Cloth.vs.glsl", GL_VERTEX_SHADER},
-            {std::string(ShaderDirectory) + "Cloth.fs.glsl", GL_FRAGMENT_SHADER}
-        };
+    void Cloth::setProfiler(Profiler* profiler)
+    {
+        //the profiler takes samples from any thread
+        mProfiler = profiler;
+        mSim->call([profiler](Solver& solver) { solver.setProfiler(profiler); });
+    }
 
-        mShaders.emplace_back(shaders);
-        mShaders[0].setShaderIncludeDir(ShaderDirectory);
-        mShaders[0].compileShaders();
-        mShaders[0].linkShaders();
-
-        auto var = mShaders[0].getUniformVariable("model");
-        mUniforms.insert(UniformKey("model", var));
-        var = mShaders[0].getUniformVariable("projection");
-        mUniforms.insert(UniformKey("projection", var));
-        var = mShaders[0].getUniformVariable("view");
-        mUniforms.insert(UniformKey("view", var));
-
-        mShaders[0].disableShaders();
-        mModel = math::Matrix4(1.0f);
+    void Cloth::setView(ClothView view)
+    {
+        mView = view;
     }
 
-    void Cloth::setPosition(atlas::math::Point const& pos)
+    ClothView Cloth::view() const
     {
-        mPosition = pos;
+        return mView;
     }
 
-    void Cloth::updateGeometry(atlas::core::Time<> const& t)
+    void Cloth::renderGeometry(atlas::math::Matrix4 const& projection,
+        atlas::math::Matrix4 const& view)
     {
-        //for each particle in mesh:
-          //particle.velocity = particle.velocity + t*(particle.weight)*(external forces)*(particle.position)
-            //Symplectic Euler: vi(t0 + t) = vi(t0) + t(fi/mi)t0
-        for (uint i = 0; i < mParticles.size(); i++){
-            if (mParticles[i].mMovable){
-                mParticles[i].mVelocity += t.deltaTime*atlas::math::Vector(0.0f,mG,0.0f);
-            }else{
-                mParticles[i].mVelocity = atlas::math::Vector(0.0f,0.0f,0.0f);
-            }
+        if (mView == ClothView::Surface)
+        {
+            renderSurface(projection, view);
         }
-
-        //for each particle in mesh:
-          //particle.posprediction = particle.position + t*particle.velocity
-            //Symplectic Euler: xi(t0 + t) = xi(t0) + t(vi(t0 + t))
-        for (uint i = 0; i < mParticles.size(); i++){
-            mParticles[i].mPrediction = mParticles[i].mPosition + t.deltaTime*mParticles[i].mVelocity;
+        else
+        {
+            renderParticles(projection, view);
         }
+    }
 
-        //iteratively:
-          //project constraints onto each particle.posprediction
-        int iterations = 100;
-        for (int iter = 0; iter < iterations; iter++){
-            for(int i = 0; i < (int)mLength; i++){
-                for(int j = 0; j < (int)mWidth; j++){
-                    int index = j*(int)mWidth+i;
-                    if(i > 0){
-                        constrainDistance(index, index-1);
-                    }
-                    if(i < mWidth-1){
-                        constrainDistance(index, index+1);
-                    }
-                    if(j > 0){
-                        constrainDistance(index, index-(int)mWidth);
-                    }
-                    if(j < mHeight-1){
-                        constrainDistance(index, index+(int)mWidth);
-                    }
-                }
-            }
+    void Cloth::renderSurface(atlas::math::Matrix4 const& projection,
+        atlas::math::Matrix4 const& view)
+    {
+        namespace math = atlas::math;
 
-            //for each particle in mesh:
-              //update particle.posprediction based on collision constraints
-            for (uint i = 0; i < mParticles.size(); i++){
-                //collision constraint with sphere of radius 2 at position
-                atlas::math::Vector outvector = mParticles[i].mPrediction - mPosition;
-                if (mag(outvector) < mRadius){
-                    mParticles[i].mPrediction += normalize(outvector)*(mRadius-mag(outvector));
-                }
-
-                //collision with "ground" at y = 0
-                if (mParticles[i].mPrediction.y < 0.0f){
-                    mParticles[i].mPrediction.y = 0.0f;
-                }
-            }
+        auto& shader = mShaders[0];
+        shader.hotReloadShaders();
+        if (!shader.shaderProgramValid())
+        {
+            return;
         }
 
-        //for each particle in mesh:
-          //particle.velocity = (particle.posprediction - particle.position)/t
-          //particle.position = particle.posprediction
-        for (uint i = 0; i < mParticles.size(); i++){
-            if(mParticles[i].mMovable){
-                mParticles[i].mVelocity = (mParticles[i].mPrediction - mParticles[i].mPosition)/t.deltaTime;
-                mParticles[i].mPosition = mParticles[i].mPrediction;
+        //positions and normals go straight from the newest frame into the
+        //mapped buffer in one parallel pass
+        {
+            ScopedTimer timer(mProfiler, "upload");
+            std::size_t count = mSurface.vertexCount();
+            mSurfaceSlot = (mSurfaceSlot + 1) % kSurfaceRing;
+            glBindBuffer(GL_ARRAY_BUFFER, mSurfaceBuffers[mSurfaceSlot]);
+            void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                atlas::gl::size<float>(6*count),
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (!mapped)
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                return;
             }
+            float* positions = static_cast<float*>(mapped);
+            mSurface.write(currentFrames(), positions, positions + 3*count,
+                &mPool);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
 
+        ScopedTimer timer(mProfiler, "draw");
+        shader.enableShaders();
+        glUniformMatrix4fv(mSurfaceUniforms.model, 1, GL_FALSE, &mModel[0][0]);
+        glUniformMatrix4fv(mSurfaceUniforms.projection, 1, GL_FALSE,
+            &projection[0][0]);
+        glUniformMatrix4fv(mSurfaceUniforms.view, 1, GL_FALSE, &view[0][0]);
+        const math::Vector cloth{ 0.8f, 0.3f, 0.25f };
+        glUniform3fv(mSurfaceUniforms.colour, 1, &cloth[0]);
+
+        glBindVertexArray(mSurfaceVaos[mSurfaceSlot]);
+        glDrawElements(GL_TRIANGLES, mSurfaceIndexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        shader.disableShaders();
     }
 
-    void Cloth::renderGeometry(atlas::math::Matrix4 const& projection,
+    void Cloth::renderParticles(atlas::math::Matrix4 const& projection,
         atlas::math::Matrix4 const& view)
     {
-        //currently renders small spheres at particle positions
         namespace math = atlas::math;
-        namespace gl = atlas::gl;
 
-        mShaders[0].hotReloadShaders();
-        if (!mShaders[0].shaderProgramValid())
+        auto& shader = mShaders[1];
+        shader.hotReloadShaders();
+        if (!shader.shaderProgramValid())
         {
             return;
         }
 
-        mShaders[0].enableShaders();
-
-        mVao.bindVertexArray();
-        mIndexBuffer.bindBuffer();
-
-        std::vector<float> data;
-
-        for (std::size_t i = 0; i < mParticles.size(); ++i)
-        {
-            data.push_back(mParticles[i].mPosition.x);
-            data.push_back(mParticles[i].mPosition.y);
-            data.push_back(mParticles[i].mPosition.z);
-
-            atlas::math::Vector norm;
-            if(i % ((int)mWidth-1) == 0 && i % ((int)mLength-1) == 0){
-                norm = normal(i, i-1, i-(int)mLength);
-            }else if(i % ((int)mWidth-1) == 0){
-                norm = normal(i, i+(int)mLength, i+(int)mLength);
-            }else if(i % ((int)mLength-1) == 0){
-                norm = normal(i, i-(int)mLength+1, i+1);
-            }else{
-                norm = normal(i, i+1, i+(int)mLength);
+        //one upload of every particle position, then a single draw
+        std::size_t count = mInstanceData.size() / 3;
+        {
+            ScopedTimer timer(mProfiler, "upload");
+            FramePair frames = currentFrames();
+            for (std::size_t i = 0; i < count; i++){
+                Vector3 p = frames.at(i);
+                mInstanceData[3*i] = p.x;
+                mInstanceData[3*i+1] = p.y;
+                mInstanceData[3*i+2] = p.z;
             }
-            data.push_back(norm.x);
-            data.push_back(norm.y);
-            data.push_back(norm.z);
+            mInstanceBuffer.bindBuffer();
+            glBufferSubData(GL_ARRAY_BUFFER, 0,
+                atlas::gl::size<float>(mInstanceData.size()), mInstanceData.data());
+            mInstanceBuffer.unBindBuffer();
         }
 
-        mVao.bindVertexArray();
-        mVertexBuffer.bindBuffer();
-        mVertexBuffer.bufferData(gl::size<float>(data.size()), data.data(),
-            GL_STATIC_DRAW);
-        mVertexBuffer.vertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
-            GL_FALSE, gl::stride<float>(8), gl::bufferOffset<float>(0));
-        mVertexBuffer.vertexAttribPointer(NORMALS_LAYOUT_LOCATION, 3, GL_FLOAT,
-            GL_FALSE, gl::stride<float>(8), gl::bufferOffset<float>(3));
-
-        mVao.enableVertexAttribArray(VERTICES_LAYOUT_LOCATION);
-        mVao.enableVertexAttribArray(NORMALS_LAYOUT_LOCATION);
-
-        mIndexBuffer.bindBuffer();
-        mIndexBuffer.bufferData(gl::size<GLuint>(mIndices.size()),
-            mIndices.data(), GL_STATIC_DRAW);
-
-        glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &mModel[0][0]);
-        glUniformMatrix4fv(mUniforms["projection"], 1, GL_FALSE,
-            &projection[0][0]);
-        glUniformMatrix4fv(mUniforms["view"], 1, GL_FALSE, &view[0][0]);
-        const math::Vector grey{ 0.5f, 0.5f, 0.5f };
-        glUniform3fv(mUniforms["materialColour"], 1, &grey[0]);
-
-        glDrawElements(GL_LINES, mIndexCount, GL_UNSIGNED_INT, 0);
+        ScopedTimer timer(mProfiler, "draw");
 
-        glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &mModel[0][0]);
-        glUniformMatrix4fv(mUniforms["projection"], 1, GL_FALSE,
+        shader.enableShaders();
+        glUniformMatrix4fv(mParticleUniforms.model, 1, GL_FALSE, &mModel[0][0]);
+        glUniformMatrix4fv(mParticleUniforms.projection, 1, GL_FALSE,
             &projection[0][0]);
-        glUniformMatrix4fv(mUniforms["view"], 1, GL_FALSE, &view[0][0]);
+        glUniformMatrix4fv(mParticleUniforms.view, 1, GL_FALSE, &view[0][0]);
         const math::Vector grey{ 0.5f, 0.5f, 0.5f };
-        glUniform3fv(mUniforms["materialColour"], 1, &grey[0]);
+        glUniform3fv(mParticleUniforms.colour, 1, &grey[0]);
+        glUniform1f(mParticleUniforms.scale, 0.1f);
 
-        glDrawElements(GL_LINES, mIndexCount, GL_UNSIGNED_INT, 0);
+        mParticleVao.bindVertexArray();
+        glDrawElementsInstanced(GL_TRIANGLES, mProxyIndexCount, GL_UNSIGNED_INT,
+            0, static_cast<GLsizei>(count));
+        mParticleVao.unBindVertexArray();
 
-        mIndexBuffer.unBindBuffer();
-        mVertexBuffer.unBindBuffer();
-        mVao.unBindVertexArray();
-
-        mShaders[0].disableShaders();
+        shader.disableShaders();
     }
 
     void Cloth::drawGui(){
         ImGui::SetNextWindowSize(ImVec2(300, 200), ImGuiSetCond_FirstUseEver);
         ImGui::Begin("Cloth Controls");
-        ImGui::End();
-    }
-
-    void Cloth::resetGeometry()
-    {
-        mParticles.clear();
-        for(int i = 0; i < (int)mWidth; i++){
-            for (int j = 0; j < (int)mLength; j++){
-                float mass = mMass/(mWidth*mLength);
-                atlas::math::Vector pos;
-                pos = atlas::math::Vector(mWidth*((float)i/mWidth) - mWidth/2.0f,mHeight,mLength*((float)j/mLength) - mLength/2.0f);
-                Particle p(mass, pos);
-                mParticles.push_back(p);
+        int view = static_cast<int>(mView);
+        ImGui::RadioButton("Surface", &view, static_cast<int>(ClothView::Surface));
+        ImGui::SameLine();
+        ImGui::RadioButton("Particles", &view, static_cast<int>(ClothView::Particles));
+        mView = static_cast<ClothView>(view);
+
+        //cache recording and playback, to the scene's record file
+        const std::string cachePath = mScene.record.empty() ?
+            std::string("pbd_cache.bin") : mScene.record;
+        if (mRecording)
+        {
+            ImGui::Text("Recording: %d frames", mRecordedFrames.load());
+            if (ImGui::Button("Stop recording"))
+            {
+                stopRecording();
+            }
+        }
+        else if (!mPlayer.isOpen())
+        {
+            if (ImGui::Button("Record"))
+            {
+                startRecording(cachePath, mQuantize);
+            }
+            ImGui::SameLine();
+            ImGui::Checkbox("Quantize", &mQuantize);
+            ImGui::SameLine();
+            if (ImGui::Button("Play cache"))
+            {
+                startPlayback(cachePath);
+            }
+        }
+        if (mPlayer.isOpen())
+        {
+            float time = mPlaybackTime;
+            if (ImGui::SliderFloat("Time", &time, 0.0f, mPlayer.duration()))
+            {
+                seek(time);
+            }
+            if (ImGui::Button("Stop playback"))
+            {
+                stopPlayback();
             }
         }
-    }
-
-    float Cloth::mag(atlas::math::Vector v)
-    {
-        return sqrt(v.x*v.x + v.y*v.y + v.z*v.z);
-    }
 
-    atlas::math::Vector Cloth::normal(int p1, int p2, int p3){
-        atlas::math::Point pos1 = mParticles[p1].mPosition;
-        atlas::math::Point pos2 = mParticles[p2].mPosition;
-        atlas::math::Point pos3 = mParticles[p3].mPosition;
+        //settled states to start from, saved to the scene's checkpoint file
+        const std::string statePath = mScene.checkpoint.empty() ?
+            std::string("pbd_state.bin") : mScene.checkpoint;
+        if (ImGui::Button("Save state"))
+        {
+            saveState(statePath);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load state"))
+        {
+            loadState(statePath);
+        }
+        if (!mScene.state.empty())
+        {
+            ImGui::SameLine();
+            if (ImGui::Button("Reset to grid"))
+            {
+                mScene.state.clear();
+                resetGeometry();
+            }
+        }
 
-        atlas::math::Vector v1 = pos2-pos1;
-        atlas::math::Vector v2 = pos3-pos1;
+        int sleeping = mSim->frame().stats.sleepingTiles;
+        if (sleeping > 0)
+        {
+            ImGui::Text("Sleeping tiles: %d", sleeping);
+        }
 
-        return atlas::math::Vector(v1.y*v2.z - v1.z*v2.y, v1.z*v2.x - v1.x*v2.z, v1.x*v2.y - v1.y*v2.x);
+        for (int t = 0; t < kConstraintTypeCount; t++){
+            ConstraintType type = static_cast<ConstraintType>(t);
+            ImGui::PushID(t);
+            if (ImGui::Checkbox(constraintTypeName(type), &mEnabled[t])){
+                bool enabled = mEnabled[t];
+                mSim->post([type, enabled](Solver& solver)
+                {
+                    solver.setConstraintEnabled(type, enabled);
+                });
+            }
+            ImGui::SameLine();
+            if (ImGui::InputFloat("compliance", &mCompliance[t], 0.001f, 0.1f, 4)){
+                float compliance = mCompliance[t];
+                mSim->post([type, compliance](Solver& solver)
+                {
+                    solver.setCompliance(type, compliance);
+                });
+            }
+            ImGui::PopID();
+        }
+        ImGui::End();
     }
 
-    void Cloth::constrainDistance(int p1, int p2)
+    void Cloth::resetGeometry()
     {
-        atlas::math::Vector line = mParticles[p2].mPrediction - mParticles[p1].mPrediction;
-        float distance = mag(line);
-        atlas::math::Vector correction = line*(1 - mRest/distance);
-        if(mParticles[p1].mMovable && mParticles[p1].mMovable){
-            correction = 0.5f * correction;
-            mParticles[p1].mPrediction += correction;
-            mParticles[p2].mPrediction -= correction;
-        }else if(!mParticles[p1].mMovable){
-            mParticles[p2].mPrediction -= correction;
-        }else{
-            mParticles[p1].mPrediction += correction;
+        if (!setUp(mScene) && !mScene.state.empty())
+        {
+            //the state file has gone, fall back to the grid
+            mScene.state.clear();
+            setUp(mScene);
         }
     }
 }
-*/
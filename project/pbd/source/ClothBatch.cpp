@@ -0,0 +1,188 @@
+#include "ClothBatch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace pbd
+{
+    ClothBatch::ClothBatch() :
+        mPool(new ThreadPool(1))
+    {}
+
+    bool ClothBatch::setUp(Scene const& scene, std::string& error)
+    {
+        mInstances.clear();
+        mOffsets.clear();
+        mSurfaces.clear();
+        mFirstVertex.clear();
+        mTriangles.clear();
+
+        int threads = scene.threads.set ? scene.threads.value : 1;
+        threads = (threads > 0) ? threads : (int)std::thread::hardware_concurrency();
+        threads = (threads > 0) ? threads : 1;
+        if ((int)mPool->size() != threads)
+        {
+            mPool.reset(new ThreadPool(threads));
+        }
+
+        //one allocation for every solver, so they are never moved
+        mScene = scene;
+        mScene.threads = 1;
+        std::size_t count = (scene.instances > 0) ? scene.instances : 1;
+        std::vector<Solver>(count).swap(mInstances);
+        mErrors.assign(count, std::string());
+        if (!reset(error))
+        {
+            mInstances.clear();
+            return false;
+        }
+
+        //one block for every instance's arrays, in instance order
+        std::size_t bytes = 0;
+        for (auto const& solver : mInstances){
+            bytes += solver.storageBytes();
+        }
+        mStorage.reset(new Arena(bytes));
+        for (auto& solver : mInstances){
+            std::size_t size = solver.storageBytes();
+            solver.useStorage(mStorage->allocate(size, kArenaAlignment), size);
+        }
+
+        //instances go row by row on a square centred on the origin
+        std::size_t columns = (std::size_t)std::ceil(std::sqrt((double)count));
+        std::size_t rows = (count + columns - 1) / columns;
+        float spacing = scene.instanceSpacing;
+        for (std::size_t i = 0; i < count; i++){
+            float column = (float)(i % columns) - 0.5f*(columns - 1);
+            float row = (float)(i / columns) - 0.5f*(rows - 1);
+            mOffsets.push_back(Vector3(spacing*column, 0.0f, spacing*row));
+        }
+
+        mSurfaces.resize(count);
+        std::size_t first = 0;
+        for (std::size_t i = 0; i < count; i++){
+            Solver const& solver = mInstances[i];
+            std::size_t vertices = solver.particles().size();
+            mSurfaces[i].build(solver.triangles(), vertices);
+            mFirstVertex.push_back(first);
+            for (unsigned int v : solver.triangles()){
+                mTriangles.push_back((unsigned int)(first + v));
+            }
+            first += vertices;
+        }
+        mFirstVertex.push_back(first);
+        return true;
+    }
+
+    bool ClothBatch::reset(std::string& error)
+    {
+        //scenes are applied in parallel too; loading checkpoints or meshes
+        //for hundreds of instances is not free. The error strings live in
+        //the batch so that resetting an unchanged batch does not allocate.
+        mPool->parallelForDynamic(mInstances.size(),
+            [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; i++){
+                mErrors[i].clear();
+                applyScene(mScene, mInstances[i], mErrors[i]);
+            }
+        });
+
+        for (auto const& e : mErrors){
+            if (!e.empty())
+            {
+                error = e;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ClothBatch::step(float dt)
+    {
+        mPool->parallelForDynamic(mInstances.size(),
+            [this, dt](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; i++){
+                mInstances[i].step(dt);
+            }
+        });
+    }
+
+    StepStats ClothBatch::lastStepStats() const
+    {
+        StepStats total = {0, 0, 0.0f, 0.0f, 0};
+        double squares = 0.0;
+        for (auto const& solver : mInstances){
+            StepStats const& s = solver.lastStepStats();
+            total.substeps = std::max(total.substeps, s.substeps);
+            total.iterations += s.iterations;
+            total.maxError = std::max(total.maxError, s.maxError);
+            squares += (double)s.rmsError*s.rmsError;
+            total.sleepingTiles += s.sleepingTiles;
+        }
+        if (!mInstances.empty())
+        {
+            total.rmsError = (float)std::sqrt(squares / mInstances.size());
+        }
+        return total;
+    }
+
+    std::size_t ClothBatch::size() const
+    {
+        return mInstances.size();
+    }
+
+    int ClothBatch::threadCount() const
+    {
+        return (int)mPool->size();
+    }
+
+    Solver& ClothBatch::instance(std::size_t i)
+    {
+        return mInstances[i];
+    }
+
+    Solver const& ClothBatch::instance(std::size_t i) const
+    {
+        return mInstances[i];
+    }
+
+    Vector3 const& ClothBatch::offset(std::size_t i) const
+    {
+        return mOffsets[i];
+    }
+
+    std::size_t ClothBatch::vertexCount() const
+    {
+        return mFirstVertex.empty() ? 0 : mFirstVertex.back();
+    }
+
+    std::vector<unsigned int> const& ClothBatch::triangles() const
+    {
+        return mTriangles;
+    }
+
+    void ClothBatch::write(float alpha, float* positions, float* normals)
+    {
+        mPool->parallelForDynamic(mInstances.size(),
+            [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; i++){
+                std::size_t first = mFirstVertex[i];
+                std::size_t count = mFirstVertex[i + 1] - first;
+                float* p = positions + 3*first;
+                mSurfaces[i].write(mInstances[i].particles(), alpha, p,
+                    normals + 3*first, nullptr);
+
+                Vector3 const& offset = mOffsets[i];
+                for (std::size_t v = 0; v < count; v++){
+                    p[3*v] += offset.x;
+                    p[3*v+1] += offset.y;
+                    p[3*v+2] += offset.z;
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,181 @@
+#include "ClothCrowd.hpp"
+#include "Paths.hpp"
+#include "LayoutLocations.glsl"
+
+#include <atlas/utils/GUI.hpp>
+
+#include <chrono>
+#include <cstdio>
+
+namespace pbd
+{
+    ClothCrowd::ClothCrowd(Scene const& scene) :
+        mSurfaceIndexBuffer(GL_ELEMENT_ARRAY_BUFFER)
+    {
+        namespace gl = atlas::gl;
+
+        std::string error;
+        if (!mBatch.setUp(scene, error))
+        {
+            //an empty batch draws nothing
+            std::fprintf(stderr, "%s\n", error.c_str());
+        }
+        createSurface();
+
+        std::vector<gl::ShaderUnit> shaders
+        {
+            {std::string(ShaderDirectory) + "ClothSurface.vs.glsl", GL_VERTEX_SHADER},
+            {std::string(ShaderDirectory) + "ClothShaded.fs.glsl", GL_FRAGMENT_SHADER}
+        };
+
+        mShaders.emplace_back(shaders);
+        auto& shader = mShaders.back();
+        shader.setShaderIncludeDir(ShaderDirectory);
+        shader.compileShaders();
+        shader.linkShaders();
+
+        mModelUniform = shader.getUniformVariable("model");
+        mProjectionUniform = shader.getUniformVariable("projection");
+        mViewUniform = shader.getUniformVariable("view");
+        mColourUniform = shader.getUniformVariable("materialColour");
+
+        shader.disableShaders();
+        mModel = atlas::math::Matrix4(1.0f);
+    }
+
+    ClothCrowd::~ClothCrowd()
+    {
+        glDeleteVertexArrays(kSurfaceRing, mSurfaceVaos);
+        glDeleteBuffers(kSurfaceRing, mSurfaceBuffers);
+    }
+
+    void ClothCrowd::createSurface()
+    {
+        namespace gl = atlas::gl;
+
+        std::size_t count = mBatch.vertexCount();
+        auto const& triangles = mBatch.triangles();
+        mSurfaceIndexCount = static_cast<GLsizei>(triangles.size());
+
+        mSurfaceIndexBuffer.bindBuffer();
+        mSurfaceIndexBuffer.bufferData(gl::size<GLuint>(triangles.size()),
+            triangles.data(), GL_STATIC_DRAW);
+        mSurfaceIndexBuffer.unBindBuffer();
+
+        glDeleteVertexArrays(kSurfaceRing, mSurfaceVaos);
+        glDeleteBuffers(kSurfaceRing, mSurfaceBuffers);
+        glGenBuffers(kSurfaceRing, mSurfaceBuffers);
+        glGenVertexArrays(kSurfaceRing, mSurfaceVaos);
+        for (int k = 0; k < kSurfaceRing; k++){
+            glBindVertexArray(mSurfaceVaos[k]);
+            glBindBuffer(GL_ARRAY_BUFFER, mSurfaceBuffers[k]);
+            glBufferData(GL_ARRAY_BUFFER, gl::size<float>(6*count), nullptr,
+                GL_STREAM_DRAW);
+            glVertexAttribPointer(VERTICES_LAYOUT_LOCATION, 3, GL_FLOAT,
+                GL_FALSE, gl::stride<float>(3), gl::bufferOffset<float>(0));
+            glVertexAttribPointer(NORMALS_LAYOUT_LOCATION, 3, GL_FLOAT,
+                GL_FALSE, gl::stride<float>(3), gl::bufferOffset<float>(3*count));
+            glEnableVertexAttribArray(VERTICES_LAYOUT_LOCATION);
+            glEnableVertexAttribArray(NORMALS_LAYOUT_LOCATION);
+            mSurfaceIndexBuffer.bindBuffer();
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mSurfaceIndexBuffer.unBindBuffer();
+    }
+
+    ClothBatch const& ClothCrowd::batch() const
+    {
+        return mBatch;
+    }
+
+    void ClothCrowd::updateGeometry(atlas::core::Time<> const& t)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        ScopedTimer timer(mProfiler, "step");
+        auto before = Clock::now();
+        mBatch.step(t.deltaTime);
+        std::chrono::duration<double, std::milli> elapsed = Clock::now() - before;
+        mStepMs = elapsed.count();
+    }
+
+    void ClothCrowd::setInterpolation(float alpha)
+    {
+        mAlpha = alpha;
+    }
+
+    void ClothCrowd::setProfiler(Profiler* profiler)
+    {
+        mProfiler = profiler;
+    }
+
+    void ClothCrowd::renderGeometry(atlas::math::Matrix4 const& projection,
+        atlas::math::Matrix4 const& view)
+    {
+        namespace math = atlas::math;
+
+        auto& shader = mShaders[0];
+        shader.hotReloadShaders();
+        if (!shader.shaderProgramValid() || mBatch.size() == 0)
+        {
+            return;
+        }
+
+        //every instance writes its own slice of the mapped buffer, spread
+        //over the batch's threads
+        {
+            ScopedTimer timer(mProfiler, "upload");
+            std::size_t count = mBatch.vertexCount();
+            mSurfaceSlot = (mSurfaceSlot + 1) % kSurfaceRing;
+            glBindBuffer(GL_ARRAY_BUFFER, mSurfaceBuffers[mSurfaceSlot]);
+            void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                atlas::gl::size<float>(6*count),
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (!mapped)
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                return;
+            }
+            float* positions = static_cast<float*>(mapped);
+            mBatch.write(mAlpha, positions, positions + 3*count);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        ScopedTimer timer(mProfiler, "draw");
+        shader.enableShaders();
+        glUniformMatrix4fv(mModelUniform, 1, GL_FALSE, &mModel[0][0]);
+        glUniformMatrix4fv(mProjectionUniform, 1, GL_FALSE, &projection[0][0]);
+        glUniformMatrix4fv(mViewUniform, 1, GL_FALSE, &view[0][0]);
+        const math::Vector cloth{ 0.8f, 0.3f, 0.25f };
+        glUniform3fv(mColourUniform, 1, &cloth[0]);
+
+        glBindVertexArray(mSurfaceVaos[mSurfaceSlot]);
+        glDrawElements(GL_TRIANGLES, mSurfaceIndexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        shader.disableShaders();
+    }
+
+    void ClothCrowd::drawGui()
+    {
+        ImGui::SetNextWindowSize(ImVec2(300, 100), ImGuiSetCond_FirstUseEver);
+        ImGui::Begin("Crowd");
+        ImGui::Text("%d instances, %d particles", (int)mBatch.size(),
+            (int)mBatch.vertexCount());
+        ImGui::Text("%d threads, last step %.3f ms", mBatch.threadCount(),
+            mStepMs);
+        ImGui::End();
+    }
+
+    void ClothCrowd::resetGeometry()
+    {
+        std::string error;
+        if (!mBatch.reset(error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+        }
+    }
+}
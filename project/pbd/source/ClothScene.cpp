@@ -3,16 +3,32 @@
 #include <atlas/utils/GUI.hpp>
 #include <atlas/gl/GL.hpp>
 
+#include <cfloat>
+#include <cstdio>
+
 namespace pbd
 {
-    ClothScene::ClothScene() :
+    ClothScene::ClothScene(Scene const& scene) :
         mPlay(false),
-        mAnimCounter(60.0f),
-        mCloth(),
+        mScene(scene),
+        mClock(scene.stepSize, 4),
+        mCloth(scene),
         mSphere("sun.jpg")
     {
-        mCloth.setPosition({-5.0f, 0.0f, 0.0f});
-        mSphere.setPosition({-5.0f, 0.0f, 0.0f});
+        mCloth.setProfiler(&mProfiler);
+        if (mScene.instances > 1)
+        {
+            mCrowd.reset(new ClothCrowd(mScene));
+            mCrowd->setProfiler(&mProfiler);
+        }
+
+        //the first sphere collider is the one drawn
+        if (!mScene.spheres.empty())
+        {
+            Vector3 const& center = mScene.spheres[0].center;
+            mSphere.setPosition({center.x, center.y, center.z});
+            mSphere.setRadius(mScene.spheres[0].radius);
+        }
     }
 
     void ClothScene::updateScene(double time)
@@ -20,9 +36,27 @@ namespace pbd
         using atlas::core::Time;
 
         ModellingScene::updateScene(time);
-        if (mPlay && mAnimCounter.isFPS(mTime))
+        if (mPlay && mCrowd)
+        {
+            Time<> step;
+            step.deltaTime = mClock.stepSize();
+            int steps = mClock.advance(mTime.deltaTime);
+            for (int i = 0; i < steps; ++i)
+            {
+                mCrowd->updateGeometry(step);
+            }
+            mCrowd->setInterpolation(mClock.alpha());
+        }
+        else if (!mCrowd)
         {
+            //the cloth steps at a fixed rate on its own thread; cached
+            //frames replace the solver entirely, so it waits meanwhile
+            mCloth.setPlaying(mPlay && !mCloth.playingBack());
             mCloth.updateGeometry(mTime);
+            if (mPlay && mCloth.playingBack())
+            {
+                mCloth.seek(mCloth.playbackTime() + (float)mTime.deltaTime);
+            }
         }
     }
 
@@ -41,8 +75,29 @@ namespace pbd
         mView = mCamera.getCameraMatrix();
 
         mGrid.renderGeometry(mProjection, mView);
-        mCloth.renderGeometry(mProjection, mView);
-        mSphere.renderGeometry(mProjection, mView);
+        if (mCrowd)
+        {
+            //one draw for every cloth, but a sphere per instance
+            mCrowd->renderGeometry(mProjection, mView);
+            if (!mScene.spheres.empty())
+            {
+                Vector3 const& center = mScene.spheres[0].center;
+                for (std::size_t i = 0; i < mCrowd->batch().size(); ++i)
+                {
+                    Vector3 p = center + mCrowd->batch().offset(i);
+                    mSphere.setPosition({p.x, p.y, p.z});
+                    mSphere.renderGeometry(mProjection, mView);
+                }
+            }
+        }
+        else
+        {
+            mCloth.renderGeometry(mProjection, mView);
+            if (!mScene.spheres.empty())
+            {
+                mSphere.renderGeometry(mProjection, mView);
+            }
+        }
 
         // Global HUD
         ImGui::SetNextWindowSize(ImVec2(350, 140), ImGuiSetCond_FirstUseEver);
@@ -69,10 +124,16 @@ namespace pbd
 
         if (ImGui::Button("Reset"))
         {
-            mCloth.setPosition({0.0f, 0.0f, 0.0f});
-            mCloth.resetGeometry();
-            mSphere.setPosition({0.0f, 0.0f, 0.0f});
+            if (mCrowd)
+            {
+                mCrowd->resetGeometry();
+            }
+            else
+            {
+                mCloth.resetGeometry();
+            }
             mPlay = false;
+            mClock.reset();
             mTime.currentTime = 0.0f;
             mTime.totalTime = 0.0f;
         }
@@ -81,6 +142,35 @@ namespace pbd
             1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
         ImGui::End();
 
+        if (mCrowd)
+        {
+            mCrowd->drawGui();
+        }
+        else
+        {
+            mCloth.drawGui();
+        }
+
+        //time spent in each phase per frame; draw is the CPU side only
+        mPhases.update(mProfiler);
+        ImGui::SetNextWindowSize(ImVec2(400, 500), ImGuiSetCond_FirstUseEver);
+        ImGui::Begin("Profiler");
+        for (std::size_t i = 0; i < mPhases.phaseCount(); ++i)
+        {
+            char overlay[32];
+            std::snprintf(overlay, sizeof(overlay), "avg %.3f ms",
+                mPhases.average(i));
+            ImGui::PlotHistogram(mPhases.name(i), mPhases.samples(i),
+                (int)mPhases.frames(), (int)mPhases.offset(), overlay, 0.0f,
+                FLT_MAX, ImVec2(0, 40));
+        }
+        if (ImGui::Button("Save Chrome trace"))
+        {
+            mProfiler.writeChromeTrace(mScene.trace.empty() ?
+                "pbd_trace.json" : mScene.trace.c_str());
+        }
+        ImGui::End();
+
         ImGui::Render();
     }
 }
@@ -0,0 +1,438 @@
+#include "Collider.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace pbd
+{
+    namespace
+    {
+        //particles are tested against meshes in groups this size: the BVH
+        //is traversed once for the bounds of the group and every particle
+        //in it is tested against the resulting candidates
+        const std::size_t kMeshBatch = 4;
+
+        void pushOutOfSphere(ParticleSet& p, std::size_t i,
+            Vector3 const& center, float radius)
+        {
+            float dx = p.mPredX[i] - center.x;
+            float dy = p.mPredY[i] - center.y;
+            float dz = p.mPredZ[i] - center.z;
+            float distSq = dx*dx + dy*dy + dz*dz;
+            if (distSq < radius*radius && distSq > 0.0f)
+            {
+                float dist = std::sqrt(distSq);
+                float push = (radius - dist)/dist;
+                p.mPredX[i] += dx*push;
+                p.mPredY[i] += dy*push;
+                p.mPredZ[i] += dz*push;
+            }
+        }
+    }
+
+    MeshCollider::MeshCollider(std::vector<Vector3> vertices,
+        std::vector<unsigned int> indices, float thickness) :
+        mVertices(std::move(vertices)),
+        mIndices(std::move(indices)),
+        mThickness(thickness)
+    {
+        mBvh.build(mVertices, mIndices);
+
+        mTriangleBounds.resize(mIndices.size()/3);
+        for (std::size_t t = 0; t < mTriangleBounds.size(); ++t){
+            Vector3 const& a = mVertices[mIndices[3*t]];
+            Vector3 const& b = mVertices[mIndices[3*t + 1]];
+            Vector3 const& c = mVertices[mIndices[3*t + 2]];
+            mTriangleBounds[t].min = Vector3(std::min(a.x, std::min(b.x, c.x)),
+                std::min(a.y, std::min(b.y, c.y)), std::min(a.z, std::min(b.z, c.z)));
+            mTriangleBounds[t].max = Vector3(std::max(a.x, std::max(b.x, c.x)),
+                std::max(a.y, std::max(b.y, c.y)), std::max(a.z, std::max(b.z, c.z)));
+        }
+    }
+
+    Aabb const& MeshCollider::triangleBounds(int t) const
+    {
+        return mTriangleBounds[t];
+    }
+
+    float MeshCollider::intersect(int t, Vector3 const& from,
+        Vector3 const& to) const
+    {
+        //Moller-Trumbore
+        Vector3 const& a = mVertices[mIndices[3*t]];
+        Vector3 const& b = mVertices[mIndices[3*t + 1]];
+        Vector3 const& c = mVertices[mIndices[3*t + 2]];
+
+        Vector3 dir = to - from;
+        Vector3 e1 = b - a;
+        Vector3 e2 = c - a;
+        Vector3 h = cross(dir, e2);
+        float det = dot(e1, h);
+        if (std::fabs(det) < 1e-12f)
+        {
+            return -1.0f;
+        }
+
+        float invDet = 1.0f/det;
+        Vector3 s = from - a;
+        float u = dot(s, h)*invDet;
+        if (u < 0.0f || u > 1.0f)
+        {
+            return -1.0f;
+        }
+
+        Vector3 q = cross(s, e1);
+        float v = dot(dir, q)*invDet;
+        if (v < 0.0f || u + v > 1.0f)
+        {
+            return -1.0f;
+        }
+
+        float hit = dot(e2, q)*invDet;
+        return (hit >= 0.0f && hit <= 1.0f) ? hit : -1.0f;
+    }
+
+    Bvh const& MeshCollider::bvh() const
+    {
+        return mBvh;
+    }
+
+    float MeshCollider::thickness() const
+    {
+        return mThickness;
+    }
+
+    std::vector<Vector3> const& MeshCollider::vertices() const
+    {
+        return mVertices;
+    }
+
+    std::vector<unsigned int> const& MeshCollider::indices() const
+    {
+        return mIndices;
+    }
+
+    Vector3 MeshCollider::faceNormal(int t) const
+    {
+        Vector3 const& a = mVertices[mIndices[3*t]];
+        Vector3 const& b = mVertices[mIndices[3*t + 1]];
+        Vector3 const& c = mVertices[mIndices[3*t + 2]];
+        Vector3 n = cross(b - a, c - a);
+        float len = mag(n);
+        return (len > 0.0f) ? n/len : Vector3(0.0f, 1.0f, 0.0f);
+    }
+
+    Vector3 MeshCollider::closestPoint(int t, Vector3 const& p) const
+    {
+        //Ericson, Real-Time Collision Detection 5.1.5
+        Vector3 const& a = mVertices[mIndices[3*t]];
+        Vector3 const& b = mVertices[mIndices[3*t + 1]];
+        Vector3 const& c = mVertices[mIndices[3*t + 2]];
+
+        Vector3 ab = b - a;
+        Vector3 ac = c - a;
+        Vector3 ap = p - a;
+        float d1 = dot(ab, ap);
+        float d2 = dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+        {
+            return a;
+        }
+
+        Vector3 bp = p - b;
+        float d3 = dot(ab, bp);
+        float d4 = dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+        {
+            return b;
+        }
+
+        float vc = d1*d4 - d3*d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        {
+            return a + ab*(d1/(d1 - d3));
+        }
+
+        Vector3 cp = p - c;
+        float d5 = dot(ab, cp);
+        float d6 = dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+        {
+            return c;
+        }
+
+        float vb = d5*d2 - d1*d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        {
+            return a + ac*(d2/(d2 - d6));
+        }
+
+        float va = d3*d6 - d5*d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        {
+            return b + (c - b)*((d4 - d3)/((d4 - d3) + (d5 - d6)));
+        }
+
+        float denom = 1.0f/(va + vb + vc);
+        return a + ab*(vb*denom) + ac*(vc*denom);
+    }
+
+    void ColliderSet::clear()
+    {
+        mSpheres.clear();
+        mCapsules.clear();
+        mBoxes.clear();
+        mPlanes.clear();
+        mMeshes.clear();
+    }
+
+    std::size_t ColliderSet::addSphere(SphereCollider const& sphere)
+    {
+        mSpheres.push_back(sphere);
+        return mSpheres.size() - 1;
+    }
+
+    std::size_t ColliderSet::addCapsule(CapsuleCollider const& capsule)
+    {
+        mCapsules.push_back(capsule);
+        return mCapsules.size() - 1;
+    }
+
+    std::size_t ColliderSet::addBox(BoxCollider const& box)
+    {
+        mBoxes.push_back(box);
+        return mBoxes.size() - 1;
+    }
+
+    std::size_t ColliderSet::addPlane(PlaneCollider const& plane)
+    {
+        mPlanes.push_back(plane);
+        return mPlanes.size() - 1;
+    }
+
+    std::size_t ColliderSet::addMesh(MeshCollider mesh)
+    {
+        mMeshes.push_back(std::move(mesh));
+        return mMeshes.size() - 1;
+    }
+
+    std::vector<SphereCollider>& ColliderSet::spheres()
+    {
+        return mSpheres;
+    }
+
+    std::vector<CapsuleCollider>& ColliderSet::capsules()
+    {
+        return mCapsules;
+    }
+
+    std::vector<BoxCollider>& ColliderSet::boxes()
+    {
+        return mBoxes;
+    }
+
+    std::vector<PlaneCollider>& ColliderSet::planes()
+    {
+        return mPlanes;
+    }
+
+    std::vector<SphereCollider> const& ColliderSet::spheres() const
+    {
+        return mSpheres;
+    }
+
+    std::vector<CapsuleCollider> const& ColliderSet::capsules() const
+    {
+        return mCapsules;
+    }
+
+    std::vector<BoxCollider> const& ColliderSet::boxes() const
+    {
+        return mBoxes;
+    }
+
+    std::vector<PlaneCollider> const& ColliderSet::planes() const
+    {
+        return mPlanes;
+    }
+
+    std::vector<MeshCollider> const& ColliderSet::meshes() const
+    {
+        return mMeshes;
+    }
+
+    void ColliderSet::collide(ParticleSet& p, std::size_t begin,
+        std::size_t end, IntArray& candidates) const
+    {
+        //shape by shape, so each inner loop is a straight pass over the
+        //particle arrays
+        float* px = p.mPredX.data();
+        float* py = p.mPredY.data();
+        float* pz = p.mPredZ.data();
+
+        for (auto const& sphere : mSpheres){
+            for (std::size_t i = begin; i < end; ++i){
+                pushOutOfSphere(p, i, sphere.center, sphere.radius);
+            }
+        }
+
+        for (auto const& capsule : mCapsules){
+            Vector3 ab = capsule.b - capsule.a;
+            float len = dot(ab, ab);
+            for (std::size_t i = begin; i < end; ++i){
+                float s = (len > 0.0f) ? dot(p.prediction(i) - capsule.a, ab)/len : 0.0f;
+                s = std::min(1.0f, std::max(0.0f, s));
+                pushOutOfSphere(p, i, capsule.a + ab*s, capsule.radius);
+            }
+        }
+
+        for (auto const& box : mBoxes){
+            float half[3] = {box.halfExtents.x, box.halfExtents.y,
+                box.halfExtents.z};
+            for (std::size_t i = begin; i < end; ++i){
+                Vector3 d = p.prediction(i) - box.center;
+                float local[3] = {dot(d, box.axes[0]), dot(d, box.axes[1]),
+                    dot(d, box.axes[2])};
+
+                //inside when within the extents on every axis; leave through
+                //the face that is closest
+                int axis = -1;
+                float depth = FLT_MAX;
+                for (int a = 0; a < 3; ++a){
+                    float pen = half[a] - std::fabs(local[a]);
+                    if (pen <= 0.0f){
+                        axis = -1;
+                        break;
+                    }
+                    if (pen < depth){
+                        depth = pen;
+                        axis = a;
+                    }
+                }
+
+                if (axis >= 0){
+                    float sign = (local[axis] < 0.0f) ? -1.0f : 1.0f;
+                    Vector3 push = box.axes[axis]*(sign*depth);
+                    p.mPredX[i] += push.x;
+                    p.mPredY[i] += push.y;
+                    p.mPredZ[i] += push.z;
+                }
+            }
+        }
+
+        for (auto const& plane : mPlanes){
+            Vector3 n = plane.normal;
+            float offset = plane.offset;
+            for (std::size_t i = begin; i < end; ++i){
+                float dist = n.x*px[i] + n.y*py[i] + n.z*pz[i] - offset;
+                dist = (dist < 0.0f) ? dist : 0.0f;
+                px[i] -= n.x*dist;
+                py[i] -= n.y*dist;
+                pz[i] -= n.z*dist;
+            }
+        }
+
+        for (auto const& mesh : mMeshes){
+            for (std::size_t first = begin; first < end; first += kMeshBatch){
+                std::size_t last = std::min(end, first + kMeshBatch);
+                collideMesh(mesh, p, first, last, candidates);
+            }
+        }
+    }
+
+    void ColliderSet::collideMesh(MeshCollider const& mesh, ParticleSet& p,
+        std::size_t begin, std::size_t end, IntArray& candidates) const
+    {
+        float thickness = mesh.thickness();
+        Vector3 margin(thickness, thickness, thickness);
+
+        //bounds of the whole batch over the step, from the positions at the
+        //start of the step to the current predictions
+        Aabb box{Vector3(FLT_MAX, FLT_MAX, FLT_MAX),
+            Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX)};
+        for (std::size_t i = begin; i < end; ++i){
+            box.min = Vector3(
+                std::min(box.min.x, std::min(p.mPosX[i], p.mPredX[i])),
+                std::min(box.min.y, std::min(p.mPosY[i], p.mPredY[i])),
+                std::min(box.min.z, std::min(p.mPosZ[i], p.mPredZ[i])));
+            box.max = Vector3(
+                std::max(box.max.x, std::max(p.mPosX[i], p.mPredX[i])),
+                std::max(box.max.y, std::max(p.mPosY[i], p.mPredY[i])),
+                std::max(box.max.z, std::max(p.mPosZ[i], p.mPredZ[i])));
+        }
+        box.min -= margin;
+        box.max += margin;
+
+        candidates.clear();
+        mesh.bvh().query(box, candidates);
+        if (candidates.empty())
+        {
+            return;
+        }
+
+        for (std::size_t i = begin; i < end; ++i){
+            Vector3 start = p.position(i);
+            Vector3 x = p.prediction(i);
+            Aabb path{Vector3(std::min(start.x, x.x), std::min(start.y, x.y),
+                std::min(start.z, x.z)) - margin,
+                Vector3(std::max(start.x, x.x), std::max(start.y, x.y),
+                std::max(start.z, x.z)) + margin};
+
+            //earliest crossing of the surface over the step, and otherwise
+            //the closest triangle within the thickness
+            float firstHit = 2.0f;
+            int hitTriangle = -1;
+            float bestSq = thickness*thickness;
+            int closest = -1;
+            Vector3 closestPoint;
+            for (int t : candidates){
+                Aabb const& tb = mesh.triangleBounds(t);
+                if (tb.min.x > path.max.x || tb.max.x < path.min.x ||
+                    tb.min.y > path.max.y || tb.max.y < path.min.y ||
+                    tb.min.z > path.max.z || tb.max.z < path.min.z)
+                {
+                    continue;
+                }
+
+                float hit = mesh.intersect(t, start, x);
+                if (hit >= 0.0f && hit < firstHit){
+                    firstHit = hit;
+                    hitTriangle = t;
+                }
+
+                Vector3 q = mesh.closestPoint(t, x);
+                Vector3 d = x - q;
+                float distSq = dot(d, d);
+                if (distSq < bestSq){
+                    bestSq = distSq;
+                    closest = t;
+                    closestPoint = q;
+                }
+            }
+
+            Vector3 target;
+            if (hitTriangle >= 0){
+                //crossed during the step: back to the side it came from
+                Vector3 n = mesh.faceNormal(hitTriangle);
+                Vector3 hitPoint = start + (x - start)*firstHit;
+                float side = (dot(start - hitPoint, n) >= 0.0f) ? 1.0f : -1.0f;
+                target = hitPoint + n*(side*thickness);
+            }else if (closest >= 0){
+                Vector3 n = mesh.faceNormal(closest);
+                float side = (dot(start - closestPoint, n) >= 0.0f) ? 1.0f : -1.0f;
+                Vector3 d = x - closestPoint;
+                float dist = std::sqrt(bestSq);
+                Vector3 dir = (dist > 1e-6f && dot(d, n)*side > 0.0f) ?
+                    d/dist : n*side;
+                target = closestPoint + dir*thickness;
+            }else{
+                continue;
+            }
+
+            p.mPredX[i] = target.x;
+            p.mPredY[i] = target.y;
+            p.mPredZ[i] = target.z;
+        }
+    }
+}
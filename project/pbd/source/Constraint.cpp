@@ -0,0 +1,332 @@
+#include "Constraint.hpp"
+#include "Vector3.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace pbd
+{
+    namespace
+    {
+        int constraintParticles(DistanceConstraint const& c, int* out)
+        {
+            out[0] = c.i;
+            out[1] = c.j;
+            return 2;
+        }
+
+        int constraintParticles(BendingConstraint const& c, int* out)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                out[k] = c.p[k];
+            }
+            return 4;
+        }
+
+        template <typename Constraint>
+        std::vector<ConstraintBatch> colour(std::vector<Constraint>& constraints,
+            std::size_t particleCount, ConstraintType type, std::size_t offset)
+        {
+            const int maxColours = 64;
+            const int serial = maxColours;
+
+            //bit c of usedColours[p] is set when particle p already has a
+            //constraint of colour c
+            std::vector<std::uint64_t> usedColours(particleCount, 0);
+            std::vector<int> colours(constraints.size());
+            std::vector<std::size_t> counts(maxColours + 1, 0);
+
+            int particles[4];
+            for (std::size_t k = 0; k < constraints.size(); ++k)
+            {
+                int n = constraintParticles(constraints[k], particles);
+                std::uint64_t used = 0;
+                for (int m = 0; m < n; ++m)
+                {
+                    used |= usedColours[particles[m]];
+                }
+
+                int colour = serial;
+                for (int bit = 0; bit < maxColours; ++bit)
+                {
+                    if (!(used & (std::uint64_t(1) << bit)))
+                    {
+                        colour = bit;
+                        break;
+                    }
+                }
+
+                if (colour != serial)
+                {
+                    for (int m = 0; m < n; ++m)
+                    {
+                        usedColours[particles[m]] |= std::uint64_t(1) << colour;
+                    }
+                }
+                colours[k] = colour;
+                counts[colour]++;
+            }
+
+            //counting sort by colour, stable so that the order inside a batch
+            //follows the order constraints were built in
+            std::vector<std::size_t> offsets(maxColours + 2, 0);
+            for (int colour = 0; colour <= maxColours; ++colour)
+            {
+                offsets[colour + 1] = offsets[colour] + counts[colour];
+            }
+
+            std::vector<Constraint> sorted(constraints.size());
+            std::vector<std::size_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (std::size_t k = 0; k < constraints.size(); ++k)
+            {
+                sorted[cursor[colours[k]]++] = constraints[k];
+            }
+            constraints.swap(sorted);
+
+            std::vector<ConstraintBatch> batches;
+            for (int colour = 0; colour <= maxColours; ++colour)
+            {
+                if (counts[colour] > 0)
+                {
+                    batches.push_back({offset + offsets[colour],
+                        offset + offsets[colour + 1], colour != serial, type,
+                        PinPattern::None});
+                }
+            }
+            return batches;
+        }
+
+        PinPattern normalisePins(DistanceConstraint& c, float const* invMass)
+        {
+            bool pinnedI = invMass[c.i] == 0.0f;
+            bool pinnedJ = invMass[c.j] == 0.0f;
+            if (pinnedJ && !pinnedI)
+            {
+                std::swap(c.i, c.j);
+            }
+            return (pinnedI && pinnedJ) ? PinPattern::All :
+                (pinnedI || pinnedJ) ? PinPattern::Partial : PinPattern::None;
+        }
+
+        PinPattern normalisePins(BendingConstraint const& c, float const* invMass)
+        {
+            int pinned = 0;
+            for (int k = 0; k < 4; ++k)
+            {
+                pinned += (invMass[c.p[k]] == 0.0f) ? 1 : 0;
+            }
+            return (pinned == 4) ? PinPattern::All :
+                (pinned > 0) ? PinPattern::Partial : PinPattern::None;
+        }
+
+        template <typename Constraint>
+        std::vector<ConstraintBatch> split(std::vector<Constraint>& constraints,
+            std::vector<ConstraintBatch> const& batches, float const* invMass)
+        {
+            const int patterns = 3;
+            std::vector<Constraint> buckets[patterns];
+            std::vector<ConstraintBatch> result;
+            for (auto const& batch : batches)
+            {
+                for (std::size_t k = batch.begin; k < batch.end; ++k)
+                {
+                    Constraint c = constraints[k];
+                    int pattern = (int)normalisePins(c, invMass);
+                    buckets[pattern].push_back(c);
+                }
+
+                //the sub-batches partition the batch's range, so each is
+                //still a set of independent constraints
+                std::size_t cursor = batch.begin;
+                for (int pattern = 0; pattern < patterns; ++pattern)
+                {
+                    if (buckets[pattern].empty())
+                    {
+                        continue;
+                    }
+                    std::size_t begin = cursor;
+                    for (auto const& c : buckets[pattern])
+                    {
+                        constraints[cursor++] = c;
+                    }
+                    result.push_back({begin, cursor, batch.parallel, batch.type,
+                        (PinPattern)pattern});
+                    buckets[pattern].clear();
+                }
+            }
+            return result;
+        }
+
+        float cotangent(Vector3 const& a, Vector3 const& b)
+        {
+            float s = mag(cross(a, b));
+            return (s > 0.0f) ? dot(a, b)/s : 0.0f;
+        }
+    }
+
+    const char* constraintTypeName(ConstraintType type)
+    {
+        switch (type)
+        {
+        case ConstraintType::Structural:
+            return "structural";
+        case ConstraintType::Shear:
+            return "shear";
+        case ConstraintType::Bending:
+            return "bending";
+        }
+        return "unknown";
+    }
+
+    BendingConstraint makeBendingConstraint(int a, int b, int c, int d,
+        float const* x, float const* y, float const* z)
+    {
+        BendingConstraint bend;
+        bend.p[0] = a;
+        bend.p[1] = b;
+        bend.p[2] = c;
+        bend.p[3] = d;
+
+        Vector3 x0(x[a], y[a], z[a]);
+        Vector3 x1(x[b], y[b], z[b]);
+        Vector3 x2(x[c], y[c], z[c]);
+        Vector3 x3(x[d], y[d], z[d]);
+
+        Vector3 e0 = x1 - x0;
+        Vector3 e1 = x2 - x0;
+        Vector3 e2 = x3 - x0;
+        Vector3 e3 = x2 - x1;
+        Vector3 e4 = x3 - x1;
+
+        float c01 = cotangent(e0, e1);
+        float c02 = cotangent(e0, e2);
+        float c03 = cotangent(-e0, e3);
+        float c04 = cotangent(-e0, e4);
+
+        float area = 0.5f*(mag(cross(e0, e3)) + mag(cross(e0, e4)));
+        float scale = (area > 0.0f) ? 3.0f/(2.0f*area) : 0.0f;
+        float k[4] = {c03 + c04, c01 + c02, -c01 - c03, -c02 - c04};
+
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                bend.q[i][j] = scale*k[i]*k[j];
+            }
+        }
+
+        //energy of the rest shape, zero when it is flat. The rows of q sum
+        //to zero, so it is measured from x0 to keep it exact far from the
+        //origin.
+        Vector3 xs[4] = {Vector3(0.0f, 0.0f, 0.0f), e0, x2 - x0, x3 - x0};
+        float energy = 0.0f;
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                energy += bend.q[i][j]*dot(xs[i], xs[j]);
+            }
+        }
+        bend.rest = 0.5f*energy;
+        return bend;
+    }
+
+    ConstraintList buildEdgeConstraints(std::vector<unsigned int> const& triangles,
+        float const* x, float const* y, float const* z)
+    {
+        std::vector<std::pair<unsigned int, unsigned int>> edges;
+        edges.reserve(triangles.size());
+        for (std::size_t t = 0; t + 2 < triangles.size(); t += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                unsigned int a = triangles[t + k];
+                unsigned int b = triangles[t + (k + 1) % 3];
+                edges.push_back({std::min(a, b), std::max(a, b)});
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        ConstraintList constraints;
+        constraints.reserve(edges.size());
+        for (auto const& e : edges)
+        {
+            Vector3 d(x[e.second] - x[e.first], y[e.second] - y[e.first],
+                z[e.second] - z[e.first]);
+            constraints.push_back({(int)e.first, (int)e.second, mag(d), 1.0f});
+        }
+        return constraints;
+    }
+
+    BendingList buildBendingConstraints(std::vector<unsigned int> const& triangles,
+        float const* x, float const* y, float const* z)
+    {
+        //every triangle edge keyed by its sorted end points; after sorting,
+        //an edge shared by two triangles shows up as two equal neighbours
+        struct Edge
+        {
+            unsigned int a;
+            unsigned int b;
+            unsigned int opposite;
+        };
+
+        std::vector<Edge> edges;
+        edges.reserve(triangles.size());
+        for (std::size_t t = 0; t + 2 < triangles.size(); t += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                unsigned int a = triangles[t + k];
+                unsigned int b = triangles[t + (k + 1) % 3];
+                unsigned int c = triangles[t + (k + 2) % 3];
+                edges.push_back({std::min(a, b), std::max(a, b), c});
+            }
+        }
+        std::sort(edges.begin(), edges.end(), [](Edge const& l, Edge const& r)
+        {
+            return (l.a != r.a) ? l.a < r.a : (l.b != r.b) ? l.b < r.b : l.opposite < r.opposite;
+        });
+
+        BendingList bendings;
+        for (std::size_t k = 0; k + 1 < edges.size(); ++k)
+        {
+            Edge const& e = edges[k];
+            Edge const& f = edges[k + 1];
+            if (e.a == f.a && e.b == f.b && e.opposite != f.opposite)
+            {
+                bendings.push_back(makeBendingConstraint(e.a, e.b, e.opposite,
+                    f.opposite, x, y, z));
+                ++k;
+            }
+        }
+        return bendings;
+    }
+
+    std::vector<ConstraintBatch> colourConstraints(ConstraintList& constraints,
+        std::size_t particleCount, ConstraintType type, std::size_t offset)
+    {
+        return colour(constraints, particleCount, type, offset);
+    }
+
+    std::vector<ConstraintBatch> colourConstraints(BendingList& constraints,
+        std::size_t particleCount, ConstraintType type, std::size_t offset)
+    {
+        return colour(constraints, particleCount, type, offset);
+    }
+
+    std::vector<ConstraintBatch> splitByPins(ConstraintList& constraints,
+        std::vector<ConstraintBatch> const& batches, float const* invMass)
+    {
+        return split(constraints, batches, invMass);
+    }
+
+    std::vector<ConstraintBatch> splitByPins(BendingList& constraints,
+        std::vector<ConstraintBatch> const& batches, float const* invMass)
+    {
+        return split(constraints, batches, invMass);
+    }
+}
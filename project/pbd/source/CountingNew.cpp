@@ -0,0 +1,50 @@
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+//operator new for the headless tools that feeds allocationCount(). The
+//array and nothrow forms of the standard library forward to these.
+namespace
+{
+    void* allocate(std::size_t size)
+    {
+        pbd::countAllocation();
+        void* p = std::malloc(size ? size : 1);
+        if (!p)
+        {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
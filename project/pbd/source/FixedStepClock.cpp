@@ -0,0 +1,47 @@
+#include "FixedStepClock.hpp"
+
+namespace pbd
+{
+    FixedStepClock::FixedStepClock(float stepSize, int maxSteps) :
+        mStepSize(stepSize),
+        mMaxSteps(maxSteps),
+        mAccumulator(0.0f)
+    {
+    }
+
+    int FixedStepClock::advance(float frameTime)
+    {
+        if (frameTime > 0.0f)
+        {
+            mAccumulator += frameTime;
+        }
+
+        int steps = 0;
+        while (mAccumulator >= mStepSize && steps < mMaxSteps)
+        {
+            mAccumulator -= mStepSize;
+            steps++;
+        }
+
+        if (mAccumulator >= mStepSize)
+        {
+            mAccumulator = 0.0f;
+        }
+        return steps;
+    }
+
+    void FixedStepClock::reset()
+    {
+        mAccumulator = 0.0f;
+    }
+
+    float FixedStepClock::stepSize() const
+    {
+        return mStepSize;
+    }
+
+    float FixedStepClock::alpha() const
+    {
+        return mAccumulator / mStepSize;
+    }
+}
@@ -0,0 +1,210 @@
+#include "JacobiKernels.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PBD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(PBD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PBD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define PBD_TARGET_AVX2
+#endif
+
+namespace pbd
+{
+    namespace
+    {
+        inline void distanceScalar(DistanceKernelArgs const& a, std::size_t k)
+        {
+            DistanceConstraint const& c = a.constraints[k];
+            float dx = a.predX[c.j] - a.predX[c.i];
+            float dy = a.predY[c.j] - a.predY[c.i];
+            float dz = a.predZ[c.j] - a.predZ[c.i];
+            float wSum = a.invMass[c.i] + a.invMass[c.j];
+            float distance = std::sqrt(dx*dx + dy*dy + dz*dz);
+
+            float s = 0.0f;
+            if (wSum > 0.0f && distance > 0.0f)
+            {
+                s = c.stiffness*(1.0f - c.restLength/distance)/wSum;
+            }
+            a.corrX[k] = s*dx;
+            a.corrY[k] = s*dy;
+            a.corrZ[k] = s*dz;
+        }
+
+#if defined(PBD_X86)
+        void distanceKernelSse2(DistanceKernelArgs const& a,
+            std::size_t begin, std::size_t end)
+        {
+            std::size_t k = begin;
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            for (; k + 4 <= end; k += 4)
+            {
+                DistanceConstraint const* c = a.constraints + k;
+
+                //SSE2 has no gather, the four particle pairs are loaded lane
+                //by lane and everything after that is vector math
+                __m128 dx = _mm_sub_ps(
+                    _mm_setr_ps(a.predX[c[0].j], a.predX[c[1].j], a.predX[c[2].j], a.predX[c[3].j]),
+                    _mm_setr_ps(a.predX[c[0].i], a.predX[c[1].i], a.predX[c[2].i], a.predX[c[3].i]));
+                __m128 dy = _mm_sub_ps(
+                    _mm_setr_ps(a.predY[c[0].j], a.predY[c[1].j], a.predY[c[2].j], a.predY[c[3].j]),
+                    _mm_setr_ps(a.predY[c[0].i], a.predY[c[1].i], a.predY[c[2].i], a.predY[c[3].i]));
+                __m128 dz = _mm_sub_ps(
+                    _mm_setr_ps(a.predZ[c[0].j], a.predZ[c[1].j], a.predZ[c[2].j], a.predZ[c[3].j]),
+                    _mm_setr_ps(a.predZ[c[0].i], a.predZ[c[1].i], a.predZ[c[2].i], a.predZ[c[3].i]));
+                __m128 wSum = _mm_add_ps(
+                    _mm_setr_ps(a.invMass[c[0].i], a.invMass[c[1].i], a.invMass[c[2].i], a.invMass[c[3].i]),
+                    _mm_setr_ps(a.invMass[c[0].j], a.invMass[c[1].j], a.invMass[c[2].j], a.invMass[c[3].j]));
+                __m128 rest = _mm_setr_ps(c[0].restLength, c[1].restLength,
+                    c[2].restLength, c[3].restLength);
+                __m128 stiffness = _mm_setr_ps(c[0].stiffness, c[1].stiffness,
+                    c[2].stiffness, c[3].stiffness);
+
+                __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                    _mm_add_ps(_mm_mul_ps(dy, dy), _mm_mul_ps(dz, dz))));
+                __m128 valid = _mm_and_ps(_mm_cmpgt_ps(wSum, zero),
+                    _mm_cmpgt_ps(distance, zero));
+                __m128 s = _mm_div_ps(
+                    _mm_mul_ps(stiffness, _mm_sub_ps(one, _mm_div_ps(rest, distance))),
+                    wSum);
+                s = _mm_and_ps(s, valid);
+
+                _mm_storeu_ps(a.corrX + k, _mm_mul_ps(s, dx));
+                _mm_storeu_ps(a.corrY + k, _mm_mul_ps(s, dy));
+                _mm_storeu_ps(a.corrZ + k, _mm_mul_ps(s, dz));
+            }
+
+            for (; k < end; ++k)
+            {
+                distanceScalar(a, k);
+            }
+        }
+
+        PBD_TARGET_AVX2
+        void distanceKernelAvx2(DistanceKernelArgs const& a,
+            std::size_t begin, std::size_t end)
+        {
+            static_assert(sizeof(DistanceConstraint) == 4*sizeof(int),
+                "the AVX2 kernel gathers constraint fields with a stride of 4");
+
+            std::size_t k = begin;
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const __m256i stride = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+            for (; k + 8 <= end; k += 8)
+            {
+                int const* base = reinterpret_cast<int const*>(a.constraints + k);
+                float const* baseF = reinterpret_cast<float const*>(base);
+
+                __m256i ci = _mm256_i32gather_epi32(base, stride, 4);
+                __m256i cj = _mm256_i32gather_epi32(base + 1, stride, 4);
+                __m256 rest = _mm256_i32gather_ps(baseF + 2, stride, 4);
+                __m256 stiffness = _mm256_i32gather_ps(baseF + 3, stride, 4);
+
+                __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(a.predX, cj, 4),
+                    _mm256_i32gather_ps(a.predX, ci, 4));
+                __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(a.predY, cj, 4),
+                    _mm256_i32gather_ps(a.predY, ci, 4));
+                __m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(a.predZ, cj, 4),
+                    _mm256_i32gather_ps(a.predZ, ci, 4));
+                __m256 wSum = _mm256_add_ps(_mm256_i32gather_ps(a.invMass, ci, 4),
+                    _mm256_i32gather_ps(a.invMass, cj, 4));
+
+                __m256 distance = _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx,
+                    _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz))));
+                __m256 valid = _mm256_and_ps(_mm256_cmp_ps(wSum, zero, _CMP_GT_OQ),
+                    _mm256_cmp_ps(distance, zero, _CMP_GT_OQ));
+                __m256 s = _mm256_div_ps(
+                    _mm256_mul_ps(stiffness, _mm256_sub_ps(one, _mm256_div_ps(rest, distance))),
+                    wSum);
+                s = _mm256_and_ps(s, valid);
+
+                _mm256_storeu_ps(a.corrX + k, _mm256_mul_ps(s, dx));
+                _mm256_storeu_ps(a.corrY + k, _mm256_mul_ps(s, dy));
+                _mm256_storeu_ps(a.corrZ + k, _mm256_mul_ps(s, dz));
+            }
+
+            for (; k < end; ++k)
+            {
+                distanceScalar(a, k);
+            }
+        }
+
+        bool cpuHasAvx2()
+        {
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+            {
+                return false;
+            }
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool fma = (info[2] & (1 << 12)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            if (!(osxsave && avx && fma))
+            {
+                return false;
+            }
+            //the OS must save the upper halves of the ymm registers
+            if ((_xgetbv(0) & 0x6) != 0x6)
+            {
+                return false;
+            }
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        }
+#endif
+    }
+
+    void distanceKernelScalar(DistanceKernelArgs const& args,
+        std::size_t begin, std::size_t end)
+    {
+        for (std::size_t k = begin; k < end; ++k)
+        {
+            distanceScalar(args, k);
+        }
+    }
+
+    DistanceKernel selectDistanceKernel()
+    {
+#if defined(PBD_X86)
+        if (cpuHasAvx2())
+        {
+            return distanceKernelAvx2;
+        }
+        return distanceKernelSse2;
+#else
+        return distanceKernelScalar;
+#endif
+    }
+
+    const char* distanceKernelName(DistanceKernel kernel)
+    {
+#if defined(PBD_X86)
+        if (kernel == distanceKernelAvx2)
+        {
+            return "avx2";
+        }
+        if (kernel == distanceKernelSse2)
+        {
+            return "sse2";
+        }
+#endif
+        return (kernel == distanceKernelScalar) ? "scalar" : "unknown";
+    }
+}
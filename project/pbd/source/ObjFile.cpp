@@ -0,0 +1,81 @@
+#include "ObjFile.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace pbd
+{
+    namespace
+    {
+        //vertex index of a face corner ("v", "v/vt", "v//vn" or
+        //"v/vt/vn"), 1-based or negative from the end; -1 when invalid
+        long cornerIndex(char const*& text, std::size_t vertexCount)
+        {
+            char* end;
+            long index = std::strtol(text, &end, 10);
+            if (end == text)
+            {
+                return -1;
+            }
+            text = end;
+            while (*text && *text != ' ' && *text != '\t' && *text != '\r' &&
+                *text != '\n'){
+                text++;
+            }
+
+            index = (index < 0) ? (long)vertexCount + index : index - 1;
+            return (index >= 0 && (std::size_t)index < vertexCount) ? index : -1;
+        }
+    }
+
+    bool loadObj(std::string const& path, std::vector<Vector3>& vertices,
+        std::vector<unsigned int>& indices)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "r");
+        if (!file)
+        {
+            return false;
+        }
+
+        vertices.clear();
+        indices.clear();
+        bool ok = true;
+        char line[4096];
+        std::vector<unsigned int> face;
+        while (ok && std::fgets(line, sizeof(line), file)){
+            if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+            {
+                Vector3 v;
+                ok = std::sscanf(line + 2, "%f %f %f", &v.x, &v.y, &v.z) == 3;
+                vertices.push_back(v);
+            }
+            else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t'))
+            {
+                face.clear();
+                char const* text = line + 2;
+                while (ok){
+                    while (*text == ' ' || *text == '\t'){
+                        text++;
+                    }
+                    if (*text == '\0' || *text == '\r' || *text == '\n')
+                    {
+                        break;
+                    }
+                    long index = cornerIndex(text, vertices.size());
+                    ok = index >= 0;
+                    face.push_back((unsigned int)index);
+                }
+                ok = ok && face.size() >= 3;
+                for (std::size_t k = 2; ok && k < face.size(); k++){
+                    indices.push_back(face[0]);
+                    indices.push_back(face[k - 1]);
+                    indices.push_back(face[k]);
+                }
+            }
+        }
+
+        std::fclose(file);
+        return ok && !indices.empty();
+    }
+}
@@ -0,0 +1,221 @@
+#include "ParticleOrder.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace pbd
+{
+    namespace
+    {
+        //spreads the low 10 bits of v out to every third bit
+        std::uint32_t spreadBits(std::uint32_t v)
+        {
+            v &= 0x3ff;
+            v = (v | (v << 16)) & 0x030000ff;
+            v = (v | (v << 8)) & 0x0300f00f;
+            v = (v | (v << 4)) & 0x030c30c3;
+            v = (v | (v << 2)) & 0x09249249;
+            return v;
+        }
+
+        //vertex adjacency of a triangle list in CSR form, without
+        //duplicates
+        void buildAdjacency(std::vector<unsigned int> const& triangles,
+            std::size_t count, std::vector<int>& offsets,
+            std::vector<int>& neighbours)
+        {
+            std::vector<std::pair<int, int>> edges;
+            edges.reserve(2*triangles.size());
+            for (std::size_t t = 0; t + 2 < triangles.size(); t += 3){
+                for (int k = 0; k < 3; k++){
+                    int a = (int)triangles[t + k];
+                    int b = (int)triangles[t + (k + 1) % 3];
+                    edges.push_back({a, b});
+                    edges.push_back({b, a});
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+            offsets.assign(count + 1, 0);
+            for (auto const& e : edges){
+                offsets[e.first + 1]++;
+            }
+            for (std::size_t i = 0; i < count; i++){
+                offsets[i + 1] += offsets[i];
+            }
+            neighbours.resize(edges.size());
+            for (std::size_t k = 0; k < edges.size(); k++){
+                neighbours[k] = edges[k].second;
+            }
+        }
+
+        //breadth first search from start, appending the vertices in the
+        //order they are reached to out. Returns the number of levels;
+        //lastLevel is where the deepest one begins in out.
+        int breadthFirst(int start, std::vector<int> const& offsets,
+            std::vector<int> const& neighbours, std::vector<int>& mark,
+            int stamp, std::vector<int>& out, std::size_t& lastLevel)
+        {
+            std::size_t levelBegin = out.size();
+            out.push_back(start);
+            mark[start] = stamp;
+            int levels = 1;
+            while (true){
+                std::size_t levelEnd = out.size();
+                for (std::size_t k = levelBegin; k < levelEnd; k++){
+                    int v = out[k];
+                    for (int n = offsets[v]; n < offsets[v + 1]; n++){
+                        int w = neighbours[n];
+                        if (mark[w] != stamp){
+                            mark[w] = stamp;
+                            out.push_back(w);
+                        }
+                    }
+                }
+                if (out.size() == levelEnd)
+                {
+                    lastLevel = levelBegin;
+                    return levels;
+                }
+                levelBegin = levelEnd;
+                levels++;
+            }
+        }
+    }
+
+    const char* particleOrderName(ParticleOrder order)
+    {
+        switch (order)
+        {
+        case ParticleOrder::Input:
+            return "input";
+        case ParticleOrder::Morton:
+            return "morton";
+        case ParticleOrder::Rcm:
+            return "rcm";
+        }
+        return "unknown";
+    }
+
+    std::vector<int> mortonOrder(float const* x, float const* y,
+        float const* z, std::size_t count)
+    {
+        std::vector<int> order(count);
+        if (count == 0)
+        {
+            return order;
+        }
+
+        float lo[3] = {x[0], y[0], z[0]};
+        float hi[3] = {x[0], y[0], z[0]};
+        for (std::size_t i = 1; i < count; i++){
+            float p[3] = {x[i], y[i], z[i]};
+            for (int a = 0; a < 3; a++){
+                lo[a] = std::min(lo[a], p[a]);
+                hi[a] = std::max(hi[a], p[a]);
+            }
+        }
+
+        float scale[3];
+        for (int a = 0; a < 3; a++){
+            scale[a] = (hi[a] > lo[a]) ? 1023.0f/(hi[a] - lo[a]) : 0.0f;
+        }
+
+        std::vector<std::pair<std::uint32_t, int>> keys(count);
+        for (std::size_t i = 0; i < count; i++){
+            std::uint32_t cx = (std::uint32_t)((x[i] - lo[0])*scale[0]);
+            std::uint32_t cy = (std::uint32_t)((y[i] - lo[1])*scale[1]);
+            std::uint32_t cz = (std::uint32_t)((z[i] - lo[2])*scale[2]);
+            keys[i] = {spreadBits(cx) | (spreadBits(cy) << 1) | (spreadBits(cz) << 2), (int)i};
+        }
+        std::sort(keys.begin(), keys.end());
+        for (std::size_t i = 0; i < count; i++){
+            order[i] = keys[i].second;
+        }
+        return order;
+    }
+
+    std::vector<int> rcmOrder(std::vector<unsigned int> const& triangles,
+        std::size_t count)
+    {
+        std::vector<int> offsets, neighbours;
+        buildAdjacency(triangles, count, offsets, neighbours);
+        auto degree = [&offsets](int v){ return offsets[v + 1] - offsets[v]; };
+
+        //mark[v] is the stamp of the last search that reached v; placed
+        //vertices get -1 so later searches skip them
+        std::vector<int> mark(count, 0);
+        std::vector<int> level;
+        std::vector<int> order;
+        order.reserve(count);
+        int stamp = 0;
+
+        //unconnected particles are left to the end
+        std::vector<int> starts;
+        for (std::size_t v = 0; v < count; v++){
+            if (degree((int)v) > 0){
+                starts.push_back((int)v);
+            }
+        }
+        std::stable_sort(starts.begin(), starts.end(), [&degree](int a, int b)
+        {
+            return degree(a) < degree(b);
+        });
+
+        for (int start : starts){
+            if (mark[start] < 0)
+            {
+                continue;
+            }
+
+            //pseudo-peripheral start (George and Liu): move to a minimum
+            //degree vertex of the last level while that makes the search
+            //deeper
+            int depth = 0;
+            for (int pass = 0; pass < 8; pass++){
+                level.clear();
+                std::size_t last;
+                int levels = breadthFirst(start, offsets, neighbours, mark,
+                    ++stamp, level, last);
+                if (levels <= depth)
+                {
+                    break;
+                }
+                depth = levels;
+                int candidate = level[last];
+                for (std::size_t k = last; k < level.size(); k++){
+                    candidate = (degree(level[k]) < degree(candidate)) ? level[k] : candidate;
+                }
+                start = candidate;
+            }
+
+            //Cuthill-McKee: breadth first, neighbours by increasing degree
+            std::size_t begin = order.size();
+            order.push_back(start);
+            mark[start] = -1;
+            for (std::size_t k = begin; k < order.size(); k++){
+                int v = order[k];
+                std::size_t added = order.size();
+                for (int n = offsets[v]; n < offsets[v + 1]; n++){
+                    int w = neighbours[n];
+                    if (mark[w] >= 0){
+                        mark[w] = -1;
+                        order.push_back(w);
+                    }
+                }
+                std::stable_sort(order.begin() + added, order.end(),
+                    [&degree](int a, int b){ return degree(a) < degree(b); });
+            }
+        }
+
+        std::reverse(order.begin(), order.end());
+        for (std::size_t v = 0; v < count; v++){
+            if (degree((int)v) == 0){
+                order.push_back((int)v);
+            }
+        }
+        return order;
+    }
+}
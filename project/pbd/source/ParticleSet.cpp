@@ -0,0 +1,116 @@
+#include "ParticleSet.hpp"
+
+#include <algorithm>
+
+namespace pbd
+{
+    void ParticleSet::clear()
+    {
+        mPosX.clear(); mPosY.clear(); mPosZ.clear();
+        mPredX.clear(); mPredY.clear(); mPredZ.clear();
+        mVelX.clear(); mVelY.clear(); mVelZ.clear();
+        mPrevX.clear(); mPrevY.clear(); mPrevZ.clear();
+        mInvMass.clear();
+        mMass.clear();
+    }
+
+    void ParticleSet::reserve(std::size_t n)
+    {
+        mPosX.reserve(n); mPosY.reserve(n); mPosZ.reserve(n);
+        mPredX.reserve(n); mPredY.reserve(n); mPredZ.reserve(n);
+        mVelX.reserve(n); mVelY.reserve(n); mVelZ.reserve(n);
+        mPrevX.reserve(n); mPrevY.reserve(n); mPrevZ.reserve(n);
+        mInvMass.reserve(n);
+        mMass.reserve(n);
+    }
+
+    std::size_t ParticleSet::add(float mass, Vector3 const& position)
+    {
+        mPosX.push_back(position.x);
+        mPosY.push_back(position.y);
+        mPosZ.push_back(position.z);
+        mPredX.push_back(0.0f);
+        mPredY.push_back(0.0f);
+        mPredZ.push_back(0.0f);
+        mVelX.push_back(0.0f);
+        mVelY.push_back(0.0f);
+        mVelZ.push_back(0.0f);
+        mPrevX.push_back(position.x);
+        mPrevY.push_back(position.y);
+        mPrevZ.push_back(position.z);
+        mInvMass.push_back(1.0f / mass);
+        mMass.push_back(mass);
+        return mPosX.size() - 1;
+    }
+
+    std::size_t ParticleSet::size() const
+    {
+        return mPosX.size();
+    }
+
+    void ParticleSet::setMovable(std::size_t i, bool b)
+    {
+        mInvMass[i] = b ? 1.0f / mMass[i] : 0.0f;
+        if (!b)
+        {
+            mVelX[i] = 0.0f;
+            mVelY[i] = 0.0f;
+            mVelZ[i] = 0.0f;
+        }
+    }
+
+    bool ParticleSet::movable(std::size_t i) const
+    {
+        return mInvMass[i] > 0.0f;
+    }
+
+    Vector3 ParticleSet::position(std::size_t i) const
+    {
+        return Vector3(mPosX[i], mPosY[i], mPosZ[i]);
+    }
+
+    Vector3 ParticleSet::prediction(std::size_t i) const
+    {
+        return Vector3(mPredX[i], mPredY[i], mPredZ[i]);
+    }
+
+    Vector3 ParticleSet::velocity(std::size_t i) const
+    {
+        return Vector3(mVelX[i], mVelY[i], mVelZ[i]);
+    }
+
+    void ParticleSet::setPosition(std::size_t i, Vector3 const& p)
+    {
+        mPosX[i] = p.x;
+        mPosY[i] = p.y;
+        mPosZ[i] = p.z;
+        mPrevX[i] = p.x;
+        mPrevY[i] = p.y;
+        mPrevZ[i] = p.z;
+    }
+
+    void ParticleSet::storePrevious()
+    {
+        std::copy(mPosX.begin(), mPosX.end(), mPrevX.begin());
+        std::copy(mPosY.begin(), mPosY.end(), mPrevY.begin());
+        std::copy(mPosZ.begin(), mPosZ.end(), mPrevZ.begin());
+    }
+
+    void ParticleSet::permute(std::vector<int> const& order)
+    {
+        FloatArray scratch(order.size());
+        forEachArray([&order, &scratch](FloatArray& values){
+            for (std::size_t k = 0; k < order.size(); k++){
+                scratch[k] = values[order[k]];
+            }
+            values.swap(scratch);
+        });
+    }
+
+    Vector3 ParticleSet::interpolated(std::size_t i, float alpha) const
+    {
+        return Vector3(mPrevX[i] + (mPosX[i] - mPrevX[i])*alpha,
+            mPrevY[i] + (mPosY[i] - mPrevY[i])*alpha,
+            mPrevZ[i] + (mPosZ[i] - mPrevZ[i])*alpha);
+    }
+}
@@ -0,0 +1,214 @@
+#include "Profiler.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace pbd
+{
+    namespace
+    {
+        //marks a slot that has never been written or is being written
+        const std::uint64_t kEmpty = ~std::uint64_t(0);
+
+        std::int64_t clockNanoseconds()
+        {
+            using namespace std::chrono;
+            return duration_cast<nanoseconds>(
+                steady_clock::now().time_since_epoch()).count();
+        }
+
+        //small stable id per thread for the trace viewer
+        std::uint32_t threadId()
+        {
+            static std::atomic<std::uint32_t> next(0);
+            thread_local std::uint32_t id = next.fetch_add(1);
+            return id;
+        }
+    }
+
+    Profiler::Profiler(std::size_t capacity) :
+        mHead(0),
+        mOrigin(clockNanoseconds())
+    {
+        std::size_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        mSlots.reset(new Slot[size]);
+        mMask = size - 1;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            mSlots[i].sequence.store(kEmpty, std::memory_order_relaxed);
+        }
+    }
+
+    std::uint64_t Profiler::now() const
+    {
+        return (std::uint64_t)(clockNanoseconds() - mOrigin);
+    }
+
+    void Profiler::record(const char* name, std::uint64_t start,
+        std::uint64_t end)
+    {
+        //the sequence is cleared while the event is written and set to
+        //the slot's index once it is complete
+        std::uint64_t index = mHead.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = mSlots[index & mMask];
+        slot.sequence.store(kEmpty, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.thread.store(threadId(), std::memory_order_relaxed);
+        slot.sequence.store(index, std::memory_order_release);
+    }
+
+    void Profiler::clear()
+    {
+        for (std::size_t i = 0; i <= mMask; ++i)
+        {
+            mSlots[i].sequence.store(kEmpty, std::memory_order_relaxed);
+        }
+    }
+
+    bool Profiler::read(std::uint64_t index, ProfileEvent& event) const
+    {
+        Slot const& slot = mSlots[index & mMask];
+        if (slot.sequence.load(std::memory_order_acquire) != index)
+        {
+            return false;
+        }
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.start = slot.start.load(std::memory_order_relaxed);
+        event.end = slot.end.load(std::memory_order_relaxed);
+        event.thread = slot.thread.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == index;
+    }
+
+    void Profiler::snapshot(std::vector<ProfileEvent>& events) const
+    {
+        events.clear();
+        std::uint64_t head = mHead.load(std::memory_order_acquire);
+        std::uint64_t size = mMask + 1;
+        std::uint64_t first = (head > size) ? head - size : 0;
+        ProfileEvent event;
+        for (std::uint64_t i = first; i < head; ++i)
+        {
+            if (read(i, event))
+            {
+                events.push_back(event);
+            }
+        }
+    }
+
+    void Profiler::collect(std::uint64_t& cursor,
+        std::vector<ProfileEvent>& events) const
+    {
+        std::uint64_t head = mHead.load(std::memory_order_acquire);
+        std::uint64_t size = mMask + 1;
+        std::uint64_t first = (head > size) ? head - size : 0;
+        ProfileEvent event;
+        for (std::uint64_t i = (cursor > first) ? cursor : first; i < head; ++i)
+        {
+            if (read(i, event))
+            {
+                events.push_back(event);
+            }
+        }
+        cursor = head;
+    }
+
+    bool Profiler::writeChromeTrace(const char* path) const
+    {
+        std::FILE* out = std::fopen(path, "w");
+        if (!out)
+        {
+            return false;
+        }
+
+        std::vector<ProfileEvent> events;
+        snapshot(events);
+        std::fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        for (std::size_t k = 0; k < events.size(); ++k)
+        {
+            ProfileEvent const& e = events[k];
+            std::fprintf(out, "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}%s\n",
+                e.name, e.thread, e.start*1e-3, (e.end - e.start)*1e-3,
+                (k + 1 < events.size()) ? "," : "");
+        }
+        std::fprintf(out, "]}\n");
+        return std::fclose(out) == 0;
+    }
+
+    PhaseHistory::PhaseHistory(std::size_t frames) :
+        mFrames((frames > 0) ? frames : 1)
+    {}
+
+    void PhaseHistory::update(Profiler const& profiler)
+    {
+        mEvents.clear();
+        profiler.collect(mCursor, mEvents);
+
+        mFrame = (mFrame + 1) % mFrames;
+        for (auto& samples : mSamples)
+        {
+            samples[mFrame] = 0.0f;
+        }
+
+        //names are compared by pointer first since they are usually the
+        //same literal
+        for (auto const& e : mEvents)
+        {
+            std::size_t phase = 0;
+            while (phase < mNames.size() && mNames[phase] != e.name &&
+                std::strcmp(mNames[phase], e.name))
+            {
+                ++phase;
+            }
+            if (phase == mNames.size())
+            {
+                mNames.push_back(e.name);
+                mSamples.emplace_back(mFrames, 0.0f);
+            }
+            mSamples[phase][mFrame] += (float)(e.end - e.start)*1e-6f;
+        }
+    }
+
+    std::size_t PhaseHistory::phaseCount() const
+    {
+        return mNames.size();
+    }
+
+    const char* PhaseHistory::name(std::size_t phase) const
+    {
+        return mNames[phase];
+    }
+
+    float const* PhaseHistory::samples(std::size_t phase) const
+    {
+        return mSamples[phase].data();
+    }
+
+    std::size_t PhaseHistory::frames() const
+    {
+        return mFrames;
+    }
+
+    std::size_t PhaseHistory::offset() const
+    {
+        return (mFrame + 1) % mFrames;
+    }
+
+    float PhaseHistory::average(std::size_t phase) const
+    {
+        float sum = 0.0f;
+        for (float v : mSamples[phase])
+        {
+            sum += v;
+        }
+        return sum / mFrames;
+    }
+}
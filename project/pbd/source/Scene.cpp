@@ -0,0 +1,745 @@
+#include "Scene.hpp"
+#include "ObjFile.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace pbd
+{
+    namespace
+    {
+        std::string trim(std::string const& text)
+        {
+            const char* space = " \t\r\n";
+            std::size_t begin = text.find_first_not_of(space);
+            if (begin == std::string::npos)
+            {
+                return std::string();
+            }
+            std::size_t end = text.find_last_not_of(space);
+            return text.substr(begin, end - begin + 1);
+        }
+
+        //exactly count whitespace separated numbers
+        bool parseFloats(std::string const& value, float* out, int count)
+        {
+            const char* text = value.c_str();
+            for (int k = 0; k < count; k++){
+                char* end;
+                out[k] = std::strtof(text, &end);
+                if (end == text)
+                {
+                    return false;
+                }
+                text = end;
+            }
+            return trim(text).empty();
+        }
+
+        bool parseFloat(std::string const& value, float& out)
+        {
+            return parseFloats(value, &out, 1);
+        }
+
+        bool parseVector(std::string const& value, Vector3& out)
+        {
+            float v[3];
+            if (!parseFloats(value, v, 3))
+            {
+                return false;
+            }
+            out = Vector3(v[0], v[1], v[2]);
+            return true;
+        }
+
+        bool parseInts(std::string const& value, std::vector<int>& out)
+        {
+            out.clear();
+            const char* text = value.c_str();
+            while (!trim(text).empty()){
+                char* end;
+                long v = std::strtol(text, &end, 10);
+                if (end == text)
+                {
+                    return false;
+                }
+                out.push_back((int)v);
+                text = end;
+            }
+            return true;
+        }
+
+        bool parseInt(std::string const& value, int& out)
+        {
+            std::vector<int> values;
+            if (!parseInts(value, values) || values.size() != 1)
+            {
+                return false;
+            }
+            out = values[0];
+            return true;
+        }
+
+        bool parseBool(std::string const& value, bool& out)
+        {
+            if (value == "on" || value == "true" || value == "1")
+            {
+                out = true;
+                return true;
+            }
+            if (value == "off" || value == "false" || value == "0")
+            {
+                out = false;
+                return true;
+            }
+            return false;
+        }
+
+        bool isAbsolute(std::string const& path)
+        {
+            return (!path.empty() && (path[0] == '/' || path[0] == '\\')) ||
+                (path.size() > 1 && path[1] == ':');
+        }
+
+        //directory part of path including the separator, empty for a bare
+        //file name
+        std::string directoryOf(std::string const& path)
+        {
+            std::size_t slash = path.find_last_of("/\\");
+            return (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+        }
+
+        class SceneParser
+        {
+        public:
+            SceneParser(Scene& scene, std::string const& path) :
+                mScene(scene),
+                mDirectory(directoryOf(path))
+            {}
+
+            //"" on success, otherwise what was wrong with the line
+            std::string section(std::string const& name)
+            {
+                bool collider = name == "sphere" || name == "capsule" ||
+                    name == "box" || name == "plane" || name == "mesh";
+                if (!collider && name != "cloth" && name != "solver" &&
+                    name != "batch" && name != "output")
+                {
+                    return "unknown section [" + name + "]";
+                }
+
+                if (collider && !mScene.customColliders)
+                {
+                    mScene.customColliders = true;
+                    mScene.spheres.clear();
+                    mScene.capsules.clear();
+                    mScene.boxes.clear();
+                    mScene.planes.clear();
+                    mScene.meshes.clear();
+                }
+
+                //each collider section adds one collider, its keys
+                //overwrite these defaults
+                if (name == "sphere")
+                {
+                    mScene.spheres.push_back({Vector3(), 1.0f});
+                }
+                else if (name == "capsule")
+                {
+                    mScene.capsules.push_back({Vector3(), Vector3(0.0f, 1.0f, 0.0f), 0.5f});
+                }
+                else if (name == "box")
+                {
+                    mScene.boxes.push_back({Vector3(), {Vector3(1.0f, 0.0f, 0.0f),
+                        Vector3(0.0f, 1.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f)},
+                        Vector3(1.0f, 1.0f, 1.0f)});
+                }
+                else if (name == "plane")
+                {
+                    mScene.planes.push_back({Vector3(0.0f, 1.0f, 0.0f), 0.0f});
+                }
+                else if (name == "mesh")
+                {
+                    mScene.meshes.push_back({std::string(), 0.05f});
+                }
+                mSection = name;
+                return std::string();
+            }
+
+            std::string value(std::string const& key, std::string const& value)
+            {
+                bool ok = false;
+                if (mSection == "cloth")
+                {
+                    ok = cloth(key, value);
+                }
+                else if (mSection == "solver")
+                {
+                    ok = solver(key, value);
+                }
+                else if (mSection == "batch")
+                {
+                    ok = batch(key, value);
+                }
+                else if (mSection == "output")
+                {
+                    ok = output(key, value);
+                }
+                else if (!mSection.empty())
+                {
+                    ok = collider(key, value);
+                }
+                return ok ? std::string() :
+                    "bad value or unknown key '" + key + "'" +
+                    (mSection.empty() ? " outside any section" : " in [" + mSection + "]");
+            }
+
+            //meshes need a file, and planes and boxes a usable orientation
+            std::string finish()
+            {
+                for (auto const& mesh : mScene.meshes){
+                    if (mesh.path.empty())
+                    {
+                        return "[mesh] without a file";
+                    }
+                }
+                for (auto& plane : mScene.planes){
+                    if (mag(plane.normal) <= 0.0f)
+                    {
+                        return "[plane] with a zero normal";
+                    }
+                    plane.normal = normalize(plane.normal);
+                }
+                for (auto& box : mScene.boxes){
+                    for (auto& axis : box.axes){
+                        if (mag(axis) <= 0.0f)
+                        {
+                            return "[box] with a zero axis";
+                        }
+                        axis = normalize(axis);
+                    }
+                }
+                return std::string();
+            }
+
+        private:
+            std::string file(std::string const& value) const
+            {
+                return isAbsolute(value) ? value : mDirectory + value;
+            }
+
+            bool cloth(std::string const& key, std::string const& value)
+            {
+                std::vector<int> ints;
+                float f;
+                if (key == "grid")
+                {
+                    if (!parseInts(value, ints) || ints.size() != 2 ||
+                        ints[0] < 2 || ints[1] < 2)
+                    {
+                        return false;
+                    }
+                    mScene.width = ints[0];
+                    mScene.length = ints[1];
+                    return true;
+                }
+                if (key == "pins")
+                {
+                    if (!parseInts(value, ints))
+                    {
+                        return false;
+                    }
+                    mScene.pins = ints;
+                    return true;
+                }
+                if (key == "state")
+                {
+                    mScene.state = file(value);
+                    return true;
+                }
+                if (key == "mesh")
+                {
+                    mScene.mesh = file(value);
+                    return true;
+                }
+                if (key == "order")
+                {
+                    for (int o = 0; o <= (int)ParticleOrder::Rcm; o++){
+                        if (value == particleOrderName((ParticleOrder)o))
+                        {
+                            mScene.order = (ParticleOrder)o;
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+                if (!parseFloat(value, f))
+                {
+                    return false;
+                }
+                if (key == "spacing" && f > 0.0f)
+                {
+                    mScene.spacing = f;
+                }
+                else if (key == "height")
+                {
+                    mScene.height = f;
+                }
+                else if (key == "mass" && f > 0.0f)
+                {
+                    mScene.mass = f;
+                }
+                else
+                {
+                    return false;
+                }
+                return true;
+            }
+
+            bool solver(std::string const& key, std::string const& value)
+            {
+                for (int t = 0; t < kConstraintTypeCount; t++){
+                    if (key != constraintTypeName((ConstraintType)t))
+                    {
+                        continue;
+                    }
+                    float c;
+                    if (value == "off")
+                    {
+                        mScene.enabled[t] = false;
+                        return true;
+                    }
+                    if (!parseFloat(value, c) || c < 0.0f)
+                    {
+                        return false;
+                    }
+                    mScene.enabled[t] = true;
+                    mScene.compliance[t] = c;
+                    return true;
+                }
+
+                int i;
+                float f;
+                bool b;
+                if (key == "mode" && (value == "gs" || value == "jacobi"))
+                {
+                    mScene.mode = (value == "gs") ? SolverMode::GaussSeidel : SolverMode::Jacobi;
+                }
+                else if (key == "norm" && (value == "max" || value == "rms"))
+                {
+                    mScene.norm = (value == "max") ? ErrorNorm::Max : ErrorNorm::Rms;
+                }
+                else if (key == "self_collision" && parseBool(value, b))
+                {
+                    mScene.selfCollision = b;
+                }
+                else if (key == "sleep" && parseBool(value, b))
+                {
+                    mScene.sleep = b;
+                }
+                else if (key == "sleep_speed" && parseFloat(value, f) && f >= 0.0f)
+                {
+                    mScene.sleepSpeed = f;
+                }
+                else if (key == "sleep_error" && parseFloat(value, f) && f >= 0.0f)
+                {
+                    mScene.sleepError = f;
+                }
+                else if (key == "sleep_steps" && parseInt(value, i) && i > 0)
+                {
+                    mScene.sleepSteps = i;
+                }
+                else if (key == "threads" && parseInt(value, i) && i >= 0)
+                {
+                    mScene.threads = i;
+                }
+                else if (key == "substeps" && parseInt(value, i) && i > 0)
+                {
+                    mScene.substeps = i;
+                }
+                else if (key == "iterations" && parseInt(value, i) && i > 0)
+                {
+                    mScene.iterations = i;
+                }
+                else if (key == "relaxation" && parseFloat(value, f))
+                {
+                    mScene.relaxation = f;
+                }
+                else if (key == "tolerance" && parseFloat(value, f) && f >= 0.0f)
+                {
+                    mScene.tolerance = f;
+                }
+                else if (key == "levels" && parseInt(value, i) && i > 0)
+                {
+                    mScene.levels = i;
+                }
+                else if (key == "level_iterations" && parseInt(value, i) && i > 0)
+                {
+                    mScene.levelIterations = i;
+                }
+                else if (key == "acceleration" && value == "none")
+                {
+                    mScene.acceleration = Acceleration::None;
+                }
+                else if (key == "acceleration" && value == "chebyshev")
+                {
+                    mScene.acceleration = Acceleration::Chebyshev;
+                }
+                else if (key == "acceleration" && value == "momentum")
+                {
+                    mScene.acceleration = Acceleration::Momentum;
+                }
+                else if (key == "spectral_radius" && parseFloat(value, f) && f >= 0.0f && f < 1.0f)
+                {
+                    mScene.spectralRadius = f;
+                }
+                else if (key == "gravity" && parseFloat(value, f))
+                {
+                    mScene.gravity = f;
+                }
+                else if (key == "damping" && parseFloat(value, f) && f >= 0.0f)
+                {
+                    mScene.damping = f;
+                }
+                else if (key == "thickness" && parseFloat(value, f) && f >= 0.0f)
+                {
+                    mScene.thickness = f;
+                }
+                else
+                {
+                    return false;
+                }
+                return true;
+            }
+
+            bool batch(std::string const& key, std::string const& value)
+            {
+                int i;
+                float f;
+                if (key == "instances" && parseInt(value, i) && i > 0)
+                {
+                    mScene.instances = i;
+                }
+                else if (key == "spacing" && parseFloat(value, f))
+                {
+                    mScene.instanceSpacing = f;
+                }
+                else
+                {
+                    return false;
+                }
+                return true;
+            }
+
+            bool output(std::string const& key, std::string const& value)
+            {
+                int i;
+                float f;
+                if (key == "steps" && parseInt(value, i) && i > 0)
+                {
+                    mScene.steps = i;
+                }
+                else if (key == "step_size" && parseFloat(value, f) && f > 0.0f)
+                {
+                    mScene.stepSize = f;
+                }
+                else if (key == "quantize")
+                {
+                    return parseBool(value, mScene.quantize);
+                }
+                else if (key == "timings")
+                {
+                    mScene.timings = file(value);
+                }
+                else if (key == "trace")
+                {
+                    mScene.trace = file(value);
+                }
+                else if (key == "record")
+                {
+                    mScene.record = file(value);
+                }
+                else if (key == "checkpoint")
+                {
+                    mScene.checkpoint = file(value);
+                }
+                else
+                {
+                    return false;
+                }
+                return true;
+            }
+
+            bool collider(std::string const& key, std::string const& value)
+            {
+                if (mSection == "sphere")
+                {
+                    SphereCollider& s = mScene.spheres.back();
+                    return (key == "center" && parseVector(value, s.center)) ||
+                        (key == "radius" && parseFloat(value, s.radius));
+                }
+                if (mSection == "capsule")
+                {
+                    CapsuleCollider& c = mScene.capsules.back();
+                    return (key == "a" && parseVector(value, c.a)) ||
+                        (key == "b" && parseVector(value, c.b)) ||
+                        (key == "radius" && parseFloat(value, c.radius));
+                }
+                if (mSection == "box")
+                {
+                    BoxCollider& b = mScene.boxes.back();
+                    return (key == "center" && parseVector(value, b.center)) ||
+                        (key == "half_extents" && parseVector(value, b.halfExtents)) ||
+                        (key == "x_axis" && parseVector(value, b.axes[0])) ||
+                        (key == "y_axis" && parseVector(value, b.axes[1])) ||
+                        (key == "z_axis" && parseVector(value, b.axes[2]));
+                }
+                if (mSection == "plane")
+                {
+                    PlaneCollider& p = mScene.planes.back();
+                    return (key == "normal" && parseVector(value, p.normal)) ||
+                        (key == "offset" && parseFloat(value, p.offset));
+                }
+                SceneMesh& m = mScene.meshes.back();
+                if (key == "file")
+                {
+                    m.path = file(value);
+                    return true;
+                }
+                return key == "thickness" && parseFloat(value, m.thickness);
+            }
+
+            Scene& mScene;
+            std::string mDirectory;
+            std::string mSection;
+        };
+    }
+
+    Scene::Scene()
+    {
+        spheres.push_back({Vector3(-5.0f, 0.0f, 0.0f), 2.0f});
+        planes.push_back({Vector3(0.0f, 1.0f, 0.0f), 0.0f});
+    }
+
+    bool loadScene(std::string const& path, Scene& scene, std::string& error)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "r");
+        if (!file)
+        {
+            error = "could not open " + path;
+            return false;
+        }
+
+        SceneParser parser(scene, path);
+        char buffer[1024];
+        int lineNumber = 0;
+        std::string problem;
+        while (problem.empty() && std::fgets(buffer, sizeof(buffer), file)){
+            lineNumber++;
+            std::string line = buffer;
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty())
+            {
+                continue;
+            }
+
+            std::size_t equals = line.find('=');
+            if (line.front() == '[' && line.back() == ']')
+            {
+                problem = parser.section(trim(line.substr(1, line.size() - 2)));
+            }
+            else if (equals != std::string::npos)
+            {
+                problem = parser.value(trim(line.substr(0, equals)),
+                    trim(line.substr(equals + 1)));
+            }
+            else
+            {
+                problem = "expected [section] or key = value";
+            }
+        }
+        std::fclose(file);
+
+        if (problem.empty())
+        {
+            problem = parser.finish();
+            lineNumber = 0;
+        }
+        if (!problem.empty())
+        {
+            error = path + ":" + (lineNumber > 0 ? std::to_string(lineNumber) + ": " : " ") + problem;
+            return false;
+        }
+        return true;
+    }
+
+    bool applyScene(Scene const& scene, Solver& solver, std::string& error)
+    {
+        //meshes are loaded first so a missing file leaves the solver alone
+        std::vector<MeshCollider> meshes;
+        bool replaceColliders = scene.state.empty() || scene.customColliders;
+        for (auto const& mesh : scene.meshes){
+            std::vector<Vector3> vertices;
+            std::vector<unsigned int> indices;
+            if (replaceColliders && !loadObj(mesh.path, vertices, indices))
+            {
+                error = "could not load mesh " + mesh.path;
+                return false;
+            }
+            if (replaceColliders)
+            {
+                meshes.emplace_back(std::move(vertices), std::move(indices),
+                    mesh.thickness);
+            }
+        }
+
+        std::vector<Vector3> clothVertices;
+        std::vector<unsigned int> clothTriangles;
+        if (scene.state.empty() && !scene.mesh.empty() &&
+            !loadObj(scene.mesh, clothVertices, clothTriangles))
+        {
+            error = "could not load mesh " + scene.mesh;
+            return false;
+        }
+
+        if (!scene.state.empty())
+        {
+            if (!solver.loadCheckpoint(scene.state))
+            {
+                error = "could not restore " + scene.state;
+                return false;
+            }
+        }
+        else
+        {
+            if (scene.mass.set)
+            {
+                solver.setClothMass(scene.mass.value);
+            }
+            if (scene.spacing.set)
+            {
+                solver.setSpacing(scene.spacing.value);
+            }
+            if (scene.height.set)
+            {
+                solver.setClothHeight(scene.height.value);
+            }
+            if (scene.pins.set)
+            {
+                solver.setPins(scene.pins.value);
+            }
+            if (scene.order.set)
+            {
+                solver.setParticleOrder(scene.order.value);
+            }
+            //both rebuild the cloth
+            if (!clothVertices.empty())
+            {
+                solver.setClothMesh(std::move(clothVertices), std::move(clothTriangles));
+            }
+            else
+            {
+                solver.setGridSize(scene.width.set ? scene.width.value : solver.width(),
+                    scene.length.set ? scene.length.value : solver.length());
+            }
+        }
+
+        if (replaceColliders)
+        {
+            ColliderSet& colliders = solver.colliders();
+            colliders.clear();
+            for (auto const& s : scene.spheres){
+                colliders.addSphere(s);
+            }
+            for (auto const& c : scene.capsules){
+                colliders.addCapsule(c);
+            }
+            for (auto const& b : scene.boxes){
+                colliders.addBox(b);
+            }
+            for (auto const& p : scene.planes){
+                colliders.addPlane(p);
+            }
+            for (auto& m : meshes){
+                colliders.addMesh(std::move(m));
+            }
+        }
+
+        if (scene.threads.set)
+        {
+            //0 is every core
+            int threads = scene.threads.value;
+            threads = (threads > 0) ? threads : (int)std::thread::hardware_concurrency();
+            solver.setThreadCount(threads);
+        }
+        if (scene.mode.set)
+        {
+            solver.setSolverMode(scene.mode.value);
+        }
+        if (scene.relaxation.set)
+        {
+            solver.setRelaxation(scene.relaxation.value);
+        }
+        if (scene.substeps.set)
+        {
+            solver.setSubsteps(scene.substeps.value);
+        }
+        if (scene.iterations.set)
+        {
+            solver.setMaxIterations(scene.iterations.value);
+        }
+        if (scene.tolerance.set || scene.norm.set)
+        {
+            solver.setTolerance(scene.tolerance.set ? scene.tolerance.value : solver.tolerance(),
+                scene.norm.set ? scene.norm.value : solver.errorNorm());
+        }
+        if (scene.levels.set || scene.levelIterations.set)
+        {
+            solver.setHierarchy(scene.levels.set ? scene.levels.value : solver.hierarchyLevels(),
+                scene.levelIterations.set ? scene.levelIterations.value : solver.coarseIterations());
+        }
+        if (scene.acceleration.set || scene.spectralRadius.set)
+        {
+            solver.setAcceleration(
+                scene.acceleration.set ? scene.acceleration.value : solver.acceleration(),
+                scene.spectralRadius.set ? scene.spectralRadius.value : solver.spectralRadius());
+        }
+        if (scene.gravity.set)
+        {
+            solver.setGravity(scene.gravity.value);
+        }
+        if (scene.damping.set)
+        {
+            solver.setDamping(scene.damping.value);
+        }
+        if (scene.selfCollision.set || scene.thickness.set)
+        {
+            solver.setSelfCollision(
+                scene.selfCollision.set ? scene.selfCollision.value : solver.selfCollision(),
+                scene.thickness.set ? scene.thickness.value : solver.selfCollisionThickness());
+        }
+        if (scene.sleep.set || scene.sleepSpeed.set || scene.sleepError.set ||
+            scene.sleepSteps.set)
+        {
+            solver.setSleeping(
+                scene.sleep.set ? scene.sleep.value : solver.sleepEnabled(),
+                scene.sleepSpeed.set ? scene.sleepSpeed.value : solver.sleepSpeed(),
+                scene.sleepError.set ? scene.sleepError.value : solver.sleepError(),
+                scene.sleepSteps.set ? scene.sleepSteps.value : solver.sleepSteps());
+        }
+        for (int t = 0; t < kConstraintTypeCount; t++){
+            if (scene.compliance[t].set)
+            {
+                solver.setCompliance((ConstraintType)t, scene.compliance[t].value);
+            }
+            if (scene.enabled[t].set)
+            {
+                solver.setConstraintEnabled((ConstraintType)t, scene.enabled[t].value);
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,378 @@
+#include "SimCache.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pbd
+{
+    namespace
+    {
+        const char kMagic[8] = {'P', 'B', 'D', 'C', 'A', 'C', 'H', 'E'};
+        const std::uint32_t kVersion = 1;
+        const std::uint32_t kQuantizedFlag = 1;
+
+        struct CacheHeader
+        {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t flags;
+            std::uint64_t particleCount;
+            std::uint64_t frameCount;
+            std::uint64_t frameBytes;
+            float frameTime;
+            unsigned char reserved[20];
+        };
+
+        static_assert(sizeof(CacheHeader) == 64, "cache header must be 64 bytes");
+
+        std::size_t frameBytes(std::size_t particleCount, bool quantized)
+        {
+            if (!quantized)
+            {
+                return 3*particleCount*sizeof(float);
+            }
+            //bounds, then the 16 bit arrays padded to keep frames 4 byte
+            //aligned
+            std::size_t bytes = 6*sizeof(float) + 3*particleCount*sizeof(std::uint16_t);
+            return (bytes + 3) & ~std::size_t(3);
+        }
+
+        bool writeHeader(std::FILE* file, std::size_t particleCount,
+            std::size_t frameCount, float frameTime, bool quantized)
+        {
+            CacheHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, kMagic, sizeof(kMagic));
+            header.version = kVersion;
+            header.flags = quantized ? kQuantizedFlag : 0;
+            header.particleCount = particleCount;
+            header.frameCount = frameCount;
+            header.frameBytes = frameBytes(particleCount, quantized);
+            header.frameTime = frameTime;
+            return std::fwrite(&header, sizeof(header), 1, file) == 1;
+        }
+    }
+
+    SimCacheWriter::~SimCacheWriter()
+    {
+        close();
+    }
+
+    bool SimCacheWriter::open(std::string const& path,
+        std::size_t particleCount, float frameTime, bool quantize)
+    {
+        close();
+        mFile = std::fopen(path.c_str(), "wb");
+        if (!mFile)
+        {
+            return false;
+        }
+
+        mParticleCount = particleCount;
+        mFrameCount = 0;
+        mFrameTime = frameTime;
+        mQuantize = quantize;
+        mQuantized.resize(quantize ? frameBytes(particleCount, true)/sizeof(std::uint16_t) : 0);
+        if (!writeHeader(mFile, particleCount, 0, frameTime, quantize))
+        {
+            std::fclose(mFile);
+            mFile = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    bool SimCacheWriter::append(ParticleSet const& particles)
+    {
+        if (!mFile || particles.size() != mParticleCount)
+        {
+            return false;
+        }
+
+        std::size_t n = mParticleCount;
+        float const* axes[3] = {particles.mPosX.data(), particles.mPosY.data(),
+            particles.mPosZ.data()};
+        bool ok = true;
+        if (!mQuantize)
+        {
+            //straight from the solver's arrays, no staging copy
+            for (int a = 0; a < 3; a++)
+            {
+                ok = ok && std::fwrite(axes[a], sizeof(float), n, mFile) == n;
+            }
+        }
+        else
+        {
+            float bounds[6];
+            std::uint16_t* out = mQuantized.data() + 6*sizeof(float)/sizeof(std::uint16_t);
+            for (int a = 0; a < 3; a++)
+            {
+                float lo = axes[a][0];
+                float hi = axes[a][0];
+                for (std::size_t i = 1; i < n; i++){
+                    lo = (axes[a][i] < lo) ? axes[a][i] : lo;
+                    hi = (axes[a][i] > hi) ? axes[a][i] : hi;
+                }
+                float step = (hi - lo)/65535.0f;
+                float scale = (step > 0.0f) ? 1.0f/step : 0.0f;
+                bounds[a] = lo;
+                bounds[3 + a] = step;
+                for (std::size_t i = 0; i < n; i++){
+                    float q = (axes[a][i] - lo)*scale + 0.5f;
+                    out[a*n + i] = (std::uint16_t)((q < 65535.0f) ? q : 65535.0f);
+                }
+            }
+            std::memcpy(mQuantized.data(), bounds, sizeof(bounds));
+            std::size_t bytes = frameBytes(n, true);
+            ok = std::fwrite(mQuantized.data(), 1, bytes, mFile) == bytes;
+        }
+
+        mFrameCount += ok ? 1 : 0;
+        return ok;
+    }
+
+    bool SimCacheWriter::close()
+    {
+        if (!mFile)
+        {
+            return true;
+        }
+
+        bool ok = std::fseek(mFile, 0, SEEK_SET) == 0 &&
+            writeHeader(mFile, mParticleCount, mFrameCount, mFrameTime, mQuantize);
+        ok = (std::fclose(mFile) == 0) && ok;
+        mFile = nullptr;
+        return ok;
+    }
+
+    bool SimCacheWriter::isOpen() const
+    {
+        return mFile != nullptr;
+    }
+
+    std::size_t SimCacheWriter::frameCount() const
+    {
+        return mFrameCount;
+    }
+
+    SimCacheReader::~SimCacheReader()
+    {
+        close();
+    }
+
+    bool SimCacheReader::open(std::string const& path)
+    {
+        close();
+
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        LARGE_INTEGER size;
+        HANDLE map = nullptr;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        {
+            map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        if (!map)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        mMapping = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+        mFileHandle = file;
+        mMapHandle = map;
+        mSize = (std::size_t)size.QuadPart;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* mapping = mmap(nullptr, (std::size_t)info.st_size, PROT_READ,
+            MAP_SHARED, fd, 0);
+        //the mapping keeps the file alive
+        ::close(fd);
+        mMapping = (mapping == MAP_FAILED) ? nullptr : mapping;
+        mSize = (std::size_t)info.st_size;
+#endif
+        if (!mMapping || mSize < sizeof(CacheHeader))
+        {
+            close();
+            return false;
+        }
+
+        CacheHeader header;
+        std::memcpy(&header, mMapping, sizeof(header));
+        bool quantized = (header.flags & kQuantizedFlag) != 0;
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) ||
+            header.version != kVersion || header.particleCount == 0 ||
+            header.frameBytes != frameBytes((std::size_t)header.particleCount, quantized))
+        {
+            close();
+            return false;
+        }
+
+        mParticleCount = (std::size_t)header.particleCount;
+        mFrameBytes = (std::size_t)header.frameBytes;
+        mFrameTime = header.frameTime;
+        mQuantized = quantized;
+
+        //a recording that was cut short has a zero count in the header;
+        //the file size says how many whole frames made it to disk
+        std::size_t available = (mSize - sizeof(CacheHeader))/mFrameBytes;
+        mFrameCount = (header.frameCount > 0 && header.frameCount <= available) ?
+            (std::size_t)header.frameCount : available;
+        if (mFrameCount == 0)
+        {
+            close();
+            return false;
+        }
+
+        for (int slot = 0; slot < 2; slot++)
+        {
+            mDecodedFrame[slot] = ~std::size_t(0);
+            for (int a = 0; a < 3; a++)
+            {
+                mDecoded[slot][a].resize(mQuantized ? mParticleCount : 0);
+            }
+        }
+        return true;
+    }
+
+    void SimCacheReader::close()
+    {
+#if defined(_WIN32)
+        if (mMapping)
+        {
+            UnmapViewOfFile(mMapping);
+        }
+        if (mMapHandle)
+        {
+            CloseHandle((HANDLE)mMapHandle);
+        }
+        if (mFileHandle)
+        {
+            CloseHandle((HANDLE)mFileHandle);
+        }
+        mMapHandle = nullptr;
+        mFileHandle = nullptr;
+#else
+        if (mMapping)
+        {
+            munmap(mMapping, mSize);
+        }
+#endif
+        mMapping = nullptr;
+        mSize = 0;
+        mParticleCount = 0;
+        mFrameCount = 0;
+    }
+
+    bool SimCacheReader::isOpen() const
+    {
+        return mMapping != nullptr;
+    }
+
+    std::size_t SimCacheReader::particleCount() const
+    {
+        return mParticleCount;
+    }
+
+    std::size_t SimCacheReader::frameCount() const
+    {
+        return mFrameCount;
+    }
+
+    float SimCacheReader::frameTime() const
+    {
+        return mFrameTime;
+    }
+
+    bool SimCacheReader::quantized() const
+    {
+        return mQuantized;
+    }
+
+    float SimCacheReader::duration() const
+    {
+        return (mFrameCount > 0) ? (mFrameCount - 1)*mFrameTime : 0.0f;
+    }
+
+    unsigned char const* SimCacheReader::frameData(std::size_t frame) const
+    {
+        return static_cast<unsigned char const*>(mMapping) +
+            sizeof(CacheHeader) + frame*mFrameBytes;
+    }
+
+    void SimCacheReader::positions(std::size_t frame, float const*& x,
+        float const*& y, float const*& z)
+    {
+        frame = (frame < mFrameCount) ? frame : mFrameCount - 1;
+        unsigned char const* data = frameData(frame);
+        std::size_t n = mParticleCount;
+        if (!mQuantized)
+        {
+            float const* axes = reinterpret_cast<float const*>(data);
+            x = axes;
+            y = axes + n;
+            z = axes + 2*n;
+            return;
+        }
+
+        std::size_t slot = frame & 1;
+        if (mDecodedFrame[slot] != frame)
+        {
+            float bounds[6];
+            std::memcpy(bounds, data, sizeof(bounds));
+            std::uint16_t const* in = reinterpret_cast<std::uint16_t const*>(
+                data + sizeof(bounds));
+            for (int a = 0; a < 3; a++)
+            {
+                float lo = bounds[a];
+                float step = bounds[3 + a];
+                float* out = mDecoded[slot][a].data();
+                for (std::size_t i = 0; i < n; i++){
+                    out[i] = lo + step*in[a*n + i];
+                }
+            }
+            mDecodedFrame[slot] = frame;
+        }
+        x = mDecoded[slot][0].data();
+        y = mDecoded[slot][1].data();
+        z = mDecoded[slot][2].data();
+    }
+
+    FramePair SimCacheReader::at(float time)
+    {
+        float position = (mFrameTime > 0.0f) ? time/mFrameTime : 0.0f;
+        float last = (float)(mFrameCount - 1);
+        position = (position < 0.0f) ? 0.0f : (position > last) ? last : position;
+
+        std::size_t frame = (std::size_t)position;
+        std::size_t next = (frame + 1 < mFrameCount) ? frame + 1 : frame;
+        FramePair pair;
+        positions(frame, pair.prevX, pair.prevY, pair.prevZ);
+        positions(next, pair.x, pair.y, pair.z);
+        pair.alpha = position - (float)frame;
+        return pair;
+    }
+}
@@ -0,0 +1,234 @@
+#include "SimulationThread.hpp"
+
+namespace pbd
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        //like FixedStepClock's step limit: a solver that falls further
+        //behind than this drops the time instead of trying to catch up
+        const int kMaxLagSteps = 4;
+    }
+
+    std::size_t SimFrame::size() const
+    {
+        return x.size();
+    }
+
+    FramePair SimFrame::interpolation(float alpha) const
+    {
+        return {prevX.data(), prevY.data(), prevZ.data(), x.data(), y.data(),
+            z.data(), alpha};
+    }
+
+    void SimFrame::reserve(std::size_t count)
+    {
+        if (arena && x.capacity() >= count)
+        {
+            return;
+        }
+
+        //the old arrays go back to the old arena before it is freed
+        std::unique_ptr<Arena> old = std::move(arena);
+        arena.reset(new Arena(6*arenaBytes(count*sizeof(float))));
+        for (FloatArray* values : {&prevX, &prevY, &prevZ, &x, &y, &z}){
+            FloatArray sized{AlignedAllocator<float>(arena.get())};
+            sized.reserve(count);
+            values->swap(sized);
+        }
+    }
+
+    SimulationThread::SimulationThread(Solver& solver, float stepSize) :
+        mSolver(solver),
+        mStepSize(stepSize),
+        mPlaying(false),
+        mStop(false)
+    {
+        checkShape();
+        publish();
+        mThread = std::thread(&SimulationThread::run, this);
+    }
+
+    SimulationThread::~SimulationThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWake.notify_all();
+        mThread.join();
+    }
+
+    void SimulationThread::play()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPlaying = true;
+        }
+        mWake.notify_all();
+    }
+
+    void SimulationThread::pause()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPlaying = false;
+        }
+        mWake.notify_all();
+    }
+
+    bool SimulationThread::playing() const
+    {
+        return mPlaying.load(std::memory_order_relaxed);
+    }
+
+    float SimulationThread::stepSize() const
+    {
+        return mStepSize;
+    }
+
+    void SimulationThread::post(Command command)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCommands.push_back(std::move(command));
+            mPosted++;
+        }
+        mWake.notify_all();
+    }
+
+    void SimulationThread::call(Command const& command)
+    {
+        //waits until the frame showing the command's effect is published
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCommands.push_back([&command](Solver& solver)
+        {
+            command(solver);
+        });
+        std::uint64_t ticket = ++mPosted;
+        mWake.notify_all();
+        mDone.wait(lock, [this, ticket]()
+        {
+            return mCompleted >= ticket;
+        });
+    }
+
+    void SimulationThread::setStepHook(StepHook hook)
+    {
+        call([this, &hook](Solver&)
+        {
+            mStepHook = std::move(hook);
+        });
+    }
+
+    bool SimulationThread::update()
+    {
+        return mFrames.update();
+    }
+
+    SimFrame const& SimulationThread::frame() const
+    {
+        return mFrames.front();
+    }
+
+    float SimulationThread::alpha() const
+    {
+        std::chrono::duration<float> since = Clock::now() - frame().time;
+        float alpha = since.count() / mStepSize;
+        return (alpha < 1.0f) ? alpha : 1.0f;
+    }
+
+    void SimulationThread::run()
+    {
+        auto step = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(mStepSize));
+        Clock::time_point next = Clock::now();
+        std::deque<Command> commands;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mStop){
+            //commands first, and their effect is published even while
+            //paused so a reset shows up straight away
+            if (!mCommands.empty()){
+                commands.swap(mCommands);
+                std::uint64_t posted = mPosted;
+                lock.unlock();
+                for (auto& command : commands){
+                    command(mSolver);
+                }
+                commands.clear();
+                checkShape();
+                publish();
+                lock.lock();
+                mCompleted = posted;
+                mDone.notify_all();
+                continue;
+            }
+
+            if (!mPlaying){
+                mWake.wait(lock);
+                next = Clock::now();
+                continue;
+            }
+
+            if (Clock::now() < next){
+                mWake.wait_until(lock, next);
+                continue;
+            }
+
+            lock.unlock();
+            auto before = Clock::now();
+            mSolver.step(mStepSize);
+            std::chrono::duration<double, std::milli> elapsed = Clock::now() - before;
+            mStepMs = elapsed.count();
+            mSteps++;
+            if (mStepHook){
+                mStepHook(mSolver);
+            }
+            publish();
+
+            next += step;
+            if (Clock::now() - next > kMaxLagSteps*step){
+                next = Clock::now();
+            }
+            lock.lock();
+        }
+    }
+
+    void SimulationThread::checkShape()
+    {
+        //a different particle count or triangle list is a new shape, which
+        //only commands can cause, so steps skip this
+        if (mSolver.particles().size() != mParticleCount ||
+            mSolver.triangles() != mTriangles)
+        {
+            mParticleCount = mSolver.particles().size();
+            mTriangles = mSolver.triangles();
+            mShape++;
+        }
+    }
+
+    void SimulationThread::publish()
+    {
+        ParticleSet const& p = mSolver.particles();
+        SimFrame& frame = mFrames.back();
+        frame.reserve(p.size());
+        frame.prevX.assign(p.mPrevX.begin(), p.mPrevX.end());
+        frame.prevY.assign(p.mPrevY.begin(), p.mPrevY.end());
+        frame.prevZ.assign(p.mPrevZ.begin(), p.mPrevZ.end());
+        frame.x.assign(p.mPosX.begin(), p.mPosX.end());
+        frame.y.assign(p.mPosY.begin(), p.mPosY.end());
+        frame.z.assign(p.mPosZ.begin(), p.mPosZ.end());
+        if (frame.shape != mShape)
+        {
+            frame.triangles = mTriangles;
+            frame.shape = mShape;
+        }
+        frame.steps = mSteps;
+        frame.stats = mSolver.lastStepStats();
+        frame.stepMs = mStepMs;
+        frame.time = Clock::now();
+        mFrames.publish();
+    }
+}
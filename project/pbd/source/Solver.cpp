@@ -0,0 +1,2064 @@
+#include "Solver.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace
+{
+    //batches smaller than this are projected on the calling thread, handing
+    //them to the pool costs more than it saves
+    const std::size_t kMinParallelBatch = 512;
+
+    //self collision candidates are gathered once per step within this
+    //multiple of the thickness, so that pairs which only come into contact
+    //during the iterations are still caught
+    const float kSelfCollisionMargin = 2.0f;
+
+    //self collision thickness relative to the cloth's spacing when none is
+    //given; 0.4 on the default grid
+    const float kThicknessPerSpacing = 0.4f;
+
+    //measuring the error costs about as much as a Jacobi iteration, so with
+    //a tolerance set it is only checked every few iterations
+    const int kErrorCheckInterval = 4;
+
+    //self collision neighbours per particle set aside up front: twice what
+    //a flat sheet has within the search radius, kept within these bounds.
+    //Denser contact than that grows the lists on the step it first happens.
+    const float kMinNeighbourReserve = 16.0f;
+    const float kMaxNeighbourReserve = 64.0f;
+
+    //coarsening stops at a level this small, below it a coarser level
+    //saves nothing
+    const std::size_t kMinCoarseParticles = 16;
+
+    //acceleration starts after this many plain iterations. The second
+    //half of them estimates the spectral radius; the first still carries
+    //the prediction's high frequencies, which die out fast.
+    const int kAccelerationWarmup = 8;
+    //radii are kept below 1, where the Chebyshev weight tends to 2
+    const float kMaxSpectralRadius = 0.995f;
+    //weight of each substep's measurement in the running radius, and the
+    //accelerated iterations a substep needs before its rate is measured
+    const float kRadiusBlend = 0.2f;
+    const int kMinRateIterations = 4;
+    //corrections this many times larger than when acceleration started
+    //count as diverging; the radius then shrinks by kFallbackShrink
+    const float kDivergenceGrowth = 2.0f;
+    const float kFallbackShrink = 0.9f;
+
+    //moves constraints built on grid indices onto the reordered particles
+    //and sorts them by end points, so consecutive constraints touch nearby
+    //memory
+    void reorderConstraints(pbd::ConstraintList& constraints,
+        std::vector<int> const& particle)
+    {
+        for (auto& c : constraints){
+            int i = particle[c.i];
+            int j = particle[c.j];
+            c.i = std::min(i, j);
+            c.j = std::max(i, j);
+        }
+        std::sort(constraints.begin(), constraints.end(),
+            [](pbd::DistanceConstraint const& a, pbd::DistanceConstraint const& b)
+        {
+            return (a.i != b.i) ? a.i < b.i : a.j < b.j;
+        });
+    }
+
+    //appends the runs of each batch's constraints for which active holds,
+    //keeping the batch's type and pin pattern; returns how many
+    //constraints the runs cover
+    template <typename List, typename Active>
+    std::size_t appendActiveRuns(List const& constraints,
+        std::vector<pbd::ConstraintBatch> const& batches, Active const& active,
+        std::vector<pbd::ConstraintBatch>& runs)
+    {
+        std::size_t covered = 0;
+        for (auto const& batch : batches){
+            if (batch.pins == pbd::PinPattern::All){
+                continue;
+            }
+            std::size_t k = batch.begin;
+            while (k < batch.end){
+                while (k < batch.end && !active(constraints[k])){
+                    k++;
+                }
+                std::size_t begin = k;
+                while (k < batch.end && active(constraints[k])){
+                    k++;
+                }
+                if (k > begin){
+                    pbd::ConstraintBatch run = batch;
+                    run.begin = begin;
+                    run.end = k;
+                    runs.push_back(run);
+                    covered += k - begin;
+                }
+            }
+        }
+        return covered;
+    }
+}
+
+namespace pbd
+{
+    Solver::Solver() :
+        mKernel(selectDistanceKernel())
+    {
+        mColliders.addSphere({Vector3(0.0f, 0.0f, 0.0f), 2.0f});
+        mColliders.addPlane({Vector3(0.0f, 1.0f, 0.0f), 0.0f});
+
+        reset();
+    }
+
+    void Solver::setGridSize(int width, int length)
+    {
+        float w = (float)((width > 1) ? width : 2);
+        float l = (float)((length > 1) ? length : 2);
+        mShapeChanged |= w != mWidth || l != mLength || !mMeshVertices.empty();
+        mWidth = w;
+        mLength = l;
+        mMeshVertices.clear();
+        mMeshTriangles.clear();
+        reset();
+    }
+
+    void Solver::setClothMesh(std::vector<Vector3> vertices,
+        std::vector<unsigned int> triangles)
+    {
+        mShapeChanged |= triangles != mMeshTriangles ||
+            vertices.size() != mMeshVertices.size() ||
+            !std::equal(vertices.begin(), vertices.end(), mMeshVertices.begin(),
+                [](Vector3 const& a, Vector3 const& b)
+                {
+                    return a.x == b.x && a.y == b.y && a.z == b.z;
+                });
+        mMeshVertices = std::move(vertices);
+        mMeshTriangles = std::move(triangles);
+        reset();
+    }
+
+    void Solver::setParticleOrder(ParticleOrder order)
+    {
+        mShapeChanged |= order != mOrder;
+        mOrder = order;
+    }
+
+    ParticleOrder Solver::particleOrder() const
+    {
+        return mOrder;
+    }
+
+    std::vector<int> const& Solver::inputIndices() const
+    {
+        return mInputIndex;
+    }
+
+    void Solver::setClothMass(float mass)
+    {
+        mass = (mass > 0.0f) ? mass : mMass;
+        mShapeChanged |= mass != mMass;
+        mMass = mass;
+    }
+
+    void Solver::setSpacing(float spacing)
+    {
+        spacing = (spacing > 0.0f) ? spacing : mRest;
+        mShapeChanged |= spacing != mRest;
+        mRest = spacing;
+    }
+
+    void Solver::setClothHeight(float height)
+    {
+        mShapeChanged |= height != mHeight;
+        mHeight = height;
+    }
+
+    void Solver::setPins(std::vector<int> pins)
+    {
+        mShapeChanged |= pins != mPins;
+        mPins = std::move(pins);
+    }
+
+    void Solver::setGravity(float g)
+    {
+        wake();
+        mG = g;
+    }
+
+    float Solver::gravity() const
+    {
+        return mG;
+    }
+
+    void Solver::setDamping(float damping)
+    {
+        wake();
+        mDamping = (damping > 0.0f) ? damping : 0.0f;
+    }
+
+    float Solver::damping() const
+    {
+        return mDamping;
+    }
+
+    void Solver::setSpherePosition(Vector3 const& pos)
+    {
+        wake();
+        if (!mColliders.spheres().empty())
+        {
+            mColliders.spheres()[0].center = pos;
+        }
+    }
+
+    ColliderSet& Solver::colliders()
+    {
+        wake();
+        return mColliders;
+    }
+
+    void Solver::setThreadCount(int threads)
+    {
+        if (threads <= 1)
+        {
+            mPool.reset();
+        }
+        else if (threads != threadCount())
+        {
+            mPool.reset(new ThreadPool(threads));
+        }
+        reserveScratch();
+        settleStorage();
+    }
+
+    int Solver::threadCount() const
+    {
+        return mPool ? (int)mPool->size() : 1;
+    }
+
+    void Solver::setSolverMode(SolverMode mode)
+    {
+        wake();
+        mMode = mode;
+    }
+
+    SolverMode Solver::solverMode() const
+    {
+        return mMode;
+    }
+
+    void Solver::setRelaxation(float omega)
+    {
+        wake();
+        mRelaxation = omega;
+    }
+
+    const char* Solver::kernelName() const
+    {
+        return (mMode == SolverMode::Jacobi) ? distanceKernelName(mKernel) : "scalar";
+    }
+
+    void Solver::setSelfCollision(bool enabled, float thickness)
+    {
+        wake();
+        mSelfCollision = enabled;
+        mThicknessSetting = (thickness > 0.0f) ? thickness : 0.0f;
+        reserveScratch();
+        settleStorage();
+    }
+
+    bool Solver::selfCollision() const
+    {
+        return mSelfCollision;
+    }
+
+    float Solver::selfCollisionThickness() const
+    {
+        return mThicknessSetting;
+    }
+
+    float Solver::contactThickness() const
+    {
+        return mThickness;
+    }
+
+    void Solver::setSubsteps(int substeps)
+    {
+        wake();
+        mSubsteps = (substeps > 0) ? substeps : 1;
+    }
+
+    void Solver::setMaxIterations(int iterations)
+    {
+        wake();
+        mMaxIterations = (iterations > 0) ? iterations : 1;
+    }
+
+    void Solver::setTolerance(float tolerance, ErrorNorm norm)
+    {
+        wake();
+        mTolerance = tolerance;
+        mNorm = norm;
+    }
+
+    int Solver::substeps() const
+    {
+        return mSubsteps;
+    }
+
+    int Solver::maxIterations() const
+    {
+        return mMaxIterations;
+    }
+
+    float Solver::tolerance() const
+    {
+        return mTolerance;
+    }
+
+    void Solver::setHierarchy(int levels, int coarseIterations)
+    {
+        levels = (levels > 1) ? levels : 1;
+        coarseIterations = (coarseIterations > 0) ? coarseIterations : 1;
+        wake();
+        mCoarseIterations = coarseIterations;
+        if (levels != mLevels)
+        {
+            mLevels = levels;
+            buildHierarchy();
+            settleStorage();
+        }
+    }
+
+    int Solver::hierarchyLevels() const
+    {
+        return mLevels;
+    }
+
+    int Solver::coarseIterations() const
+    {
+        return mCoarseIterations;
+    }
+
+    int Solver::builtLevels() const
+    {
+        return (int)mHierarchy.size() + 1;
+    }
+
+    void Solver::setAcceleration(Acceleration acceleration, float spectralRadius)
+    {
+        wake();
+        mAcceleration = acceleration;
+        mRadiusSetting = std::min(std::max(spectralRadius, 0.0f), kMaxSpectralRadius);
+        mSpectralRadius = mRadiusSetting;
+        reserveScratch();
+        settleStorage();
+    }
+
+    Acceleration Solver::acceleration() const
+    {
+        return mAcceleration;
+    }
+
+    float Solver::spectralRadius() const
+    {
+        return mSpectralRadius;
+    }
+
+    int Solver::accelerationFallbacks() const
+    {
+        return mAccelerationFallbacks;
+    }
+
+    ErrorNorm Solver::errorNorm() const
+    {
+        return mNorm;
+    }
+
+    void Solver::setCompliance(ConstraintType type, float compliance)
+    {
+        wake();
+        mCompliance[(int)type] = (compliance > 0.0f) ? compliance : 0.0f;
+    }
+
+    float Solver::compliance(ConstraintType type) const
+    {
+        return mCompliance[(int)type];
+    }
+
+    void Solver::setConstraintEnabled(ConstraintType type, bool enabled)
+    {
+        if (mEnabled[(int)type] != enabled)
+        {
+            //the pin patterns are worked out from the real inverse masses
+            wake();
+            mEnabled[(int)type] = enabled;
+            buildConstraints();
+        }
+    }
+
+    bool Solver::constraintEnabled(ConstraintType type) const
+    {
+        return mEnabled[(int)type];
+    }
+
+    void Solver::setProfiler(Profiler* profiler)
+    {
+        mProfiler = profiler;
+    }
+
+    void Solver::setSleeping(bool enabled, float speed, float error, int steps)
+    {
+        wake();
+        mSleepEnabled = enabled;
+        mSleepSpeed = (speed > 0.0f) ? speed : 0.0f;
+        mSleepError = (error > 0.0f) ? error : 0.0f;
+        mSleepSteps = (steps > 0) ? steps : 1;
+        buildSleepTiles();
+        settleStorage();
+    }
+
+    bool Solver::sleepEnabled() const
+    {
+        return mSleepEnabled;
+    }
+
+    float Solver::sleepSpeed() const
+    {
+        return mSleepSpeed;
+    }
+
+    float Solver::sleepError() const
+    {
+        return mSleepError;
+    }
+
+    int Solver::sleepSteps() const
+    {
+        return mSleepSteps;
+    }
+
+    std::size_t Solver::tileCount() const
+    {
+        return mTileAsleep.size();
+    }
+
+    std::size_t Solver::sleepingTileCount() const
+    {
+        return mSleepingTiles;
+    }
+
+    void Solver::step(float dt)
+    {
+        ScopedTimer timer(mProfiler, "step");
+        mParticles.storePrevious();
+        mStats.substeps = mSubsteps;
+        mStats.iterations = 0;
+
+        float h = dt / mSubsteps;
+        for (int i = 0; i < mSubsteps; i++){
+            mStats.iterations += substep(h);
+        }
+
+        measureError(mStats.maxError, mStats.rmsError);
+        if (mSleepEnabled){
+            updateSleep();
+        }
+        mStats.sleepingTiles = (int)mSleepingTiles;
+    }
+
+    StepStats const& Solver::lastStepStats() const
+    {
+        return mStats;
+    }
+
+    int Solver::substep(float dt)
+    {
+        ParticleSet& p = mParticles;
+
+        //sleeping particles are left out of every per-particle pass
+        //for each particle in mesh:
+          //particle.velocity = particle.velocity + t*(particle.weight)*(external forces)*(particle.position)
+            //Symplectic Euler: vi(t0 + t) = vi(t0) + t(fi/mi)t0
+        //pinned particles keep the zero velocity they were given when pinned
+        float dv = dt*mG;
+        {
+            ScopedTimer timer(mProfiler, "forces");
+            for (auto const& range : mAwakeRanges){
+                for (std::size_t i = range.begin; i < range.end; i++){
+                    p.mVelY[i] += (p.mInvMass[i] > 0.0f) ? dv : 0.0f;
+                }
+            }
+        }
+
+        //for each particle in mesh:
+          //particle.posprediction = particle.position + t*particle.velocity
+            //Symplectic Euler: xi(t0 + t) = xi(t0) + t(vi(t0 + t))
+        {
+            ScopedTimer timer(mProfiler, "predict");
+            for (auto const& range : mAwakeRanges){
+                for (std::size_t i = range.begin; i < range.end; i++){
+                    p.mPredX[i] = p.mPosX[i] + dt*p.mVelX[i];
+                }
+                for (std::size_t i = range.begin; i < range.end; i++){
+                    p.mPredY[i] = p.mPosY[i] + dt*p.mVelY[i];
+                }
+                for (std::size_t i = range.begin; i < range.end; i++){
+                    p.mPredZ[i] = p.mPosZ[i] + dt*p.mVelZ[i];
+                }
+            }
+        }
+
+        if (mSelfCollision){
+            findSelfCollisions();
+        }
+
+        //XPBD: the multipliers start from zero every substep and the
+        //compliance is scaled by the substep length
+        for (int t = 0; t < kConstraintTypeCount; t++){
+            mAlpha[t] = mCompliance[t]/(dt*dt);
+        }
+        std::fill(mLambda.begin(), mLambda.end(), 0.0f);
+        std::fill(mBendingLambda.begin(), mBendingLambda.end(), 0.0f);
+        if (mMode == SolverMode::Jacobi){
+            updateJacobiStiffness();
+        }
+        if (!mHierarchy.empty()){
+            solveHierarchy();
+        }
+
+        bool accelerate = mAcceleration != Acceleration::None;
+        if (accelerate){
+            startAcceleration();
+        }
+
+        //iteratively:
+          //project constraints onto each particle.posprediction
+        int iter = 0;
+        while (iter < mMaxIterations){
+            projectConstraints();
+            if (mSelfCollision){
+                solveSelfCollisions();
+            }
+            collide();
+            iter++;
+            if (accelerate){
+                accelerateIteration(iter);
+            }
+
+            if (mTolerance > 0.0f && iter % kErrorCheckInterval == 0){
+                float maxError, rmsError;
+                measureError(maxError, rmsError);
+                float error = (mNorm == ErrorNorm::Max) ? maxError : rmsError;
+                if (error < mTolerance){
+                    break;
+                }
+            }
+        }
+        if (accelerate){
+            finishAcceleration();
+        }
+
+        //for each particle in mesh:
+          //particle.velocity = (particle.posprediction - particle.position)/t
+          //particle.position = particle.posprediction
+        ScopedTimer timer(mProfiler, "velocity");
+        float invDt = 1.0f / dt;
+        if (mDamping > 0.0f){
+            invDt /= 1.0f + mDamping*dt;
+        }
+        for (auto const& range : mAwakeRanges){
+            for (std::size_t i = range.begin; i < range.end; i++){
+                if (p.mInvMass[i] > 0.0f){
+                    p.mVelX[i] = (p.mPredX[i] - p.mPosX[i])*invDt;
+                    p.mVelY[i] = (p.mPredY[i] - p.mPosY[i])*invDt;
+                    p.mVelZ[i] = (p.mPredZ[i] - p.mPosZ[i])*invDt;
+                    p.mPosX[i] = p.mPredX[i];
+                    p.mPosY[i] = p.mPredY[i];
+                    p.mPosZ[i] = p.mPredZ[i];
+                }
+            }
+        }
+
+        return iter;
+    }
+
+    void Solver::measureError(float& maxError, float& rmsError)
+    {
+        ScopedTimer timer(mProfiler, "error");
+        //one partial result per chunk, reduced in chunk order so that the
+        //result does not depend on timing
+        std::size_t chunks = mPool ? mPool->size() : 1;
+        std::size_t count = mStructuralCount;
+        mErrorMax.assign(chunks, 0.0f);
+        mErrorSum.assign(chunks, 0.0);
+
+        auto measure = [this, chunks, count](std::size_t first, std::size_t last)
+        {
+            ParticleSet const& p = mParticles;
+            for (std::size_t chunk = first; chunk < last; chunk++){
+                float chunkMax = 0.0f;
+                double chunkSum = 0.0;
+                for (std::size_t k = (count*chunk)/chunks; k < (count*(chunk + 1))/chunks; k++){
+                    auto const& c = mConstraints[k];
+                    float dx = p.mPredX[c.j] - p.mPredX[c.i];
+                    float dy = p.mPredY[c.j] - p.mPredY[c.i];
+                    float dz = p.mPredZ[c.j] - p.mPredZ[c.i];
+                    float stretch = std::fabs(std::sqrt(dx*dx + dy*dy + dz*dz) - c.restLength)/c.restLength;
+                    chunkMax = (stretch > chunkMax) ? stretch : chunkMax;
+                    chunkSum += (double)stretch*stretch;
+                }
+                mErrorMax[chunk] = chunkMax;
+                mErrorSum[chunk] = chunkSum;
+            }
+        };
+
+        if (mPool && count >= kMinParallelBatch){
+            mPool->parallelFor(chunks, measure);
+        }else{
+            measure(0, chunks);
+        }
+
+        maxError = 0.0f;
+        double sum = 0.0;
+        for (std::size_t chunk = 0; chunk < chunks; chunk++){
+            maxError = (mErrorMax[chunk] > maxError) ? mErrorMax[chunk] : maxError;
+            sum += mErrorSum[chunk];
+        }
+        rmsError = (count > 0) ? (float)std::sqrt(sum/count) : 0.0f;
+    }
+
+    void Solver::reset()
+    {
+        //the constraints only depend on the shape of the cloth, so while
+        //that stays the same a reset just puts the particles back at rest
+        //and reuses everything else without allocating
+        wake();
+        mSpectralRadius = mRadiusSetting;
+        mAccelerationFallbacks = 0;
+        if (!mShapeChanged)
+        {
+            ParticleSet& p = mParticles;
+            std::copy(mRestX.begin(), mRestX.end(), p.mPosX.begin());
+            std::copy(mRestY.begin(), mRestY.end(), p.mPosY.begin());
+            std::copy(mRestZ.begin(), mRestZ.end(), p.mPosZ.begin());
+            std::copy(mRestX.begin(), mRestX.end(), p.mPrevX.begin());
+            std::copy(mRestY.begin(), mRestY.end(), p.mPrevY.begin());
+            std::copy(mRestZ.begin(), mRestZ.end(), p.mPrevZ.begin());
+            for (FloatArray* values : {&p.mPredX, &p.mPredY, &p.mPredZ,
+                &p.mVelX, &p.mVelY, &p.mVelZ}){
+                std::fill(values->begin(), values->end(), 0.0f);
+            }
+            mStats = {0, 0, 0.0f, 0.0f, 0};
+            return;
+        }
+
+        buildParticles();
+        buildConstraints();
+        mShapeChanged = false;
+    }
+
+    ParticleSet const& Solver::particles() const
+    {
+        return mParticles;
+    }
+
+    int Solver::width() const
+    {
+        return (int)mWidth;
+    }
+
+    int Solver::length() const
+    {
+        return (int)mLength;
+    }
+
+    ConstraintList const& Solver::constraints() const
+    {
+        return mConstraints;
+    }
+
+    BendingList const& Solver::bendingConstraints() const
+    {
+        return mBendings;
+    }
+
+    std::vector<unsigned int> const& Solver::triangles() const
+    {
+        return mTriangles;
+    }
+
+    template <typename Self, typename Fn>
+    void Solver::forEachArray(Self& self, Fn fn)
+    {
+        self.mParticles.forEachArray(fn);
+        for (auto* values : {&self.mRestX, &self.mRestY, &self.mRestZ,
+            &self.mLambda, &self.mBendingLambda, &self.mCorrX, &self.mCorrY,
+            &self.mCorrZ, &self.mInvDegree, &self.mSelfX, &self.mSelfY,
+            &self.mSelfZ, &self.mAwakeInvMass, &self.mStartX, &self.mStartY,
+            &self.mStartZ, &self.mCurrX, &self.mCurrY, &self.mCurrZ,
+            &self.mPrevX, &self.mPrevY, &self.mPrevZ}){
+            fn(*values);
+        }
+        self.mHash.forEachArray(fn);
+        for (auto& candidates : self.mCandidates){
+            fn(candidates);
+        }
+    }
+
+    std::size_t Solver::storageBytes() const
+    {
+        std::size_t bytes = 0;
+        forEachArray(*this, [&bytes](auto const& values)
+        {
+            bytes += arenaBytes(values.capacity()*sizeof(values[0]));
+        });
+        return bytes;
+    }
+
+    void Solver::useStorage(void* block, std::size_t bytes)
+    {
+        packStorage(std::unique_ptr<Arena>(new Arena(block, bytes)));
+    }
+
+    bool Solver::storagePooled() const
+    {
+        bool pooled = true;
+        forEachArray(*this, [this, &pooled](auto const& values)
+        {
+            if (values.capacity() > 0 && !(mArena && mArena->owns(values.data()))){
+                pooled = false;
+            }
+        });
+        return pooled;
+    }
+
+    void Solver::packStorage(std::unique_ptr<Arena> arena)
+    {
+        //every array keeps its capacity, so whatever was sized to fit
+        //before still fits without allocating
+        forEachArray(*this, [&arena](auto& values)
+        {
+            using Array = typename std::decay<decltype(values)>::type;
+            Array packed{typename Array::allocator_type(arena.get())};
+            packed.reserve(values.capacity());
+            packed.assign(values.begin(), values.end());
+            values.swap(packed);
+        });
+        mArena = std::move(arena);
+    }
+
+    void Solver::settleStorage()
+    {
+        if (!storagePooled())
+        {
+            packStorage(std::unique_ptr<Arena>(new Arena(storageBytes())));
+        }
+    }
+
+    void Solver::buildParticles()
+    {
+        if (mMeshVertices.empty())
+        {
+            buildGrid();
+        }
+        else
+        {
+            buildMesh();
+        }
+
+        std::size_t count = mParticles.size();
+        if (mOrder == ParticleOrder::Morton)
+        {
+            mInputIndex = mortonOrder(mParticles.mPosX.data(),
+                mParticles.mPosY.data(), mParticles.mPosZ.data(), count);
+        }
+        else if (mOrder == ParticleOrder::Rcm)
+        {
+            mInputIndex = rcmOrder(mTriangles, count);
+        }
+        else
+        {
+            mInputIndex.resize(count);
+            for (std::size_t i = 0; i < count; i++){
+                mInputIndex[i] = (int)i;
+            }
+        }
+
+        if (mOrder != ParticleOrder::Input)
+        {
+            std::vector<int> particle(count);
+            for (std::size_t i = 0; i < count; i++){
+                particle[mInputIndex[i]] = (int)i;
+            }
+            mParticles.permute(mInputIndex);
+            for (auto& index : mTriangles){
+                index = (unsigned int)particle[index];
+            }
+        }
+
+        mRestX = mParticles.mPosX;
+        mRestY = mParticles.mPosY;
+        mRestZ = mParticles.mPosZ;
+    }
+
+    void Solver::buildMesh()
+    {
+        //each vertex gets a third of the area of the triangles around it
+        std::size_t count = mMeshVertices.size();
+        std::vector<float> area(count, 0.0f);
+        float total = 0.0f;
+        mTriangles.clear();
+        for (std::size_t t = 0; t + 2 < mMeshTriangles.size(); t += 3){
+            unsigned int a = mMeshTriangles[t];
+            unsigned int b = mMeshTriangles[t + 1];
+            unsigned int c = mMeshTriangles[t + 2];
+            if (a >= count || b >= count || c >= count){
+                continue;
+            }
+            float triangleArea = 0.5f*mag(cross(mMeshVertices[b] - mMeshVertices[a],
+                mMeshVertices[c] - mMeshVertices[a]));
+            area[a] += triangleArea/3.0f;
+            area[b] += triangleArea/3.0f;
+            area[c] += triangleArea/3.0f;
+            total += triangleArea;
+            mTriangles.push_back(a);
+            mTriangles.push_back(b);
+            mTriangles.push_back(c);
+        }
+
+        //vertices on no triangle (or a degenerate mesh) get an even share
+        float share = mMass/(float)count;
+        mParticles.clear();
+        mParticles.reserve(count);
+        for (std::size_t i = 0; i < count; i++){
+            float mass = (total > 0.0f) ? mMass*area[i]/total : share;
+            mParticles.add((mass > 0.0f) ? mass : share, mMeshVertices[i]);
+        }
+
+        for (int pin : mPins){
+            if (pin >= 0 && (std::size_t)pin < count){
+                mParticles.setMovable(pin, false);
+            }
+        }
+    }
+
+    void Solver::buildGrid()
+    {
+        //create Particle grid
+        int width = (int)mWidth;
+        int length = (int)mLength;
+        mParticles.clear();
+        mParticles.reserve(width*length);
+        for(int i = 0; i < width; i++){
+            for (int j = 0; j < length; j++){
+                float mass = mMass/(mWidth*mLength);
+                Vector3 pos = Vector3(mRest*(i - mWidth/2.0f),mHeight,mRest*(j - mLength/2.0f));
+                mParticles.add(mass, pos);
+            }
+        }
+
+        if (mPins.empty())
+        {
+            //pin the two corners of the first row
+            mParticles.setMovable(0, false);
+            mParticles.setMovable(length-1, false);
+            Vector3 first = mParticles.position(0);
+            Vector3 last = mParticles.position(length-1);
+            mParticles.setPosition(length-1, last + (first - last)*(1/(2*mLength)));
+        }
+        else
+        {
+            for (int pin : mPins){
+                if (pin >= 0 && pin < width*length){
+                    mParticles.setMovable(pin, false);
+                }
+            }
+        }
+
+        //two triangles per grid cell
+        mTriangles.clear();
+        mTriangles.reserve(6*(width-1)*(length-1));
+        for(int i = 0; i < width-1; i++){
+            for(int j = 0; j < length-1; j++){
+                unsigned int index = i*length + j;
+                mTriangles.push_back(index);
+                mTriangles.push_back(index+1);
+                mTriangles.push_back(index+length);
+                mTriangles.push_back(index+1);
+                mTriangles.push_back(index+length+1);
+                mTriangles.push_back(index+length);
+            }
+        }
+    }
+
+    void Solver::buildConstraints()
+    {
+        ConstraintList structural;
+        ConstraintList shear;
+        if (mMeshVertices.empty())
+        {
+            buildGridConstraints(structural, shear);
+        }
+        else if (mEnabled[(int)ConstraintType::Structural])
+        {
+            structural = buildEdgeConstraints(mTriangles, mRestX.data(),
+                mRestY.data(), mRestZ.data());
+        }
+
+        //each family is coloured on its own so its batches stay contiguous
+        std::size_t count = mParticles.size();
+        mBatches = colourConstraints(structural, count, ConstraintType::Structural);
+        auto shearBatches = colourConstraints(shear, count, ConstraintType::Shear,
+            structural.size());
+        mBatches.insert(mBatches.end(), shearBatches.begin(), shearBatches.end());
+
+        mStructuralCount = structural.size();
+        mConstraints.swap(structural);
+        mConstraints.insert(mConstraints.end(), shear.begin(), shear.end());
+
+        mBendings.clear();
+        if (mEnabled[(int)ConstraintType::Bending]){
+            mBendings = buildBendingConstraints(mTriangles, mRestX.data(),
+                mRestY.data(), mRestZ.data());
+        }
+        mBendingBatches = colourConstraints(mBendings, count, ConstraintType::Bending);
+
+        //pinned particles only change on reset, so the pin patterns are
+        //sorted out here once
+        float const* invMass = mParticles.mInvMass.data();
+        mBatches = splitByPins(mConstraints, mBatches, invMass);
+        mBendingBatches = splitByPins(mBendings, mBendingBatches, invMass);
+
+        mLambda.assign(mConstraints.size(), 0.0f);
+        mBendingLambda.assign(mBendings.size(), 0.0f);
+        buildJacobiAdjacency();
+        buildHierarchy();
+        reserveScratch();
+        buildSleepTiles();
+        settleStorage();
+    }
+
+    void Solver::reserveScratch()
+    {
+        //scratch space used while stepping, sized for the cloth and thread
+        //count up front so that steps do not allocate
+        std::size_t count = mParticles.size();
+        std::size_t chunks = (std::size_t)threadCount();
+        mSelfX.resize(count);
+        mSelfY.resize(count);
+        mSelfZ.resize(count);
+        mErrorMax.assign(chunks, 0.0f);
+        mErrorSum.assign(chunks, 0.0);
+        reserveCandidates(chunks);
+        if (mAcceleration != Acceleration::None)
+        {
+            for (FloatArray* values : {&mCurrX, &mCurrY, &mCurrZ, &mPrevX, &mPrevY, &mPrevZ}){
+                values->resize(count);
+            }
+            mResidualSum.assign(chunks, 0.0);
+        }
+
+        //spacing of a mesh is its mean edge length
+        float spacing = mRest;
+        if (!mMeshVertices.empty() && mStructuralCount > 0)
+        {
+            double sum = 0.0;
+            for (std::size_t k = 0; k < mStructuralCount; k++){
+                sum += mConstraints[k].restLength;
+            }
+            spacing = (float)(sum/mStructuralCount);
+        }
+        mThickness = (mThicknessSetting > 0.0f) ? mThicknessSetting :
+            kThicknessPerSpacing*spacing;
+        float radius = mThickness*kSelfCollisionMargin;
+        float perParticle = 2.0f*3.14159265f*radius*radius/(spacing*spacing);
+        perParticle = std::min(std::max(perParticle, kMinNeighbourReserve),
+            kMaxNeighbourReserve);
+        mHash.reserve(count, (std::size_t)perParticle*count, chunks);
+    }
+
+    void Solver::reserveCandidates(std::size_t chunks)
+    {
+        //each chunk keeps its mesh candidate list between calls, with room
+        //for every triangle of the largest mesh a query can return. They
+        //are sized with the rest of the scratch space, so only the first
+        //step after adding a mesh allocates.
+        while (mCandidates.size() < chunks){
+            mCandidates.emplace_back(AlignedAllocator<int>(mArena.get()));
+        }
+        std::size_t triangles = 0;
+        for (auto const& mesh : mColliders.meshes()){
+            triangles = std::max(triangles, mesh.indices().size()/3);
+        }
+        for (std::size_t chunk = 0; chunk < chunks; chunk++){
+            mCandidates[chunk].reserve(triangles);
+        }
+    }
+
+    void Solver::buildGridConstraints(ConstraintList& structural,
+        ConstraintList& shear)
+    {
+        //one constraint per grid edge, so every edge is projected once per
+        //iteration instead of once from each side
+        int width = (int)mWidth;
+        int length = (int)mLength;
+        if (mEnabled[(int)ConstraintType::Structural]){
+            structural.reserve(2*width*length);
+            for(int i = 0; i < width; i++){
+                for(int j = 0; j < length; j++){
+                    int index = i*length + j;
+                    if(j < length-1){
+                        structural.push_back({index, index+1, mRest, 1.0f});
+                    }
+                    if(i < width-1){
+                        structural.push_back({index, index+length, mRest, 1.0f});
+                    }
+                }
+            }
+        }
+
+        //both diagonals of every cell
+        if (mEnabled[(int)ConstraintType::Shear]){
+            float diagonal = mRest*std::sqrt(2.0f);
+            shear.reserve(2*width*length);
+            for(int i = 0; i < width-1; i++){
+                for(int j = 0; j < length-1; j++){
+                    int index = i*length + j;
+                    shear.push_back({index, index+length+1, diagonal, 1.0f});
+                    shear.push_back({index+1, index+length, diagonal, 1.0f});
+                }
+            }
+        }
+
+        if (mOrder != ParticleOrder::Input)
+        {
+            std::vector<int> particle(mInputIndex.size());
+            for (std::size_t i = 0; i < mInputIndex.size(); i++){
+                particle[mInputIndex[i]] = (int)i;
+            }
+            reorderConstraints(structural, particle);
+            reorderConstraints(shear, particle);
+        }
+    }
+
+    void Solver::buildJacobiAdjacency()
+    {
+        std::size_t count = mParticles.size();
+        mAdjacencyOffsets.assign(count + 1, 0);
+        for (auto const& c : mConstraints){
+            mAdjacencyOffsets[c.i + 1]++;
+            mAdjacencyOffsets[c.j + 1]++;
+        }
+        for (std::size_t i = 0; i < count; i++){
+            mAdjacencyOffsets[i + 1] += mAdjacencyOffsets[i];
+        }
+
+        mAdjacency.resize(mAdjacencyOffsets[count]);
+        std::vector<int> cursor(mAdjacencyOffsets.begin(), mAdjacencyOffsets.end() - 1);
+        for (std::size_t k = 0; k < mConstraints.size(); k++){
+            mAdjacency[cursor[mConstraints[k].i]++] = (int)(k << 1);
+            mAdjacency[cursor[mConstraints[k].j]++] = (int)(k << 1) | 1;
+        }
+
+        mInvDegree.resize(count);
+        for (std::size_t i = 0; i < count; i++){
+            int degree = mAdjacencyOffsets[i + 1] - mAdjacencyOffsets[i];
+            mInvDegree[i] = (degree > 0) ? 1.0f/degree : 0.0f;
+        }
+
+        mCorrX.resize(mConstraints.size());
+        mCorrY.resize(mConstraints.size());
+        mCorrZ.resize(mConstraints.size());
+    }
+
+    void Solver::buildHierarchy()
+    {
+        mHierarchy.clear();
+        std::size_t count = mParticles.size();
+        if (mLevels <= 1 || count == 0)
+        {
+            return;
+        }
+
+        float const* invMass = mParticles.mInvMass.data();
+        auto restDistance = [this](int a, int b)
+        {
+            float dx = mRestX[b] - mRestX[a];
+            float dy = mRestY[b] - mRestY[a];
+            float dz = mRestZ[b] - mRestZ[a];
+            return std::sqrt(dx*dx + dy*dy + dz*dz);
+        };
+
+        //the full cloth's graph has an edge per distance constraint
+        std::vector<int> members(count);
+        for (std::size_t i = 0; i < count; i++){
+            members[i] = (int)i;
+        }
+        std::vector<std::pair<int, int>> edges;
+        edges.reserve(mConstraints.size());
+        for (auto const& c : mConstraints){
+            edges.push_back(std::make_pair(std::min(c.i, c.j), std::max(c.i, c.j)));
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        std::vector<int> offsets;
+        std::vector<int> adjacency;
+        std::vector<char> coarse(count);
+        std::vector<char> blocked(count);
+        std::vector<int> neighbours;
+        while ((int)mHierarchy.size() + 1 < mLevels && members.size() > kMinCoarseParticles){
+            offsets.assign(count + 1, 0);
+            for (auto const& e : edges){
+                offsets[e.first + 1]++;
+                offsets[e.second + 1]++;
+            }
+            for (std::size_t i = 0; i < count; i++){
+                offsets[i + 1] += offsets[i];
+            }
+            adjacency.resize(offsets[count]);
+            std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+            for (auto const& e : edges){
+                adjacency[cursor[e.first]++] = e.second;
+                adjacency[cursor[e.second]++] = e.first;
+            }
+
+            //greedy maximal independent set, pinned particles first so that
+            //the coarse levels know what holds the cloth up. On a grid this
+            //keeps every other particle each way.
+            std::fill(coarse.begin(), coarse.end(), 0);
+            std::fill(blocked.begin(), blocked.end(), 0);
+            for (int pass = 0; pass < 2; pass++){
+                for (int p : members){
+                    if ((pass == 0) != (invMass[p] == 0.0f) || blocked[p]){
+                        continue;
+                    }
+                    coarse[p] = 1;
+                    blocked[p] = 1;
+                    for (int k = offsets[p]; k < offsets[p + 1]; k++){
+                        blocked[adjacency[k]] = 1;
+                    }
+                }
+            }
+
+            HierarchyLevel level;
+            for (int p : members){
+                if (coarse[p]){
+                    level.particles.push_back(p);
+                }else{
+                    level.children.push_back(p);
+                }
+            }
+            if (level.children.empty()){
+                break;
+            }
+
+            //every child has a coarse neighbour (the set is maximal); nearer
+            //ones get more of the weight. Coarse particles sharing a child
+            //are joined on the new level.
+            std::vector<std::pair<int, int>> coarseEdges;
+            level.parentOffsets.push_back(0);
+            for (int child : level.children){
+                neighbours.clear();
+                for (int k = offsets[child]; k < offsets[child + 1]; k++){
+                    if (coarse[adjacency[k]]){
+                        neighbours.push_back(adjacency[k]);
+                    }
+                }
+
+                float total = 0.0f;
+                std::size_t first = level.weights.size();
+                for (int parent : neighbours){
+                    float distance = restDistance(child, parent);
+                    float weight = 1.0f/std::max(distance, 1e-6f);
+                    level.parents.push_back(parent);
+                    level.weights.push_back(weight);
+                    total += weight;
+                }
+                for (std::size_t k = first; k < level.weights.size(); k++){
+                    level.weights[k] /= total;
+                }
+                level.parentOffsets.push_back((int)level.parents.size());
+
+                for (std::size_t a = 0; a < neighbours.size(); a++){
+                    for (std::size_t b = a + 1; b < neighbours.size(); b++){
+                        coarseEdges.push_back(std::make_pair(
+                            std::min(neighbours[a], neighbours[b]),
+                            std::max(neighbours[a], neighbours[b])));
+                    }
+                }
+            }
+            std::sort(coarseEdges.begin(), coarseEdges.end());
+            coarseEdges.erase(std::unique(coarseEdges.begin(), coarseEdges.end()),
+                coarseEdges.end());
+
+            for (auto const& e : coarseEdges){
+                level.constraints.push_back({e.first, e.second,
+                    restDistance(e.first, e.second), 1.0f});
+            }
+            level.batches = colourConstraints(level.constraints, count,
+                ConstraintType::Structural);
+
+            members = level.particles;
+            edges.swap(coarseEdges);
+            mHierarchy.push_back(std::move(level));
+        }
+
+        mStartX.resize(count);
+        mStartY.resize(count);
+        mStartZ.resize(count);
+    }
+
+    void Solver::solveHierarchy()
+    {
+        ScopedTimer timer(mProfiler, "hierarchy");
+        ParticleSet& p = mParticles;
+        std::copy(p.mPredX.begin(), p.mPredX.end(), mStartX.begin());
+        std::copy(p.mPredY.begin(), p.mPredY.end(), mStartY.begin());
+        std::copy(p.mPredZ.begin(), p.mPredZ.end(), mStartZ.begin());
+
+        for (std::size_t l = mHierarchy.size(); l-- > 0;){
+            HierarchyLevel const& level = mHierarchy[l];
+
+            //coarse constraints only pull stretched particles together, so
+            //they do not stiffen the cloth against bending or compression
+            auto project = [this, &level](std::size_t begin, std::size_t end)
+            {
+                ParticleSet& p = mParticles;
+                for (std::size_t k = begin; k < end; k++){
+                    DistanceConstraint const& c = level.constraints[k];
+                    float w1 = p.mInvMass[c.i];
+                    float w2 = p.mInvMass[c.j];
+                    float dx = p.mPredX[c.j] - p.mPredX[c.i];
+                    float dy = p.mPredY[c.j] - p.mPredY[c.i];
+                    float dz = p.mPredZ[c.j] - p.mPredZ[c.i];
+                    float distance = std::sqrt(dx*dx + dy*dy + dz*dz);
+                    float stretch = distance - c.restLength;
+                    if (stretch <= 0.0f || w1 + w2 == 0.0f){
+                        continue;
+                    }
+                    float s = stretch/((w1 + w2)*distance);
+                    p.mPredX[c.i] += w1*s*dx;
+                    p.mPredY[c.i] += w1*s*dy;
+                    p.mPredZ[c.i] += w1*s*dz;
+                    p.mPredX[c.j] -= w2*s*dx;
+                    p.mPredY[c.j] -= w2*s*dy;
+                    p.mPredZ[c.j] -= w2*s*dz;
+                }
+            };
+            for (int iter = 0; iter < mCoarseIterations; iter++){
+                for (auto const& batch : level.batches){
+                    std::size_t count = batch.end - batch.begin;
+                    if (mPool && batch.parallel && count >= kMinParallelBatch){
+                        std::size_t first = batch.begin;
+                        mPool->parallelFor(count, [&project, first](std::size_t begin, std::size_t end)
+                        {
+                            project(first + begin, first + end);
+                        });
+                    }else{
+                        project(batch.begin, batch.end);
+                    }
+                }
+            }
+
+            //the particles this level left out move with their parents, by
+            //everything the parents have moved since the coarsest level
+            //started; each child only writes itself
+            auto prolong = [this, &level](std::size_t begin, std::size_t end)
+            {
+                ParticleSet& p = mParticles;
+                for (std::size_t k = begin; k < end; k++){
+                    int child = level.children[k];
+                    if (p.mInvMass[child] == 0.0f){
+                        continue;
+                    }
+                    float dx = 0.0f;
+                    float dy = 0.0f;
+                    float dz = 0.0f;
+                    for (int m = level.parentOffsets[k]; m < level.parentOffsets[k + 1]; m++){
+                        int parent = level.parents[m];
+                        float w = level.weights[m];
+                        dx += w*(p.mPredX[parent] - mStartX[parent]);
+                        dy += w*(p.mPredY[parent] - mStartY[parent]);
+                        dz += w*(p.mPredZ[parent] - mStartZ[parent]);
+                    }
+                    p.mPredX[child] += dx;
+                    p.mPredY[child] += dy;
+                    p.mPredZ[child] += dz;
+                }
+            };
+            std::size_t children = level.children.size();
+            if (mPool && children >= kMinParallelBatch){
+                mPool->parallelFor(children, prolong);
+            }else{
+                prolong(0, children);
+            }
+        }
+    }
+
+    void Solver::startAcceleration()
+    {
+        //the iterates before the first iteration are the predictions
+        ParticleSet const& p = mParticles;
+        std::copy(p.mPredX.begin(), p.mPredX.end(), mCurrX.begin());
+        std::copy(p.mPredY.begin(), p.mPredY.end(), mCurrY.begin());
+        std::copy(p.mPredZ.begin(), p.mPredZ.end(), mCurrZ.begin());
+        mAccelerating = false;
+        mOmega = 1.0f;
+        mResidualFirst = 0.0f;
+        mResidualStart = 0.0f;
+        mResidualLast = 0.0f;
+        mAcceleratedIterations = 0;
+    }
+
+    void Solver::accelerateIteration(int iter)
+    {
+        ScopedTimer timer(mProfiler, "acceleration");
+        float rho = mSpectralRadius;
+        if (mAccelerating){
+            if (mAcceleration == Acceleration::Momentum){
+                mOmega = 2.0f/(1.0f + std::sqrt(1.0f - rho*rho));
+            }else{
+                mOmega = (mOmega == 1.0f) ? 2.0f/(2.0f - rho*rho) : 4.0f/(4.0f - rho*rho*mOmega);
+            }
+        }
+
+        //q = prev + omega*(pred - prev), where pred is what this iteration
+        //made of curr, measuring |pred - curr| on the way. The new iterate
+        //goes into prev's arrays, which then swap with curr's. Chunks are
+        //fixed index ranges reduced in order, so the sum does not depend on
+        //timing; sleeping particles have no mass and are skipped like pins.
+        std::size_t count = mParticles.size();
+        std::size_t chunks = mResidualSum.size();
+        float omega = mOmega;
+        auto blend = [this, count, chunks, omega](std::size_t first, std::size_t last)
+        {
+            ParticleSet& p = mParticles;
+            for (std::size_t chunk = first; chunk < last; chunk++){
+                double sum = 0.0;
+                for (std::size_t i = (count*chunk)/chunks; i < (count*(chunk + 1))/chunks; i++){
+                    if (p.mInvMass[i] == 0.0f){
+                        continue;
+                    }
+                    float dx = p.mPredX[i] - mCurrX[i];
+                    float dy = p.mPredY[i] - mCurrY[i];
+                    float dz = p.mPredZ[i] - mCurrZ[i];
+                    sum += (double)(dx*dx + dy*dy + dz*dz);
+                    if (omega != 1.0f){
+                        p.mPredX[i] = mPrevX[i] + omega*(p.mPredX[i] - mPrevX[i]);
+                        p.mPredY[i] = mPrevY[i] + omega*(p.mPredY[i] - mPrevY[i]);
+                        p.mPredZ[i] = mPrevZ[i] + omega*(p.mPredZ[i] - mPrevZ[i]);
+                    }
+                    mPrevX[i] = p.mPredX[i];
+                    mPrevY[i] = p.mPredY[i];
+                    mPrevZ[i] = p.mPredZ[i];
+                }
+                mResidualSum[chunk] = sum;
+            }
+        };
+        if (mPool && count >= kMinParallelBatch){
+            mPool->parallelFor(chunks, blend);
+        }else{
+            blend(0, chunks);
+        }
+        mPrevX.swap(mCurrX);
+        mPrevY.swap(mCurrY);
+        mPrevZ.swap(mCurrZ);
+
+        double sum = 0.0;
+        for (std::size_t chunk = 0; chunk < chunks; chunk++){
+            sum += mResidualSum[chunk];
+        }
+        float residual = (float)std::sqrt(sum);
+
+        if (mAccelerating){
+            if (residual > kDivergenceGrowth*mResidualStart){
+                mAccelerating = false;
+                mOmega = 1.0f;
+                mSpectralRadius *= kFallbackShrink;
+                mAccelerationFallbacks++;
+            }
+            mResidualLast = residual;
+            mAcceleratedIterations++;
+            return;
+        }
+
+        //while plain, the corrections shrink by about the spectral radius
+        //every iteration
+        if (iter == kAccelerationWarmup/2){
+            mResidualFirst = residual;
+        }else if (iter == kAccelerationWarmup && mResidualStart == 0.0f){
+            if (mRadiusSetting == 0.0f && mResidualFirst > 0.0f && residual > 0.0f){
+                float ratio = std::min(residual/mResidualFirst, 1.0f);
+                mWarmupRadius = std::pow(ratio, 1.0f/(kAccelerationWarmup - kAccelerationWarmup/2));
+                mWarmupRadius = std::min(mWarmupRadius, kMaxSpectralRadius);
+                if (mSpectralRadius == 0.0f){
+                    mSpectralRadius = mWarmupRadius;
+                }
+            }
+            mResidualStart = residual;
+            mResidualLast = residual;
+            mAcceleratedIterations = 0;
+            mAccelerating = mSpectralRadius > 0.0f && residual > 0.0f;
+        }
+    }
+
+    void Solver::finishAcceleration()
+    {
+        //an accelerated iterate can overshoot into a collider
+        if (mOmega != 1.0f){
+            collide();
+        }
+        if (mRadiusSetting != 0.0f || !mAccelerating ||
+            mAcceleratedIterations < kMinRateIterations || mResidualLast <= 0.0f)
+        {
+            return;
+        }
+
+        //the corrections shrank by rate per accelerated iteration. For a
+        //linear iteration with radius rho, weight omega gives rates with
+        //rate^2 - omega*rho*rate + omega - 1 = 0. That is solved for rho
+        //while the rate is real, i.e. slower than sqrt(omega - 1): the
+        //radius is too low. A rate at or below sqrt(omega - 1) means the
+        //radius is at least high enough, so it is pulled back towards
+        //this substep's warm-up estimate. Either way it settles where the
+        //observed rate matches the one predicted.
+        float rate = std::pow(std::min(mResidualLast/mResidualStart, 1.0f),
+            1.0f/mAcceleratedIterations);
+        float damping = mOmega - 1.0f;
+        float measured = mWarmupRadius;
+        if (rate*rate > damping)
+        {
+            measured = (rate*rate + damping)/(mOmega*rate);
+        }
+        measured = std::min(std::max(measured, 0.0f), kMaxSpectralRadius);
+        mSpectralRadius += kRadiusBlend*(measured - mSpectralRadius);
+    }
+
+    void Solver::projectConstraints()
+    {
+        //batches run one after the other (Gauss-Seidel across colours), the
+        //constraints inside a batch are independent and run in parallel.
+        //Bending is always solved this way, in Jacobi mode after the
+        //distance constraints.
+        if (mMode == SolverMode::Jacobi){
+            ScopedTimer timer(mProfiler, "jacobi");
+            projectJacobi();
+        }else{
+            //each family's batches are contiguous, so each gets one timer
+            std::vector<ConstraintBatch> const& batches = distanceBatches();
+            std::size_t k = 0;
+            while (k < batches.size()){
+                ConstraintType type = batches[k].type;
+                ScopedTimer timer(mProfiler, constraintTypeName(type));
+                for (; k < batches.size() && batches[k].type == type; k++){
+                    projectBatch(batches[k]);
+                }
+            }
+        }
+
+        ScopedTimer timer(mProfiler, constraintTypeName(ConstraintType::Bending));
+        for (auto const& batch : bendingBatches()){
+            projectBatch(batch);
+        }
+    }
+
+    void Solver::projectBatch(ConstraintBatch const& batch)
+    {
+        //batches where every particle is pinned cannot move anything
+        if (batch.pins == PinPattern::All){
+            return;
+        }
+
+        //the kernel is picked once per batch, the loop inside it is
+        //specialized for the batch's constraint type and pin pattern
+        using Projector = void (Solver::*)(std::size_t, std::size_t, float);
+        bool free = batch.pins == PinPattern::None;
+        Projector project = nullptr;
+        switch (batch.type){
+        case ConstraintType::Structural:
+            project = free ? &Solver::projectRange<ConstraintType::Structural, PinPattern::None>
+                : &Solver::projectRange<ConstraintType::Structural, PinPattern::Partial>;
+            break;
+        case ConstraintType::Shear:
+            project = free ? &Solver::projectRange<ConstraintType::Shear, PinPattern::None>
+                : &Solver::projectRange<ConstraintType::Shear, PinPattern::Partial>;
+            break;
+        case ConstraintType::Bending:
+            project = &Solver::projectRange<ConstraintType::Bending, PinPattern::Partial>;
+            break;
+        }
+
+        float alpha = mAlpha[(int)batch.type];
+        std::size_t count = batch.end - batch.begin;
+        if (mPool && batch.parallel && count >= kMinParallelBatch){
+            std::size_t first = batch.begin;
+            mPool->parallelFor(count, [this, project, first, alpha](std::size_t begin, std::size_t end)
+            {
+                (this->*project)(first + begin, first + end, alpha);
+            });
+        }else{
+            (this->*project)(batch.begin, batch.end, alpha);
+        }
+    }
+
+    template <ConstraintType Type, PinPattern Pins>
+    void Solver::projectRange(std::size_t begin, std::size_t end, float alpha)
+    {
+        //Type is a constant, so only one of the loops survives
+        if (Type == ConstraintType::Bending){
+            for (std::size_t k = begin; k < end; k++){
+                constrainBending(mBendings[k], mBendingLambda[k], alpha);
+            }
+        }else{
+            for (std::size_t k = begin; k < end; k++){
+                constrainDistance<Pins>(mConstraints[k], mLambda[k], alpha);
+            }
+        }
+    }
+
+    void Solver::projectJacobi()
+    {
+        ParticleSet& p = mParticles;
+        DistanceKernelArgs args{mConstraints.data(), p.mPredX.data(),
+            p.mPredY.data(), p.mPredZ.data(), p.mInvMass.data(),
+            mCorrX.data(), mCorrY.data(), mCorrZ.data()};
+
+        //corrections only read the predictions, so every constraint can be
+        //evaluated at once; ranges are split on whole kernel widths. With
+        //tiles asleep only the runs with a movable particle are evaluated,
+        //the others could only move sleeping or pinned particles.
+        std::size_t count = mConstraints.size();
+        if (mSleepingTiles > 0){
+            auto runs = [this, &args](std::size_t first, std::size_t last)
+            {
+                for (std::size_t r = first; r < last; r++){
+                    mKernel(args, mActiveBatches[r].begin, mActiveBatches[r].end);
+                }
+            };
+            if (mPool && mActiveCount >= kMinParallelBatch){
+                mPool->parallelFor(mActiveBatches.size(), runs);
+            }else{
+                runs(0, mActiveBatches.size());
+            }
+        }else if (mPool && count >= kMinParallelBatch){
+            std::size_t blocks = (count + kDistanceKernelWidth - 1)/kDistanceKernelWidth;
+            mPool->parallelFor(blocks, [this, &args, count](std::size_t begin, std::size_t end)
+            {
+                std::size_t last = end*kDistanceKernelWidth;
+                mKernel(args, begin*kDistanceKernelWidth, (last < count) ? last : count);
+            });
+        }else{
+            mKernel(args, 0, count);
+        }
+
+        //each particle then gathers its own corrections, so the apply pass
+        //has no write conflicts either
+        forEachAwakeRange([this](std::size_t begin, std::size_t end)
+        {
+            applyJacobiRange(begin, end);
+        });
+    }
+
+    void Solver::updateJacobiStiffness()
+    {
+        //the Jacobi kernels have no multipliers, so each constraint takes
+        //the first XPBD step instead, w / (w + alpha), as its stiffness
+        ParticleSet const& p = mParticles;
+        for (auto const& batch : distanceBatches()){
+            float alpha = mAlpha[(int)batch.type];
+            for (std::size_t k = batch.begin; k < batch.end; k++){
+                DistanceConstraint& c = mConstraints[k];
+                float wSum = p.mInvMass[c.i] + p.mInvMass[c.j];
+                c.stiffness = (wSum > 0.0f) ? wSum/(wSum + alpha) : 0.0f;
+            }
+        }
+    }
+
+    void Solver::applyJacobiRange(std::size_t begin, std::size_t end)
+    {
+        ParticleSet& p = mParticles;
+        for (std::size_t i = begin; i < end; i++){
+            float w = p.mInvMass[i]*mInvDegree[i]*mRelaxation;
+            if (w == 0.0f){
+                continue;
+            }
+
+            float dx = 0.0f;
+            float dy = 0.0f;
+            float dz = 0.0f;
+            for (int k = mAdjacencyOffsets[i]; k < mAdjacencyOffsets[i + 1]; k++){
+                int entry = mAdjacency[k];
+                int c = entry >> 1;
+                float sign = (entry & 1) ? -1.0f : 1.0f;
+                dx += sign*mCorrX[c];
+                dy += sign*mCorrY[c];
+                dz += sign*mCorrZ[c];
+            }
+
+            p.mPredX[i] += w*dx;
+            p.mPredY[i] += w*dy;
+            p.mPredZ[i] += w*dz;
+        }
+    }
+
+    void Solver::findSelfCollisions()
+    {
+        ScopedTimer timer(mProfiler, "self collision search");
+        ParticleSet& p = mParticles;
+        float radius = mThickness*kSelfCollisionMargin;
+        mHash.build(p.mPredX.data(), p.mPredY.data(), p.mPredZ.data(), p.size(),
+            radius, mPool.get());
+        mHash.findNeighbours(p.mPredX.data(), p.mPredY.data(), p.mPredZ.data(),
+            radius, mPool.get());
+
+        mSelfX.resize(p.size());
+        mSelfY.resize(p.size());
+        mSelfZ.resize(p.size());
+    }
+
+    void Solver::solveSelfCollisions()
+    {
+        ScopedTimer timer(mProfiler, "self collision");
+        //every particle computes its own share of each contact into the
+        //scratch arrays first and then everything is applied, so the
+        //result does not depend on the order particles are visited in.
+        //Sleeping particles are only ever pushed against.
+        forEachAwakeRange([this](std::size_t begin, std::size_t end)
+        {
+            selfCollisionRange(begin, end);
+        });
+
+        ParticleSet& p = mParticles;
+        for (auto const& range : mAwakeRanges){
+            for (std::size_t i = range.begin; i < range.end; i++){
+                p.mPredX[i] += mSelfX[i];
+                p.mPredY[i] += mSelfY[i];
+                p.mPredZ[i] += mSelfZ[i];
+            }
+        }
+    }
+
+    void Solver::selfCollisionRange(std::size_t begin, std::size_t end)
+    {
+        ParticleSet& p = mParticles;
+        auto const& offsets = mHash.neighbourOffsets();
+        auto const& neighbours = mHash.neighbours();
+        float thicknessSq = mThickness*mThickness;
+
+        for (std::size_t i = begin; i < end; i++){
+            float dx = 0.0f;
+            float dy = 0.0f;
+            float dz = 0.0f;
+            int contacts = 0;
+
+            float w1 = p.mInvMass[i];
+            for (int k = offsets[i]; w1 > 0.0f && k < offsets[i + 1]; k++){
+                int j = neighbours[k];
+                float ex = p.mPredX[i] - p.mPredX[j];
+                float ey = p.mPredY[i] - p.mPredY[j];
+                float ez = p.mPredZ[i] - p.mPredZ[j];
+                float distSq = ex*ex + ey*ey + ez*ez;
+                if (distSq >= thicknessSq || distSq == 0.0f ||
+                    restingClose(i, (std::size_t)j, thicknessSq)){
+                    continue;
+                }
+
+                float dist = std::sqrt(distSq);
+                float s = (w1/(w1 + p.mInvMass[j]))*(mThickness - dist)/dist;
+                dx += s*ex;
+                dy += s*ey;
+                dz += s*ez;
+                contacts++;
+            }
+
+            float scale = (contacts > 0) ? 1.0f/contacts : 0.0f;
+            mSelfX[i] = dx*scale;
+            mSelfY[i] = dy*scale;
+            mSelfZ[i] = dz*scale;
+        }
+    }
+
+    bool Solver::restingClose(std::size_t i, std::size_t j, float thicknessSq) const
+    {
+        float dx = mRestX[j] - mRestX[i];
+        float dy = mRestY[j] - mRestY[i];
+        float dz = mRestZ[j] - mRestZ[i];
+        return dx*dx + dy*dy + dz*dz < thicknessSq;
+    }
+
+    void Solver::collide()
+    {
+        //for each particle in mesh:
+          //update particle.posprediction based on collision constraints
+        ScopedTimer timer(mProfiler, "collision");
+        std::size_t maxChunks = mPool ? mPool->size() : 1;
+        reserveCandidates(maxChunks);
+
+        //sleeping particles rest against the colliders already
+        for (auto const& range : mAwakeRanges){
+            std::size_t offset = range.begin;
+            std::size_t count = range.end - range.begin;
+            std::size_t chunks = (mPool && count >= kMinParallelBatch) ? maxChunks : 1;
+            auto collideChunks = [this, chunks, count, offset](std::size_t first, std::size_t last)
+            {
+                for (std::size_t chunk = first; chunk < last; chunk++){
+                    mColliders.collide(mParticles, offset + (count*chunk)/chunks,
+                        offset + (count*(chunk + 1))/chunks, mCandidates[chunk]);
+                }
+            };
+
+            if (chunks > 1){
+                mPool->parallelFor(chunks, collideChunks);
+            }else{
+                collideChunks(0, 1);
+            }
+        }
+    }
+
+    template <typename Fn>
+    void Solver::forEachAwakeRange(Fn const& fn)
+    {
+        for (auto const& range : mAwakeRanges){
+            std::size_t first = range.begin;
+            std::size_t count = range.end - range.begin;
+            if (mPool && count >= kMinParallelBatch){
+                mPool->parallelFor(count, [&fn, first](std::size_t begin, std::size_t end)
+                {
+                    fn(first + begin, first + end);
+                });
+            }else{
+                fn(range.begin, range.end);
+            }
+        }
+    }
+
+    std::vector<ConstraintBatch> const& Solver::distanceBatches() const
+    {
+        return (mSleepingTiles > 0) ? mActiveBatches : mBatches;
+    }
+
+    std::vector<ConstraintBatch> const& Solver::bendingBatches() const
+    {
+        return (mSleepingTiles > 0) ? mActiveBendingBatches : mBendingBatches;
+    }
+
+    void Solver::buildSleepTiles()
+    {
+        //everything starts awake; the real inverse masses are taken from
+        //the freshly built (or loaded) particles
+        std::size_t count = mParticles.size();
+        std::size_t tiles = (count + kSleepTileSize - 1)/kSleepTileSize;
+        mAwakeInvMass = mParticles.mInvMass;
+        mSleepingTiles = 0;
+        mTileAsleep.assign(tiles, 0);
+        mTileBusy.assign(tiles, 0);
+        mTileQuiet.assign(tiles, 0);
+        mAwakeRanges.clear();
+        mAwakeRanges.reserve(tiles);
+        mAwakeRanges.push_back({0, count});
+        mActiveBatches.clear();
+        mActiveBendingBatches.clear();
+        mActiveCount = 0;
+        mTileLinks.clear();
+        if (!mSleepEnabled)
+        {
+            return;
+        }
+
+        for (auto const& c : mConstraints){
+            int a = c.i/(int)kSleepTileSize;
+            int b = c.j/(int)kSleepTileSize;
+            if (a != b){
+                mTileLinks.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+            }
+        }
+        for (auto const& c : mBendings){
+            for (int k = 1; k < 4; k++){
+                int a = c.p[0]/(int)kSleepTileSize;
+                int b = c.p[k]/(int)kSleepTileSize;
+                if (a != b){
+                    mTileLinks.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+                }
+            }
+        }
+        std::sort(mTileLinks.begin(), mTileLinks.end());
+        mTileLinks.erase(std::unique(mTileLinks.begin(), mTileLinks.end()),
+            mTileLinks.end());
+
+        //a batch of n constraints splits into at most (n + 1) / 2 runs
+        mActiveBatches.reserve(mConstraints.size()/2 + mBatches.size());
+        mActiveBendingBatches.reserve(mBendings.size()/2 + mBendingBatches.size());
+    }
+
+    void Solver::wake()
+    {
+        bool changed = mSleepingTiles > 0;
+        for (std::size_t t = 0; t < mTileAsleep.size(); t++){
+            if (mTileAsleep[t]){
+                setTileAsleep(t, false);
+            }
+            mTileQuiet[t] = 0;
+        }
+        if (changed)
+        {
+            buildActiveLists();
+        }
+    }
+
+    void Solver::setTileAsleep(std::size_t tile, bool asleep)
+    {
+        ParticleSet& p = mParticles;
+        std::size_t begin = tile*kSleepTileSize;
+        std::size_t end = std::min(begin + kSleepTileSize, p.size());
+        for (std::size_t i = begin; i < end; i++){
+            p.mInvMass[i] = asleep ? 0.0f : mAwakeInvMass[i];
+            p.mVelX[i] = 0.0f;
+            p.mVelY[i] = 0.0f;
+            p.mVelZ[i] = 0.0f;
+            p.mPredX[i] = p.mPosX[i];
+            p.mPredY[i] = p.mPosY[i];
+            p.mPredZ[i] = p.mPosZ[i];
+        }
+        mTileAsleep[tile] = asleep ? 1 : 0;
+        mTileQuiet[tile] = 0;
+        mSleepingTiles = asleep ? mSleepingTiles + 1 : mSleepingTiles - 1;
+    }
+
+    void Solver::buildActiveLists()
+    {
+        //consecutive awake tiles merge into one range
+        std::size_t count = mParticles.size();
+        mAwakeRanges.clear();
+        for (std::size_t t = 0; t < mTileAsleep.size(); t++){
+            if (mTileAsleep[t]){
+                continue;
+            }
+            std::size_t begin = t*kSleepTileSize;
+            std::size_t end = std::min(begin + kSleepTileSize, count);
+            if (!mAwakeRanges.empty() && mAwakeRanges.back().end == begin){
+                mAwakeRanges.back().end = end;
+            }else{
+                mAwakeRanges.push_back({begin, end});
+            }
+        }
+
+        mActiveBatches.clear();
+        mActiveBendingBatches.clear();
+        mActiveCount = 0;
+        if (mSleepingTiles == 0)
+        {
+            return;
+        }
+
+        //a constraint still needs projecting while any of its particles can
+        //move; asleep and pinned ones both have a zero inverse mass
+        float const* invMass = mParticles.mInvMass.data();
+        mActiveCount = appendActiveRuns(mConstraints, mBatches,
+            [invMass](DistanceConstraint const& c)
+            {
+                return invMass[c.i] > 0.0f || invMass[c.j] > 0.0f;
+            }, mActiveBatches);
+        appendActiveRuns(mBendings, mBendingBatches,
+            [invMass](BendingConstraint const& c)
+            {
+                return invMass[c.p[0]] > 0.0f || invMass[c.p[1]] > 0.0f ||
+                    invMass[c.p[2]] > 0.0f || invMass[c.p[3]] > 0.0f;
+            }, mActiveBendingBatches);
+    }
+
+    void Solver::updateSleep()
+    {
+        ScopedTimer timer(mProfiler, "sleep");
+        ParticleSet& p = mParticles;
+        std::size_t count = p.size();
+        std::size_t tiles = mTileAsleep.size();
+
+        //an awake tile is busy while its kinetic energy per unit mass,
+        //sum(m v^2) / 2 sum(m), is above speed^2 / 2
+        float speedSq = mSleepSpeed*mSleepSpeed;
+        for (std::size_t t = 0; t < tiles; t++){
+            mTileBusy[t] = 0;
+            if (mTileAsleep[t]){
+                continue;
+            }
+            std::size_t begin = t*kSleepTileSize;
+            std::size_t end = std::min(begin + kSleepTileSize, count);
+            double energy = 0.0;
+            double mass = 0.0;
+            for (std::size_t i = begin; i < end; i++){
+                if (mAwakeInvMass[i] > 0.0f){
+                    float m = 1.0f/mAwakeInvMass[i];
+                    energy += m*(p.mVelX[i]*p.mVelX[i] + p.mVelY[i]*p.mVelY[i] +
+                        p.mVelZ[i]*p.mVelZ[i]);
+                    mass += m;
+                }
+            }
+            mTileBusy[t] = energy > speedSq*mass;
+        }
+
+        //so is every tile touching an overstretched constraint. Sleeping
+        //particles hold still, so a neighbour pulling away from a sleeping
+        //tile shows up here too and wakes it.
+        for (auto const& batch : distanceBatches()){
+            if (batch.pins == PinPattern::All){
+                continue;
+            }
+            for (std::size_t k = batch.begin; k < batch.end; k++){
+                auto const& c = mConstraints[k];
+                float dx = p.mPosX[c.j] - p.mPosX[c.i];
+                float dy = p.mPosY[c.j] - p.mPosY[c.i];
+                float dz = p.mPosZ[c.j] - p.mPosZ[c.i];
+                float stretch = std::fabs(std::sqrt(dx*dx + dy*dy + dz*dz) - c.restLength)/c.restLength;
+                if (stretch > mSleepError){
+                    mTileBusy[c.i/kSleepTileSize] = 1;
+                    mTileBusy[c.j/kSleepTileSize] = 1;
+                }
+            }
+        }
+
+        //moving particles wake the sleeping ones they touch, using the
+        //neighbour lists of the last substep
+        if (mSelfCollision && mSleepingTiles > 0){
+            auto const& offsets = mHash.neighbourOffsets();
+            auto const& neighbours = mHash.neighbours();
+            float thicknessSq = mThickness*mThickness;
+            for (auto const& range : mAwakeRanges){
+                for (std::size_t i = range.begin; i < range.end; i++){
+                    if (!mTileBusy[i/kSleepTileSize]){
+                        continue;
+                    }
+                    for (int k = offsets[i]; k < offsets[i + 1]; k++){
+                        std::size_t j = (std::size_t)neighbours[k];
+                        float dx = p.mPosX[i] - p.mPosX[j];
+                        float dy = p.mPosY[i] - p.mPosY[j];
+                        float dz = p.mPosZ[i] - p.mPosZ[j];
+                        if (mTileAsleep[j/kSleepTileSize] &&
+                            dx*dx + dy*dy + dz*dz < thicknessSq &&
+                            !restingClose(i, j, thicknessSq)){
+                            mTileBusy[j/kSleepTileSize] = 1;
+                        }
+                    }
+                }
+            }
+        }
+
+        //and a busy awake tile wakes its sleeping neighbours; woken tiles
+        //only pass this on from the next step
+        for (auto const& link : mTileLinks){
+            int a = link.first;
+            int b = link.second;
+            if (mTileAsleep[a] && !mTileAsleep[b] && mTileBusy[b]){
+                mTileBusy[a] = 1;
+            }else if (mTileAsleep[b] && !mTileAsleep[a] && mTileBusy[a]){
+                mTileBusy[b] = 1;
+            }
+        }
+
+        bool changed = false;
+        for (std::size_t t = 0; t < tiles; t++){
+            if (mTileAsleep[t]){
+                if (mTileBusy[t]){
+                    setTileAsleep(t, false);
+                    changed = true;
+                }
+            }else if (mTileBusy[t]){
+                mTileQuiet[t] = 0;
+            }else if (++mTileQuiet[t] >= mSleepSteps){
+                setTileAsleep(t, true);
+                changed = true;
+            }
+        }
+        if (changed){
+            buildActiveLists();
+        }
+    }
+
+    template <PinPattern Pins>
+    void Solver::constrainDistance(DistanceConstraint const& c, float& lambda,
+        float alpha)
+    {
+        int p1 = c.i;
+        int p2 = c.j;
+        //corrections are split by inverse mass. Partial constraints store
+        //the pinned end as i (see splitByPins), so for them w1 is known to
+        //be 0 and only j is written.
+        ParticleSet& p = mParticles;
+        float w1 = (Pins == PinPattern::None) ? p.mInvMass[p1] : 0.0f;
+        float w2 = p.mInvMass[p2];
+        float wSum = w1 + w2;
+
+        float dx = p.mPredX[p2] - p.mPredX[p1];
+        float dy = p.mPredY[p2] - p.mPredY[p1];
+        float dz = p.mPredZ[p2] - p.mPredZ[p1];
+        float distance = std::sqrt(dx*dx + dy*dy + dz*dz);
+        //coincident particles have no direction to push along; this is a
+        //select rather than a branch
+        float valid = (distance > 0.0f) ? 1.0f : 0.0f;
+        float invDistance = valid/(distance + (1.0f - valid));
+
+        //XPBD update of the multiplier; with alpha = 0 this is the plain
+        //PBD projection
+        float C = distance - c.restLength;
+        float dLambda = valid*(-C - alpha*lambda)/(wSum + alpha);
+        lambda += dLambda;
+        float s = -dLambda*invDistance;
+
+        if (Pins == PinPattern::None){
+            p.mPredX[p1] += w1*s*dx;
+            p.mPredY[p1] += w1*s*dy;
+            p.mPredZ[p1] += w1*s*dz;
+        }
+        p.mPredX[p2] -= w2*s*dx;
+        p.mPredY[p2] -= w2*s*dy;
+        p.mPredZ[p2] -= w2*s*dz;
+    }
+
+    void Solver::constrainBending(BendingConstraint const& c, float& lambda,
+        float alpha)
+    {
+        ParticleSet& p = mParticles;
+        //relative to the first particle, which leaves C and its gradient
+        //unchanged (the rows of q sum to zero) but keeps them accurate far
+        //from the origin
+        float x[4], y[4], z[4], w[4];
+        for (int k = 0; k < 4; k++){
+            x[k] = p.mPredX[c.p[k]] - p.mPredX[c.p[0]];
+            y[k] = p.mPredY[c.p[k]] - p.mPredY[c.p[0]];
+            z[k] = p.mPredZ[c.p[k]] - p.mPredZ[c.p[0]];
+            w[k] = p.mInvMass[c.p[k]];
+        }
+
+        //gradient of C with respect to particle k is sum_j q_kj x_j
+        float gx[4], gy[4], gz[4];
+        float energy = 0.0f;
+        float gradSum = 0.0f;
+        for (int k = 0; k < 4; k++){
+            gx[k] = gy[k] = gz[k] = 0.0f;
+            for (int j = 0; j < 4; j++){
+                gx[k] += c.q[k][j]*x[j];
+                gy[k] += c.q[k][j]*y[j];
+                gz[k] += c.q[k][j]*z[j];
+            }
+            energy += x[k]*gx[k] + y[k]*gy[k] + z[k]*gz[k];
+            gradSum += w[k]*(gx[k]*gx[k] + gy[k]*gy[k] + gz[k]*gz[k]);
+        }
+        if (gradSum < 1e-12f){
+            return;
+        }
+
+        float C = 0.5f*energy - c.rest;
+        float dLambda = (-C - alpha*lambda)/(gradSum + alpha);
+        lambda += dLambda;
+
+        for (int k = 0; k < 4; k++){
+            float s = w[k]*dLambda;
+            p.mPredX[c.p[k]] += s*gx[k];
+            p.mPredY[c.p[k]] += s*gy[k];
+            p.mPredZ[c.p[k]] += s*gz[k];
+        }
+    }
+}
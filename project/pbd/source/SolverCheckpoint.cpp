@@ -0,0 +1,456 @@
+#include "Solver.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+namespace pbd
+{
+    namespace
+    {
+        const char kMagic[8] = {'P', 'B', 'D', 'S', 'T', 'A', 'T', 'E'};
+        const std::uint32_t kVersion = 6;
+
+        //sequential binary output; the first failed write sticks so the
+        //caller only checks once at the end
+        class CheckpointWriter
+        {
+        public:
+            explicit CheckpointWriter(std::FILE* file) :
+                mFile(file)
+            {}
+
+            template <typename T>
+            void pod(T const& value)
+            {
+                static_assert(std::is_trivially_copyable<T>::value, "checkpoint values must be trivially copyable");
+                mOk = mOk && std::fwrite(&value, sizeof(T), 1, mFile) == 1;
+            }
+
+            //element count followed by the raw elements
+            template <typename Array>
+            void array(Array const& values)
+            {
+                using T = typename Array::value_type;
+                static_assert(std::is_trivially_copyable<T>::value, "checkpoint values must be trivially copyable");
+                pod((std::uint64_t)values.size());
+                mOk = mOk && (values.empty() ||
+                    std::fwrite(values.data(), sizeof(T), values.size(), mFile) == values.size());
+            }
+
+            //field by field, so the struct padding does not end up in the
+            //file and equal states give byte-identical checkpoints
+            void batches(std::vector<ConstraintBatch> const& values)
+            {
+                pod((std::uint64_t)values.size());
+                for (auto const& b : values){
+                    pod((std::uint64_t)b.begin);
+                    pod((std::uint64_t)b.end);
+                    pod((std::uint8_t)b.parallel);
+                    pod((std::uint8_t)b.type);
+                    pod((std::uint8_t)b.pins);
+                }
+            }
+
+            bool ok() const
+            {
+                return mOk;
+            }
+
+        private:
+            std::FILE* mFile;
+            bool mOk = true;
+        };
+
+        //reads what CheckpointWriter wrote. Array counts are checked against
+        //the bytes left in the file before anything is allocated, so a
+        //truncated or corrupt file fails instead of asking for gigabytes.
+        class CheckpointReader
+        {
+        public:
+            CheckpointReader(std::FILE* file, std::uint64_t size) :
+                mFile(file),
+                mRemaining(size)
+            {}
+
+            template <typename T>
+            void pod(T& value)
+            {
+                static_assert(std::is_trivially_copyable<T>::value, "checkpoint values must be trivially copyable");
+                mOk = mOk && take(sizeof(T)) && std::fread(&value, sizeof(T), 1, mFile) == 1;
+            }
+
+            template <typename Array>
+            void array(Array& values)
+            {
+                using T = typename Array::value_type;
+                static_assert(std::is_trivially_copyable<T>::value, "checkpoint values must be trivially copyable");
+                std::uint64_t count = 0;
+                pod(count);
+                mOk = mOk && count <= mRemaining/sizeof(T) && take(count*sizeof(T));
+                if (!mOk)
+                {
+                    return;
+                }
+                values.resize((std::size_t)count);
+                mOk = values.empty() ||
+                    std::fread(values.data(), sizeof(T), values.size(), mFile) == values.size();
+            }
+
+            void batches(std::vector<ConstraintBatch>& values)
+            {
+                //17 bytes per batch in the file
+                std::uint64_t count = 0;
+                pod(count);
+                mOk = mOk && count <= mRemaining/17;
+                if (!mOk)
+                {
+                    return;
+                }
+                values.resize((std::size_t)count);
+                for (auto& b : values){
+                    std::uint64_t begin = 0, end = 0;
+                    std::uint8_t parallel = 0, type = 0, pins = 0;
+                    pod(begin);
+                    pod(end);
+                    pod(parallel);
+                    pod(type);
+                    pod(pins);
+                    b.begin = (std::size_t)begin;
+                    b.end = (std::size_t)end;
+                    b.parallel = parallel != 0;
+                    b.type = (ConstraintType)type;
+                    b.pins = (PinPattern)pins;
+                }
+            }
+
+            bool ok() const
+            {
+                return mOk;
+            }
+
+        private:
+            bool take(std::uint64_t bytes)
+            {
+                if (bytes > mRemaining)
+                {
+                    return false;
+                }
+                mRemaining -= bytes;
+                return true;
+            }
+
+            std::FILE* mFile;
+            std::uint64_t mRemaining;
+            bool mOk = true;
+        };
+
+        bool validIndex(int index, std::size_t count)
+        {
+            return index >= 0 && (std::size_t)index < count;
+        }
+
+        bool validBatches(std::vector<ConstraintBatch> const& batches,
+            std::size_t count)
+        {
+            for (auto const& b : batches){
+                if (b.begin > b.end || b.end > count ||
+                    (int)b.type >= kConstraintTypeCount || (int)b.pins > (int)PinPattern::All)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    bool Solver::saveCheckpoint(std::string const& path) const
+    {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+
+        CheckpointWriter out(file);
+        out.pod(kMagic);
+        out.pod(kVersion);
+
+        //grid and settings
+        out.pod(mWidth);
+        out.pod(mLength);
+        out.pod(mHeight);
+        out.pod(mMass);
+        out.pod(mG);
+        out.pod(mDamping);
+        out.pod(mRest);
+        out.pod((std::int32_t)mMode);
+        out.pod(mRelaxation);
+        out.pod((std::uint8_t)mSelfCollision);
+        out.pod(mThicknessSetting);
+        out.pod((std::int32_t)mSubsteps);
+        out.pod((std::int32_t)mMaxIterations);
+        out.pod(mTolerance);
+        out.pod((std::int32_t)mNorm);
+        out.pod((std::int32_t)mLevels);
+        out.pod((std::int32_t)mCoarseIterations);
+        out.pod((std::int32_t)mAcceleration);
+        out.pod(mRadiusSetting);
+        out.pod(mSpectralRadius);
+        for (int t = 0; t < kConstraintTypeCount; t++){
+            out.pod(mCompliance[t]);
+            out.pod((std::uint8_t)mEnabled[t]);
+        }
+
+        //particle state, including the inverse masses that pin particles.
+        //Sleeping particles have theirs zeroed, the real ones are stored.
+        mParticles.forEachArray([this, &out](FloatArray const& values){
+            bool asleep = &values == &mParticles.mInvMass && mSleepingTiles > 0;
+            out.array(asleep ? mAwakeInvMass : values);
+        });
+        out.array(mTriangles);
+        out.array(mRestX);
+        out.array(mRestY);
+        out.array(mRestZ);
+
+        //what reset() builds from
+        out.array(mPins);
+        out.array(mMeshVertices);
+        out.array(mMeshTriangles);
+        out.pod((std::int32_t)mOrder);
+        out.array(mInputIndex);
+
+        //constraints and their batches as built, so restoring skips the
+        //colouring
+        out.array(mConstraints);
+        out.pod((std::uint64_t)mStructuralCount);
+        out.batches(mBatches);
+        out.array(mBendings);
+        out.batches(mBendingBatches);
+
+        //colliders; meshes are stored as triangle soups and get their BVH
+        //rebuilt on restore
+        out.array(mColliders.spheres());
+        out.array(mColliders.capsules());
+        out.array(mColliders.boxes());
+        out.array(mColliders.planes());
+        out.pod((std::uint64_t)mColliders.meshes().size());
+        for (auto const& mesh : mColliders.meshes()){
+            out.array(mesh.vertices());
+            out.array(mesh.indices());
+            out.pod(mesh.thickness());
+        }
+
+        bool ok = out.ok();
+        ok = (std::fclose(file) == 0) && ok;
+        return ok;
+    }
+
+    bool Solver::loadCheckpoint(std::string const& path)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        CheckpointReader in(file, (size > 0) ? (std::uint64_t)size : 0);
+
+        char magic[8] = {};
+        std::uint32_t version = 0;
+        in.pod(magic);
+        in.pod(version);
+        if (!in.ok() || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+            version != kVersion)
+        {
+            std::fclose(file);
+            return false;
+        }
+
+        //everything is read into locals and only moved into the solver once
+        //the whole file has checked out, so a failed load changes nothing
+        float width, length, height, mass, g, damping, rest, relaxation, thickness, tolerance;
+        float radiusSetting, spectralRadius;
+        std::int32_t mode, substeps, maxIterations, norm, levels, coarseIterations, acceleration;
+        std::uint8_t selfCollision;
+        float compliance[kConstraintTypeCount];
+        std::uint8_t enabled[kConstraintTypeCount];
+        in.pod(width);
+        in.pod(length);
+        in.pod(height);
+        in.pod(mass);
+        in.pod(g);
+        in.pod(damping);
+        in.pod(rest);
+        in.pod(mode);
+        in.pod(relaxation);
+        in.pod(selfCollision);
+        in.pod(thickness);
+        in.pod(substeps);
+        in.pod(maxIterations);
+        in.pod(tolerance);
+        in.pod(norm);
+        in.pod(levels);
+        in.pod(coarseIterations);
+        in.pod(acceleration);
+        in.pod(radiusSetting);
+        in.pod(spectralRadius);
+        for (int t = 0; t < kConstraintTypeCount; t++){
+            in.pod(compliance[t]);
+            in.pod(enabled[t]);
+        }
+
+        ParticleSet particles;
+        particles.forEachArray([&in](FloatArray& values){
+            in.array(values);
+        });
+        std::vector<unsigned int> triangles;
+        FloatArray restX, restY, restZ;
+        in.array(triangles);
+        in.array(restX);
+        in.array(restY);
+        in.array(restZ);
+
+        std::vector<int> pins;
+        std::vector<Vector3> meshVertices;
+        std::vector<unsigned int> meshTriangles;
+        std::int32_t order = 0;
+        std::vector<int> inputIndex;
+        in.array(pins);
+        in.array(meshVertices);
+        in.array(meshTriangles);
+        in.pod(order);
+        in.array(inputIndex);
+
+        ConstraintList constraints;
+        std::uint64_t structuralCount = 0;
+        std::vector<ConstraintBatch> batches;
+        BendingList bendings;
+        std::vector<ConstraintBatch> bendingBatches;
+        in.array(constraints);
+        in.pod(structuralCount);
+        in.batches(batches);
+        in.array(bendings);
+        in.batches(bendingBatches);
+
+        ColliderSet colliders;
+        in.array(colliders.spheres());
+        in.array(colliders.capsules());
+        in.array(colliders.boxes());
+        in.array(colliders.planes());
+        std::uint64_t meshCount = 0;
+        in.pod(meshCount);
+        for (std::uint64_t m = 0; in.ok() && m < meshCount; m++){
+            std::vector<Vector3> vertices;
+            std::vector<unsigned int> indices;
+            float meshThickness = 0.0f;
+            in.array(vertices);
+            in.array(indices);
+            in.pod(meshThickness);
+            bool valid = in.ok() && indices.size() % 3 == 0;
+            for (std::size_t k = 0; valid && k < indices.size(); k++){
+                valid = indices[k] < vertices.size();
+            }
+            if (!valid)
+            {
+                std::fclose(file);
+                return false;
+            }
+            colliders.addMesh(MeshCollider(std::move(vertices),
+                std::move(indices), meshThickness));
+        }
+
+        bool ok = in.ok();
+        std::fclose(file);
+
+        //the solver indexes with these without further checks
+        std::size_t count = particles.size();
+        particles.forEachArray([&ok, count](FloatArray const& values){
+            ok = ok && values.size() == count;
+        });
+        ok = ok && count > 0 && mode >= 0 && mode <= (int)SolverMode::Jacobi &&
+            norm >= 0 && norm <= (int)ErrorNorm::Rms &&
+            acceleration >= 0 && acceleration <= (int)Acceleration::Momentum &&
+            structuralCount <= constraints.size() && triangles.size() % 3 == 0 &&
+            restX.size() == count && restY.size() == count && restZ.size() == count &&
+            order >= 0 && order <= (int)ParticleOrder::Rcm && inputIndex.size() == count;
+        for (std::size_t k = 0; ok && k < inputIndex.size(); k++){
+            ok = validIndex(inputIndex[k], count);
+        }
+        for (std::size_t k = 0; ok && k < triangles.size(); k++){
+            ok = triangles[k] < count;
+        }
+        for (std::size_t k = 0; ok && k < constraints.size(); k++){
+            ok = validIndex(constraints[k].i, count) && validIndex(constraints[k].j, count);
+        }
+        for (std::size_t k = 0; ok && k < bendings.size(); k++){
+            for (int v = 0; v < 4; v++){
+                ok = ok && validIndex(bendings[k].p[v], count);
+            }
+        }
+        ok = ok && validBatches(batches, constraints.size()) &&
+            validBatches(bendingBatches, bendings.size());
+        if (!ok)
+        {
+            return false;
+        }
+
+        mWidth = width;
+        mLength = length;
+        mHeight = height;
+        mMass = mass;
+        mG = g;
+        mDamping = (damping > 0.0f) ? damping : 0.0f;
+        mRest = rest;
+        mMode = (SolverMode)mode;
+        mRelaxation = relaxation;
+        mSelfCollision = selfCollision != 0;
+        mThicknessSetting = thickness;
+        mSubsteps = (substeps > 0) ? substeps : 1;
+        mMaxIterations = (maxIterations > 0) ? maxIterations : 1;
+        mTolerance = tolerance;
+        mNorm = (ErrorNorm)norm;
+        mLevels = (levels > 1) ? levels : 1;
+        mCoarseIterations = (coarseIterations > 0) ? coarseIterations : 1;
+        mAcceleration = (Acceleration)acceleration;
+        mRadiusSetting = radiusSetting;
+        mSpectralRadius = spectralRadius;
+        for (int t = 0; t < kConstraintTypeCount; t++){
+            mCompliance[t] = compliance[t];
+            mEnabled[t] = enabled[t] != 0;
+        }
+
+        mParticles = std::move(particles);
+        mTriangles.swap(triangles);
+        mRestX.swap(restX);
+        mRestY.swap(restY);
+        mRestZ.swap(restZ);
+        mPins.swap(pins);
+        mMeshVertices.swap(meshVertices);
+        mMeshTriangles.swap(meshTriangles);
+        mOrder = (ParticleOrder)order;
+        mInputIndex.swap(inputIndex);
+        mConstraints.swap(constraints);
+        mStructuralCount = (std::size_t)structuralCount;
+        mBatches.swap(batches);
+        mBendings.swap(bendings);
+        mBendingBatches.swap(bendingBatches);
+        mColliders = std::move(colliders);
+        mShapeChanged = true;
+
+        //derived state is cheap to rebuild and not worth storing
+        mLambda.assign(mConstraints.size(), 0.0f);
+        mBendingLambda.assign(mBendings.size(), 0.0f);
+        buildJacobiAdjacency();
+        buildHierarchy();
+        reserveScratch();
+        buildSleepTiles();
+        settleStorage();
+        mStats = {0, 0, 0.0f, 0.0f, 0};
+        return true;
+    }
+}
@@ -0,0 +1,220 @@
+#include "SpatialHash.hpp"
+
+#include <cmath>
+#include <cstdint>
+
+namespace pbd
+{
+    namespace
+    {
+        template <typename Fn>
+        void forEachRange(ThreadPool* pool, std::size_t count, Fn const& fn)
+        {
+            if (pool)
+            {
+                pool->parallelFor(count, fn);
+            }
+            else
+            {
+                fn(0, count);
+            }
+        }
+
+        //power of two with at least two buckets per particle
+        std::size_t tableSizeFor(std::size_t count)
+        {
+            std::size_t tableSize = 1;
+            while (tableSize < 2 * count)
+            {
+                tableSize <<= 1;
+            }
+            return tableSize;
+        }
+    }
+
+    void SpatialHash::reserve(std::size_t count, std::size_t neighbours,
+        std::size_t chunks)
+    {
+        std::size_t tableSize = tableSizeFor(count);
+        mBucketStart.reserve(tableSize + 1);
+        mChunkCounts.reserve(chunks * tableSize);
+        mCellX.reserve(count);
+        mCellY.reserve(count);
+        mCellZ.reserve(count);
+        mBucket.reserve(count);
+        mSorted.reserve(count);
+        mNeighbourOffsets.reserve(count + 1);
+        mNeighbours.reserve(neighbours);
+    }
+
+    void SpatialHash::build(float const* x, float const* y, float const* z,
+        std::size_t count, float cellSize, ThreadPool* pool)
+    {
+        mInvCellSize = 1.0f / cellSize;
+        mCount = count;
+        mChunks = pool ? pool->size() : 1;
+
+        std::size_t tableSize = tableSizeFor(count);
+        mTableMask = tableSize - 1;
+
+        mCellX.resize(count);
+        mCellY.resize(count);
+        mCellZ.resize(count);
+        mBucket.resize(count);
+        mSorted.resize(count);
+        mBucketStart.assign(tableSize + 1, 0);
+        mChunkCounts.assign(mChunks * tableSize, 0);
+
+        //bucket of every particle
+        forEachRange(pool, count, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                mCellX[i] = (int)std::floor(x[i] * mInvCellSize);
+                mCellY[i] = (int)std::floor(y[i] * mInvCellSize);
+                mCellZ[i] = (int)std::floor(z[i] * mInvCellSize);
+                mBucket[i] = (int)bucket(mCellX[i], mCellY[i], mCellZ[i]);
+            }
+        });
+
+        //counting sort: every chunk histograms its own particles, the
+        //histograms are turned into per-chunk write offsets and each chunk
+        //then scatters its particles, which keeps the sort stable
+        std::size_t chunks = mChunks;
+        auto chunkBegin = [count, chunks](std::size_t c)
+        {
+            return (count * c) / chunks;
+        };
+
+        forEachRange(pool, chunks, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t c = begin; c < end; ++c)
+            {
+                int* counts = mChunkCounts.data() + c * tableSize;
+                for (std::size_t i = chunkBegin(c); i < chunkBegin(c + 1); ++i)
+                {
+                    counts[mBucket[i]]++;
+                }
+            }
+        });
+
+        int offset = 0;
+        for (std::size_t b = 0; b < tableSize; ++b)
+        {
+            mBucketStart[b] = offset;
+            for (std::size_t c = 0; c < chunks; ++c)
+            {
+                int n = mChunkCounts[c * tableSize + b];
+                mChunkCounts[c * tableSize + b] = offset;
+                offset += n;
+            }
+        }
+        mBucketStart[tableSize] = offset;
+
+        forEachRange(pool, chunks, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t c = begin; c < end; ++c)
+            {
+                int* cursor = mChunkCounts.data() + c * tableSize;
+                for (std::size_t i = chunkBegin(c); i < chunkBegin(c + 1); ++i)
+                {
+                    mSorted[cursor[mBucket[i]]++] = (int)i;
+                }
+            }
+        });
+    }
+
+    void SpatialHash::findNeighbours(float const* x, float const* y,
+        float const* z, float radius, ThreadPool* pool)
+    {
+        float radiusSq = radius * radius;
+        mNeighbourOffsets.assign(mCount + 1, 0);
+
+        //two passes over the grid, the first sizes every list so that the
+        //second can write them in place from any thread
+        forEachRange(pool, mCount, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                mNeighbourOffsets[i + 1] =
+                    countNeighbours(i, x, y, z, radiusSq, nullptr);
+            }
+        });
+
+        for (std::size_t i = 0; i < mCount; ++i)
+        {
+            mNeighbourOffsets[i + 1] += mNeighbourOffsets[i];
+        }
+        mNeighbours.resize(mNeighbourOffsets[mCount]);
+
+        forEachRange(pool, mCount, [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; ++i)
+            {
+                countNeighbours(i, x, y, z, radiusSq,
+                    mNeighbours.data() + mNeighbourOffsets[i]);
+            }
+        });
+    }
+
+    IntArray const& SpatialHash::neighbourOffsets() const
+    {
+        return mNeighbourOffsets;
+    }
+
+    IntArray const& SpatialHash::neighbours() const
+    {
+        return mNeighbours;
+    }
+
+    std::size_t SpatialHash::bucket(int cx, int cy, int cz) const
+    {
+        //Teschner et al. 2003
+        std::uint32_t h = ((std::uint32_t)cx * 73856093u) ^
+            ((std::uint32_t)cy * 19349663u) ^ ((std::uint32_t)cz * 83492791u);
+        return h & mTableMask;
+    }
+
+    int SpatialHash::countNeighbours(std::size_t i, float const* x,
+        float const* y, float const* z, float radiusSq, int* out) const
+    {
+        int found = 0;
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dz = -1; dz <= 1; ++dz)
+                {
+                    int cx = mCellX[i] + dx;
+                    int cy = mCellY[i] + dy;
+                    int cz = mCellZ[i] + dz;
+                    std::size_t b = bucket(cx, cy, cz);
+                    for (int k = mBucketStart[b]; k < mBucketStart[b + 1]; ++k)
+                    {
+                        int j = mSorted[k];
+                        //buckets are shared by colliding cells; checking the
+                        //cell also stops a bucket being visited twice
+                        if (j == (int)i || mCellX[j] != cx || mCellY[j] != cy ||
+                            mCellZ[j] != cz)
+                        {
+                            continue;
+                        }
+
+                        float ex = x[j] - x[i];
+                        float ey = y[j] - y[i];
+                        float ez = z[j] - z[i];
+                        if (ex*ex + ey*ey + ez*ez < radiusSq)
+                        {
+                            if (out)
+                            {
+                                out[found] = j;
+                            }
+                            found++;
+                        }
+                    }
+                }
+            }
+        }
+        return found;
+    }
+}
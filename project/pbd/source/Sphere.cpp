@@ -114,6 +114,11 @@ namespace pbd
         mPosition = pos;
     }
 
+    void Sphere::setRadius(float radius)
+    {
+        mRadius = radius;
+    }
+
     void Sphere::renderGeometry(atlas::math::Matrix4 const& projection,
         atlas::math::Matrix4 const& view)
     {
@@ -131,7 +136,9 @@ namespace pbd
         mVao.bindVertexArray();
         mIndexBuffer.bindBuffer();
 
+        //sphere.obj has radius 2
         auto mModels = glm::translate(mModel, mPosition);
+        mModels = glm::scale(mModels, glm::vec3(mRadius/2.0f));
         glUniformMatrix4fv(mUniforms["model"], 1, GL_FALSE, &mModels[0][0]);
         glUniformMatrix4fv(mUniforms["projection"], 1, GL_FALSE,
             &projection[0][0]);
@@ -0,0 +1,94 @@
+#include "SurfaceMesh.hpp"
+
+namespace pbd
+{
+    void SurfaceMesh::build(std::vector<unsigned int> const& triangles,
+        std::size_t vertexCount)
+    {
+        mTriangles = triangles;
+        std::size_t triangleCount = mTriangles.size() / 3;
+
+        mOffsets.assign(vertexCount + 1, 0);
+        for (std::size_t k = 0; k < 3*triangleCount; k++){
+            mOffsets[mTriangles[k] + 1]++;
+        }
+        for (std::size_t i = 0; i < vertexCount; i++){
+            mOffsets[i + 1] += mOffsets[i];
+        }
+
+        std::vector<int> fill(mOffsets.begin(), mOffsets.end() - 1);
+        mAdjacency.resize(mOffsets[vertexCount]);
+        for (std::size_t t = 0; t < triangleCount; t++){
+            for (int k = 0; k < 3; k++){
+                mAdjacency[fill[mTriangles[3*t + k]]++] = (int)t;
+            }
+        }
+    }
+
+    FramePair interpolation(ParticleSet const& particles, float alpha)
+    {
+        return {particles.mPrevX.data(), particles.mPrevY.data(),
+            particles.mPrevZ.data(), particles.mPosX.data(),
+            particles.mPosY.data(), particles.mPosZ.data(), alpha};
+    }
+
+    void SurfaceMesh::write(ParticleSet const& particles, float alpha,
+        float* positions, float* normals, ThreadPool* pool) const
+    {
+        write(interpolation(particles, alpha), positions, normals, pool);
+    }
+
+    void SurfaceMesh::write(FramePair const& frames, float* positions,
+        float* normals, ThreadPool* pool) const
+    {
+        std::size_t count = vertexCount();
+        if (pool)
+        {
+            pool->parallelFor(count, [&](std::size_t begin, std::size_t end)
+            {
+                writeRange(frames, positions, normals, begin, end);
+            });
+        }
+        else
+        {
+            writeRange(frames, positions, normals, 0, count);
+        }
+    }
+
+    void SurfaceMesh::writeRange(FramePair const& frames, float* positions,
+        float* normals, std::size_t begin, std::size_t end) const
+    {
+        for (std::size_t i = begin; i < end; i++){
+            Vector3 p = frames.at(i);
+            positions[3*i] = p.x;
+            positions[3*i + 1] = p.y;
+            positions[3*i + 2] = p.z;
+
+            //the unnormalised face normal is twice the triangle area, so
+            //summing it weights each face by its area
+            Vector3 n;
+            for (int k = mOffsets[i]; k < mOffsets[i + 1]; k++){
+                unsigned int const* t = &mTriangles[3*mAdjacency[k]];
+                Vector3 a = frames.at(t[0]);
+                Vector3 b = frames.at(t[1]);
+                Vector3 c = frames.at(t[2]);
+                n += cross(b - a, c - a);
+            }
+            float m = mag(n);
+            n = m > 0.0f ? n/m : Vector3(0.0f, 1.0f, 0.0f);
+            normals[3*i] = n.x;
+            normals[3*i + 1] = n.y;
+            normals[3*i + 2] = n.z;
+        }
+    }
+
+    std::size_t SurfaceMesh::vertexCount() const
+    {
+        return mOffsets.empty() ? 0 : mOffsets.size() - 1;
+    }
+
+    std::vector<unsigned int> const& SurfaceMesh::triangles() const
+    {
+        return mTriangles;
+    }
+}
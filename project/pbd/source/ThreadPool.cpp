@@ -0,0 +1,246 @@
+#include "ThreadPool.hpp"
+
+namespace pbd
+{
+    namespace
+    {
+        //yields before a worker goes to sleep on the condition variable; the
+        //solver issues parallelFor calls back to back, so most wake ups are
+        //caught while still spinning
+        const int kSpinCount = 1024;
+
+        std::uint64_t packRange(std::uint64_t begin, std::uint64_t end)
+        {
+            return (begin << 32) | end;
+        }
+
+        std::uint64_t rangeBegin(std::uint64_t range)
+        {
+            return range >> 32;
+        }
+
+        std::uint64_t rangeEnd(std::uint64_t range)
+        {
+            return range & 0xffffffffu;
+        }
+    }
+
+    ThreadPool::ThreadPool(std::size_t threadCount) :
+        mTask(nullptr),
+        mCount(0),
+        mDynamic(false),
+        mRanges(new StealRange[(threadCount > 1) ? threadCount : 1]),
+        mGeneration(0),
+        mPending(0),
+        mStop(false)
+    {
+        std::size_t workers = (threadCount > 1) ? threadCount - 1 : 0;
+        mWorkers.reserve(workers);
+        for (std::size_t i = 0; i < workers; ++i)
+        {
+            mWorkers.emplace_back(&ThreadPool::workerLoop, this, i + 1);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mStart.notify_all();
+        for (auto& worker : mWorkers)
+        {
+            worker.join();
+        }
+    }
+
+    std::size_t ThreadPool::size() const
+    {
+        return mWorkers.size() + 1;
+    }
+
+    void ThreadPool::parallelFor(std::size_t count, Task const& task)
+    {
+        run(count, task, false);
+    }
+
+    void ThreadPool::parallelForDynamic(std::size_t count, Task const& task)
+    {
+        run(count, task, true);
+    }
+
+    void ThreadPool::run(std::size_t count, Task const& task, bool dynamic)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        if (mWorkers.empty())
+        {
+            task(0, count);
+            return;
+        }
+
+        //the chunks are handed out before any worker can look at them
+        mTask = &task;
+        mCount = count;
+        mDynamic = dynamic;
+        if (dynamic)
+        {
+            std::size_t threads = size();
+            for (std::size_t i = 0; i < threads; ++i)
+            {
+                mRanges[i].range.store(packRange((count * i) / threads,
+                    (count * (i + 1)) / threads), std::memory_order_relaxed);
+            }
+        }
+        mPending.store(mWorkers.size(), std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mGeneration.fetch_add(1, std::memory_order_release);
+        }
+        mStart.notify_all();
+
+        if (dynamic)
+        {
+            runStealing(0);
+        }
+        else
+        {
+            runChunk(0);
+        }
+
+        for (int spin = 0; spin < kSpinCount; ++spin)
+        {
+            if (mPending.load(std::memory_order_acquire) == 0)
+            {
+                return;
+            }
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [this]()
+        {
+            return mPending.load(std::memory_order_acquire) == 0;
+        });
+    }
+
+    void ThreadPool::workerLoop(std::size_t index)
+    {
+        std::uint64_t seen = 0;
+        for (;;)
+        {
+            std::uint64_t generation = mGeneration.load(std::memory_order_acquire);
+            for (int spin = 0; spin < kSpinCount && generation == seen; ++spin)
+            {
+                std::this_thread::yield();
+                generation = mGeneration.load(std::memory_order_acquire);
+            }
+
+            if (generation == seen)
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mStart.wait(lock, [this, seen]()
+                {
+                    return mStop ||
+                        mGeneration.load(std::memory_order_acquire) != seen;
+                });
+                if (mStop)
+                {
+                    return;
+                }
+                generation = mGeneration.load(std::memory_order_acquire);
+            }
+
+            seen = generation;
+            if (mDynamic)
+            {
+                runStealing(index);
+            }
+            else
+            {
+                runChunk(index);
+            }
+
+            if (mPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mDone.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::runChunk(std::size_t index)
+    {
+        std::size_t threads = size();
+        std::size_t begin = (mCount * index) / threads;
+        std::size_t end = (mCount * (index + 1)) / threads;
+        if (begin < end)
+        {
+            (*mTask)(begin, end);
+        }
+    }
+
+    void ThreadPool::runStealing(std::size_t index)
+    {
+        std::atomic<std::uint64_t>& own = mRanges[index].range;
+        do
+        {
+            std::uint64_t range = own.load(std::memory_order_acquire);
+            while (rangeBegin(range) < rangeEnd(range)){
+                std::uint64_t begin = rangeBegin(range);
+                if (own.compare_exchange_weak(range,
+                    packRange(begin + 1, rangeEnd(range)),
+                    std::memory_order_acq_rel, std::memory_order_acquire)){
+                    (*mTask)(begin, begin + 1);
+                    range = own.load(std::memory_order_acquire);
+                }
+            }
+        }
+        while (steal(index));
+    }
+
+    bool ThreadPool::steal(std::size_t index)
+    {
+        //only the owner ever stores into an empty range, so a thief never
+        //races with another thief for its own slot
+        std::size_t threads = size();
+        for (;;)
+        {
+            std::size_t victim = index;
+            std::uint64_t most = 0;
+            std::uint64_t range = 0;
+            for (std::size_t i = 0; i < threads; ++i)
+            {
+                std::uint64_t r = mRanges[i].range.load(std::memory_order_acquire);
+                std::uint64_t left = rangeEnd(r) - rangeBegin(r);
+                if (i != index && rangeBegin(r) < rangeEnd(r) && left > most)
+                {
+                    victim = i;
+                    most = left;
+                    range = r;
+                }
+            }
+            if (victim == index)
+            {
+                return false;
+            }
+
+            //the back half, or the last item when only one is left
+            std::uint64_t begin = rangeBegin(range);
+            std::uint64_t end = rangeEnd(range);
+            std::uint64_t middle = begin + (end - begin) / 2;
+            if (mRanges[victim].range.compare_exchange_strong(range,
+                packRange(begin, middle), std::memory_order_acq_rel,
+                std::memory_order_acquire))
+            {
+                mRanges[index].range.store(packRange(middle, end),
+                    std::memory_order_release);
+                return true;
+            }
+        }
+    }
+}
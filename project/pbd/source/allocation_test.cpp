@@ -0,0 +1,139 @@
+#include "AllocationCounter.hpp"
+#include "ClothBatch.hpp"
+#include "Scene.hpp"
+#include "SimulationThread.hpp"
+#include "Solver.hpp"
+
+#include <cstdio>
+#include <string>
+
+namespace
+{
+    const float kDt = 1.0f / 60.0f;
+    const int kSteps = 30;
+
+    void resetSimulation(pbd::Solver& solver)
+    {
+        solver.reset();
+    }
+
+    void resetSimulation(pbd::ClothBatch& batch)
+    {
+        std::string error;
+        batch.reset(error);
+    }
+
+    bool pooled(pbd::Solver const& solver)
+    {
+        return solver.storagePooled();
+    }
+
+    //every instance still in its slice of the batch's block
+    bool pooled(pbd::ClothBatch const& batch)
+    {
+        bool pooled = true;
+        for (std::size_t i = 0; i < batch.size(); i++){
+            pooled &= batch.instance(i).storagePooled();
+        }
+        return pooled;
+    }
+
+    //steps once to finish setting up, then checks that further steps, a
+    //reset and the steps after it leave allocationCount() where it was,
+    //and that the arrays are still all in the simulation's arena
+    template <typename Simulation>
+    bool stepsWithoutAllocating(const char* name, Simulation& simulation)
+    {
+        simulation.step(kDt);
+        std::size_t before = pbd::allocationCount();
+        for (int i = 0; i < kSteps; i++){
+            simulation.step(kDt);
+        }
+        resetSimulation(simulation);
+        for (int i = 0; i < kSteps; i++){
+            simulation.step(kDt);
+        }
+        std::size_t allocations = pbd::allocationCount() - before;
+        bool inArena = pooled(simulation);
+        std::printf("%-36s %zu allocations, %s\n", name, allocations,
+            inArena ? "pooled" : "not pooled");
+        return allocations == 0 && inArena;
+    }
+
+    //the frames a simulation thread publishes keep their positions in
+    //arenas of their own
+    bool framesPooled()
+    {
+        pbd::Solver solver;
+        solver.setGridSize(24, 24);
+        pbd::SimulationThread thread(solver, kDt);
+        bool inArena = true;
+        for (int i = 0; i < 4; i++){
+            thread.call([](pbd::Solver& s) { s.step(kDt); });
+            thread.update();
+            pbd::SimFrame const& frame = thread.frame();
+            for (auto const* values : {&frame.prevX, &frame.prevY, &frame.prevZ,
+                &frame.x, &frame.y, &frame.z}){
+                inArena &= frame.arena && frame.arena->owns(values->data());
+            }
+        }
+        std::printf("%-36s %s\n", "render staging", inArena ? "pooled" : "not pooled");
+        return inArena;
+    }
+
+    bool solverCase(const char* name, pbd::SolverMode mode, int threads)
+    {
+        pbd::Solver solver;
+        solver.setGridSize(24, 24);
+        solver.setSolverMode(mode);
+        solver.setThreadCount(threads);
+        solver.setMaxIterations(20);
+        return stepsWithoutAllocating(name, solver);
+    }
+}
+
+//checks that stepping and resetting set-up solvers never touch the heap
+//and keep their storage in their arenas. Linked with CountingNew.cpp, so
+//plain operator new is counted too.
+int main()
+{
+    using namespace pbd;
+    bool ok = true;
+    ok &= solverCase("gauss-seidel", SolverMode::GaussSeidel, 1);
+    ok &= solverCase("jacobi", SolverMode::Jacobi, 1);
+    ok &= solverCase("gauss-seidel, 4 threads", SolverMode::GaussSeidel, 4);
+    ok &= solverCase("jacobi, 4 threads", SolverMode::Jacobi, 4);
+
+    {
+        Solver solver;
+        solver.setGridSize(24, 24);
+        solver.setThreadCount(4);
+        solver.setMaxIterations(20);
+        solver.setTolerance(1e-3f, ErrorNorm::Rms);
+        solver.setHierarchy(3, 8);
+        solver.setAcceleration(Acceleration::Chebyshev, 0.0f);
+        solver.setDamping(1.0f);
+        solver.setSleeping(true, 0.05f, 0.01f, 5);
+        solver.setSelfCollision(true, 0.0f);
+        ok &= stepsWithoutAllocating("levels, chebyshev, sleeping, self", solver);
+    }
+
+    {
+        Scene scene;
+        scene.instances = 16;
+        scene.threads = 4;
+        scene.iterations = 20;
+        ClothBatch batch;
+        std::string error;
+        if (!batch.setUp(scene, error))
+        {
+            std::fprintf(stderr, "batch: %s\n", error.c_str());
+            return 1;
+        }
+        ok &= stepsWithoutAllocating("batch of 16, 4 threads", batch);
+    }
+
+    ok &= framesPooled();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,351 @@
+#include "AllocationCounter.hpp"
+#include "ObjFile.hpp"
+#include "Solver.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    void printUsage(const char* name)
+    {
+        std::fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --sizes LIST        grid resolutions, N means N x N (32,64,128,256,512,1024)\n"
+            "  --iterations LIST   iterations per step (20)\n"
+            "  --threads LIST      solver threads, 0 means all cores (1,0)\n"
+            "  --modes LIST        gs and/or jacobi (gs,jacobi)\n"
+            "  --levels LIST       hierarchy levels, 1 solves the full cloth only (1)\n"
+            "  --tolerance E       stop iterating below this max stretch error, so\n"
+            "                      iterations are a ceiling (0, off)\n"
+            "  --self-collision    run particle self collision as well (off)\n"
+            "  --accel NAME        none, chebyshev or momentum iterations (none)\n"
+            "  --orders LIST       particle orders: input, morton, rcm (input)\n"
+            "  --mesh FILE         OBJ mesh to run instead of the grid sizes\n"
+            "  --min-steps N       steps measured per run at least (3)\n"
+            "  --min-time S        seconds measured per run at least (1)\n"
+            "  --format csv|json   output format (csv)\n"
+            "  --out FILE          output file (stdout)\n",
+            name);
+    }
+
+    //comma separated list of non-negative integers
+    bool parseList(const char* text, std::vector<int>& out)
+    {
+        out.clear();
+        while (*text){
+            char* end;
+            long value = std::strtol(text, &end, 10);
+            if (end == text || value < 0){
+                return false;
+            }
+            out.push_back((int)value);
+            text = (*end == ',') ? end + 1 : end;
+            if (*end != ',' && *end != '\0'){
+                return false;
+            }
+        }
+        return !out.empty();
+    }
+
+    //peak resident set size of the process so far in KiB. It never goes
+    //down, so with sizes swept in increasing order each row shows the peak
+    //of its own run.
+    long peakRssKb()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return (long)(counters.PeakWorkingSetSize / 1024);
+        }
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+#endif
+    }
+
+    struct Result
+    {
+        int size;
+        const char* mode;
+        const char* order;
+        int threads;
+        int iterations;
+        int levels;
+        const char* acceleration;
+        double iterationsPerStep;
+        const char* kernel;
+        std::size_t particles;
+        std::size_t constraints;
+        int steps;
+        double seconds;
+        double nsPerConstraintIteration;
+        double stepsPerSecond;
+        long peakRssKb;
+        std::size_t allocations;
+    };
+}
+
+//sweeps grid size, iteration count, thread count and solver mode and
+//reports solver throughput for each combination
+int main(int argc, char** argv)
+{
+    using namespace pbd;
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<int> sizes = {32, 64, 128, 256, 512, 1024};
+    std::vector<int> iterations = {20};
+    std::vector<int> threads = {1, 0};
+    std::vector<int> levels = {1};
+    float tolerance = 0.0f;
+    Acceleration acceleration = Acceleration::None;
+    bool selfCollision = false;
+    const char* accelerationName = "none";
+    std::vector<SolverMode> modes = {SolverMode::GaussSeidel, SolverMode::Jacobi};
+    std::vector<ParticleOrder> orders = {ParticleOrder::Input};
+    const char* meshPath = nullptr;
+    int minSteps = 3;
+    double minTime = 1.0;
+    bool json = false;
+    const char* outPath = nullptr;
+    const float dt = 1.0f / 60.0f;
+
+    for (int i = 1; i < argc; i++){
+        bool hasValue = i + 1 < argc;
+        bool ok = hasValue;
+        if (!std::strcmp(argv[i], "--sizes") && hasValue){
+            ok = parseList(argv[++i], sizes);
+        }else if (!std::strcmp(argv[i], "--iterations") && hasValue){
+            ok = parseList(argv[++i], iterations);
+        }else if (!std::strcmp(argv[i], "--threads") && hasValue){
+            ok = parseList(argv[++i], threads);
+        }else if (!std::strcmp(argv[i], "--levels") && hasValue){
+            ok = parseList(argv[++i], levels);
+        }else if (!std::strcmp(argv[i], "--tolerance") && hasValue){
+            tolerance = (float)std::atof(argv[++i]);
+            ok = tolerance >= 0.0f;
+        }else if (!std::strcmp(argv[i], "--self-collision")){
+            selfCollision = true;
+            ok = true;
+        }else if (!std::strcmp(argv[i], "--accel") && hasValue){
+            accelerationName = argv[++i];
+            if (!std::strcmp(accelerationName, "chebyshev")){
+                acceleration = Acceleration::Chebyshev;
+            }else if (!std::strcmp(accelerationName, "momentum")){
+                acceleration = Acceleration::Momentum;
+            }else{
+                ok = !std::strcmp(accelerationName, "none");
+            }
+        }else if (!std::strcmp(argv[i], "--modes") && hasValue){
+            std::string list = argv[++i];
+            modes.clear();
+            std::size_t start = 0;
+            while (ok && start <= list.size()){
+                std::size_t comma = list.find(',', start);
+                std::string name = list.substr(start, comma - start);
+                if (name == "gs"){
+                    modes.push_back(SolverMode::GaussSeidel);
+                }else if (name == "jacobi"){
+                    modes.push_back(SolverMode::Jacobi);
+                }else{
+                    ok = false;
+                }
+                start = (comma == std::string::npos) ? list.size() + 1 : comma + 1;
+            }
+        }else if (!std::strcmp(argv[i], "--orders") && hasValue){
+            std::string list = argv[++i];
+            orders.clear();
+            std::size_t start = 0;
+            while (ok && start <= list.size()){
+                std::size_t comma = list.find(',', start);
+                std::string name = list.substr(start, comma - start);
+                ok = false;
+                for (int o = 0; o <= (int)ParticleOrder::Rcm; o++){
+                    if (name == particleOrderName((ParticleOrder)o)){
+                        orders.push_back((ParticleOrder)o);
+                        ok = true;
+                    }
+                }
+                start = (comma == std::string::npos) ? list.size() + 1 : comma + 1;
+            }
+        }else if (!std::strcmp(argv[i], "--mesh") && hasValue){
+            meshPath = argv[++i];
+        }else if (!std::strcmp(argv[i], "--min-steps") && hasValue){
+            minSteps = std::atoi(argv[++i]);
+            ok = minSteps > 0;
+        }else if (!std::strcmp(argv[i], "--min-time") && hasValue){
+            minTime = std::atof(argv[++i]);
+        }else if (!std::strcmp(argv[i], "--format") && hasValue){
+            const char* name = argv[++i];
+            json = !std::strcmp(name, "json");
+            ok = json || !std::strcmp(name, "csv");
+        }else if (!std::strcmp(argv[i], "--out") && hasValue){
+            outPath = argv[++i];
+        }else{
+            ok = false;
+        }
+
+        if (!ok){
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    //0 stands for every core; counts that resolve to the same number are
+    //only run once
+    int cores = (int)std::thread::hardware_concurrency();
+    cores = (cores > 0) ? cores : 1;
+    std::vector<int> threadCounts;
+    for (int t : threads){
+        t = (t > 0) ? t : cores;
+        if (std::find(threadCounts.begin(), threadCounts.end(), t) == threadCounts.end()){
+            threadCounts.push_back(t);
+        }
+    }
+
+    //a mesh is reported as size 0
+    std::vector<Vector3> meshVertices;
+    std::vector<unsigned int> meshTriangles;
+    if (meshPath)
+    {
+        if (!loadObj(meshPath, meshVertices, meshTriangles))
+        {
+            std::fprintf(stderr, "could not load %s\n", meshPath);
+            return 1;
+        }
+        sizes = {0};
+    }
+
+    std::vector<Result> results;
+    for (int size : sizes){
+        //one solver per size, the cloth is rebuilt by every reset
+        Solver solver;
+        if (meshPath)
+        {
+            solver.setClothMesh(meshVertices, meshTriangles);
+        }
+        else
+        {
+            solver.setGridSize(size, size);
+        }
+        solver.setSpherePosition(Vector3(-5.0f, 0.0f, 0.0f));
+
+        for (ParticleOrder order : orders){
+            solver.setParticleOrder(order);
+            for (SolverMode mode : modes){
+                for (int threadCount : threadCounts){
+                    for (int iterationCount : iterations){
+                        for (int levelCount : levels){
+                            solver.reset();
+                            solver.setSolverMode(mode);
+                            solver.setThreadCount(threadCount);
+                            solver.setMaxIterations(iterationCount);
+                            solver.setTolerance(tolerance, ErrorNorm::Max);
+                            solver.setHierarchy(levelCount, solver.coarseIterations());
+                            solver.setAcceleration(acceleration, 0.0f);
+                            solver.setSelfCollision(selfCollision, solver.selfCollisionThickness());
+
+                            //one untimed step warms the caches and the thread pool
+                            solver.step(dt);
+
+                            int steps = 0;
+                            long solved = 0;
+                            std::size_t allocated = allocationCount();
+                            auto start = Clock::now();
+                            std::chrono::duration<double> elapsed(0.0);
+                            while (steps < minSteps || elapsed.count() < minTime){
+                                solver.step(dt);
+                                solved += solver.lastStepStats().iterations;
+                                steps++;
+                                elapsed = Clock::now() - start;
+                            }
+
+                            Result r;
+                            r.size = size;
+                            r.mode = (mode == SolverMode::Jacobi) ? "jacobi" : "gs";
+                            r.order = particleOrderName(order);
+                            r.threads = solver.threadCount();
+                            r.iterations = iterationCount;
+                            r.levels = solver.builtLevels();
+                            r.acceleration = accelerationName;
+                            r.iterationsPerStep = (double)solved/steps;
+                            r.kernel = solver.kernelName();
+                            r.particles = solver.particles().size();
+                            r.constraints = solver.constraints().size() +
+                                solver.bendingConstraints().size();
+                            r.steps = steps;
+                            r.seconds = elapsed.count();
+                            r.nsPerConstraintIteration = elapsed.count()*1e9/
+                                ((double)solved*r.constraints);
+                            r.stepsPerSecond = steps/elapsed.count();
+                            r.peakRssKb = peakRssKb();
+                            r.allocations = allocationCount() - allocated;
+                            results.push_back(r);
+
+                            std::fprintf(stderr, "%dx%d %s %s %d threads %d iterations %d levels %s: %.2f ns/constraint/iteration, %.2f iterations/step, %.2f steps/s\n",
+                                size, size, r.mode, r.order, r.threads, iterationCount, r.levels, r.acceleration,
+                                r.nsPerConstraintIteration, r.iterationsPerStep, r.stepsPerSecond);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::FILE* out = outPath ? std::fopen(outPath, "w") : stdout;
+    if (!out)
+    {
+        std::fprintf(stderr, "could not open %s for writing\n", outPath);
+        return 1;
+    }
+
+    if (json){
+        std::fprintf(out, "[\n");
+        for (std::size_t k = 0; k < results.size(); k++){
+            Result const& r = results[k];
+            std::fprintf(out, "  {\"size\": %d, \"mode\": \"%s\", \"order\": \"%s\", \"threads\": %d, \"iterations\": %d, "
+                "\"levels\": %d, \"acceleration\": \"%s\", \"iterations_per_step\": %.4f, \"kernel\": \"%s\", \"particles\": %zu, \"constraints\": %zu, \"steps\": %d, "
+                "\"seconds\": %.6f, \"ns_per_constraint_iteration\": %.4f, "
+                "\"steps_per_second\": %.4f, \"peak_rss_kb\": %ld, \"allocations\": %zu}%s\n",
+                r.size, r.mode, r.order, r.threads, r.iterations, r.levels, r.acceleration,
+                r.iterationsPerStep, r.kernel, r.particles, r.constraints, r.steps, r.seconds,
+                r.nsPerConstraintIteration,
+                r.stepsPerSecond, r.peakRssKb, r.allocations, (k + 1 < results.size()) ? "," : "");
+        }
+        std::fprintf(out, "]\n");
+    }else{
+        std::fprintf(out, "size,mode,order,threads,iterations,levels,acceleration,iterations_per_step,kernel,particles,constraints,steps,seconds,ns_per_constraint_iteration,steps_per_second,peak_rss_kb,allocations\n");
+        for (Result const& r : results){
+            std::fprintf(out, "%d,%s,%s,%d,%d,%d,%s,%.4f,%s,%zu,%zu,%d,%.6f,%.4f,%.4f,%ld,%zu\n",
+                r.size, r.mode, r.order, r.threads, r.iterations, r.levels, r.acceleration,
+                r.iterationsPerStep, r.kernel, r.particles,
+                r.constraints, r.steps, r.seconds, r.nsPerConstraintIteration,
+                r.stepsPerSecond, r.peakRssKb, r.allocations);
+        }
+    }
+
+    if (out != stdout){
+        std::fclose(out);
+    }
+    return 0;
+}
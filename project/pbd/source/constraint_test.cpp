@@ -0,0 +1,154 @@
+#include "Constraint.hpp"
+#include "Solver.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace
+{
+    const float kTolerance = 1e-5f;
+    const int kMeshSide = 8;
+    const int kSteps = 30;
+
+    //largest entry of the energy gradient q x at the rest shape, which
+    //has to vanish for a flat pair of triangles. Measured from the first
+    //point like the solver does.
+    float restGradient(pbd::BendingConstraint const& bend, float const* x,
+        float const* y, float const* z)
+    {
+        float largest = 0.0f;
+        for (int i = 0; i < 4; ++i){
+            float g[3] = {0.0f, 0.0f, 0.0f};
+            for (int j = 0; j < 4; ++j){
+                int p = bend.p[j];
+                int o = bend.p[0];
+                g[0] += bend.q[i][j]*(x[p] - x[o]);
+                g[1] += bend.q[i][j]*(y[p] - y[o]);
+                g[2] += bend.q[i][j]*(z[p] - z[o]);
+            }
+            for (int k = 0; k < 3; ++k){
+                largest = std::fmax(largest, std::fabs(g[k]));
+            }
+        }
+        return largest;
+    }
+
+    //largest entry of q, which the energy and gradient errors scale with
+    float largestWeight(pbd::BendingConstraint const& bend)
+    {
+        float largest = 0.0f;
+        for (int i = 0; i < 4; ++i){
+            for (int j = 0; j < 4; ++j){
+                largest = std::fmax(largest, std::fabs(bend.q[i][j]));
+            }
+        }
+        return largest;
+    }
+
+    //checks a bending constraint built on four points in the y = 0 plane
+    bool flatCase(const char* name, float const* x, float const* z)
+    {
+        float y[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        pbd::BendingConstraint bend = pbd::makeBendingConstraint(0, 1, 2, 3,
+            x, y, z);
+        float gradient = restGradient(bend, x, y, z);
+        std::printf("%-32s energy %g, gradient %g\n", name, bend.rest, gradient);
+        float tolerance = kTolerance*largestWeight(bend);
+        return std::fabs(bend.rest) < tolerance && gradient < tolerance;
+    }
+
+    //flat mesh in the plane y = height on a jittered grid whose cells are
+    //split along either diagonal, so no two triangles are alike
+    void irregularMesh(float height, std::vector<pbd::Vector3>& vertices,
+        std::vector<unsigned int>& triangles)
+    {
+        for (int i = 0; i < kMeshSide; ++i){
+            for (int j = 0; j < kMeshSide; ++j){
+                float jx = 0.3f*std::sin(1.7f*i + 3.1f*j);
+                float jz = 0.3f*std::cos(2.3f*i - 1.3f*j);
+                vertices.push_back(pbd::Vector3(i + jx, height, j + jz));
+            }
+        }
+        for (int i = 0; i + 1 < kMeshSide; ++i){
+            for (int j = 0; j + 1 < kMeshSide; ++j){
+                unsigned int a = i*kMeshSide + j;
+                unsigned int b = a + kMeshSide;
+                unsigned int c = b + 1;
+                unsigned int d = a + 1;
+                if ((i*3 + j*5) % 4 < 2){
+                    triangles.insert(triangles.end(), {a, b, c, a, c, d});
+                }else{
+                    triangles.insert(triangles.end(), {a, b, d, b, c, d});
+                }
+            }
+        }
+    }
+
+    //bending constraints of the irregular mesh, and a solver built from it
+    //without gravity, which has to leave the cloth where it is
+    bool meshCase()
+    {
+        std::vector<pbd::Vector3> vertices;
+        std::vector<unsigned int> triangles;
+        irregularMesh(20.0f, vertices, triangles);
+
+        std::vector<float> x, y, z;
+        for (auto const& v : vertices){
+            x.push_back(v.x);
+            y.push_back(v.y);
+            z.push_back(v.z);
+        }
+        pbd::BendingList bendings = pbd::buildBendingConstraints(triangles,
+            x.data(), y.data(), z.data());
+        //errors relative to the constraint's own weights, since the thin
+        //triangles of the mesh have large cotangents
+        float energy = 0.0f;
+        float gradient = 0.0f;
+        for (auto const& bend : bendings){
+            float weight = largestWeight(bend);
+            energy = std::fmax(energy, std::fabs(bend.rest)/weight);
+            gradient = std::fmax(gradient, restGradient(bend, x.data(),
+                y.data(), z.data())/weight);
+        }
+        std::printf("%-32s relative energy %g, gradient %g\n", "irregular mesh",
+            energy, gradient);
+
+        pbd::Solver solver;
+        solver.setClothMesh(vertices, triangles);
+        solver.setGravity(0.0f);
+        for (int i = 0; i < kSteps; ++i){
+            solver.step(1.0f/60.0f);
+        }
+        pbd::ParticleSet const& particles = solver.particles();
+        std::vector<int> const& input = solver.inputIndices();
+        float drift = 0.0f;
+        for (std::size_t i = 0; i < particles.size(); ++i){
+            drift = std::fmax(drift, mag(particles.position(i) - vertices[input[i]]));
+        }
+        std::printf("%-32s drift %g after %d steps\n", "irregular mesh at rest",
+            drift, kSteps);
+
+        return !bendings.empty() && energy < kTolerance &&
+            gradient < kTolerance && drift < kTolerance;
+    }
+}
+
+//checks that flat rest shapes give bending constraints with no energy and
+//no force, so a flat cloth is not pushed out of its plane
+int main()
+{
+    bool ok = true;
+    {
+        float x[4] = {0.0f, 1.0f, 0.0f, 1.0f};
+        float z[4] = {0.0f, 0.0f, 1.0f, -1.0f};
+        ok &= flatCase("grid quad", x, z);
+    }
+    {
+        float x[4] = {0.0f, 1.0f, 0.1f, 0.9f};
+        float z[4] = {0.0f, 0.0f, 2.0f, -0.5f};
+        ok &= flatCase("asymmetric quad", x, z);
+    }
+    ok &= meshCase();
+    return ok ? 0 : 1;
+}
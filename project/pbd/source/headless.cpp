@@ -0,0 +1,334 @@
+#include "AllocationCounter.hpp"
+#include "ClothBatch.hpp"
+#include "Scene.hpp"
+#include "SimCache.hpp"
+#include "Solver.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    void printUsage(const char* name)
+    {
+        std::fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --scene FILE      scene to run, see data/drape.scene; the other\n"
+            "                    options override it\n"
+            "  --steps N         number of steps to run (600)\n"
+            "  --mesh FILE       OBJ mesh to use as the cloth instead of the grid\n"
+            "  --order NAME      particle order: input, morton or rcm (input)\n"
+            "  --out FILE        per-step timings CSV (timings.csv)\n"
+            "  --threads N       solver threads, 0 for every core (1)\n"
+            "  --instances N     independent copies of the cloth, spread over the\n"
+            "                    threads one whole cloth at a time (1)\n"
+            "  --mode gs|jacobi  constraint solver (gs)\n"
+            "  --substeps N      substeps per step (1)\n"
+            "  --iterations N    maximum iterations per substep (100)\n"
+            "  --tolerance E     stop iterating below this stretch error (0, off)\n"
+            "  --norm max|rms    error norm used with --tolerance (max)\n"
+            "  --levels N        solve N-1 coarser copies of the cloth before each\n"
+            "                    substep's iterations (1, off)\n"
+            "  --accel NAME      none, chebyshev or momentum iterations (none)\n"
+            "  --self-collision  keep the cloth from passing through itself (off)\n"
+            "  --sleep           stop simulating tiles of cloth at rest (off)\n"
+            "  --structural C    compliance of a constraint family, or off to\n"
+            "  --shear C         leave the family out (0, 0.01, 0.1)\n"
+            "  --bending C\n"
+            "  --trace FILE      Chrome trace of the solver phases (off)\n"
+            "  --record FILE     cache every step's positions for playback (off)\n"
+            "  --quantize        store the cache with 16 bit positions\n"
+            "  --restore FILE    start from a checkpoint instead of the flat grid;\n"
+            "                    its settings stay unless given here or in the scene\n"
+            "  --checkpoint FILE save the state after the last step (off)\n",
+            name);
+    }
+
+    //ParticleOrder called name, or -1
+    int particleOrder(const char* name)
+    {
+        for (int o = 0; o <= (int)pbd::ParticleOrder::Rcm; o++){
+            if (!std::strcmp(name, pbd::particleOrderName((pbd::ParticleOrder)o))){
+                return o;
+            }
+        }
+        return -1;
+    }
+
+    //index of the ConstraintType named by a --structural/--shear/--bending
+    //flag, or -1
+    int constraintFamily(const char* flag)
+    {
+        for (int t = 0; t < pbd::kConstraintTypeCount; t++){
+            if (flag[0] == '-' && flag[1] == '-' &&
+                !std::strcmp(flag + 2, pbd::constraintTypeName((pbd::ConstraintType)t))){
+                return t;
+            }
+        }
+        return -1;
+    }
+}
+
+//runs the cloth solver without a window and writes per-step timings. The
+//setup comes from the scene file given with --scene, if any; the other
+//flags override it.
+int main(int argc, char** argv)
+{
+    using namespace pbd;
+    using Clock = std::chrono::steady_clock;
+
+    Scene scene;
+    std::string error;
+    for (int i = 1; i + 1 < argc; i++){
+        if (!std::strcmp(argv[i], "--scene") && !loadScene(argv[i + 1], scene, error)){
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    if (scene.timings.empty())
+    {
+        scene.timings = "timings.csv";
+    }
+    if (!scene.threads.set)
+    {
+        scene.threads = 1;
+    }
+
+    int family;
+    for (int i = 1; i < argc; i++){
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--scene") && hasValue){
+            ++i;
+        }else if (!std::strcmp(argv[i], "--steps") && hasValue){
+            scene.steps = std::atoi(argv[++i]);
+        }else if (!std::strcmp(argv[i], "--mesh") && hasValue){
+            scene.mesh = argv[++i];
+        }else if (!std::strcmp(argv[i], "--order") && hasValue){
+            int order = particleOrder(argv[++i]);
+            if (order < 0){
+                printUsage(argv[0]);
+                return 1;
+            }
+            scene.order = (ParticleOrder)order;
+        }else if (!std::strcmp(argv[i], "--out") && hasValue){
+            scene.timings = argv[++i];
+        }else if (!std::strcmp(argv[i], "--trace") && hasValue){
+            scene.trace = argv[++i];
+        }else if (!std::strcmp(argv[i], "--record") && hasValue){
+            scene.record = argv[++i];
+        }else if (!std::strcmp(argv[i], "--quantize")){
+            scene.quantize = true;
+        }else if (!std::strcmp(argv[i], "--self-collision")){
+            scene.selfCollision = true;
+        }else if (!std::strcmp(argv[i], "--sleep")){
+            scene.sleep = true;
+        }else if (!std::strcmp(argv[i], "--restore") && hasValue){
+            scene.state = argv[++i];
+        }else if (!std::strcmp(argv[i], "--checkpoint") && hasValue){
+            scene.checkpoint = argv[++i];
+        }else if (!std::strcmp(argv[i], "--threads") && hasValue){
+            scene.threads = std::atoi(argv[++i]);
+        }else if (!std::strcmp(argv[i], "--instances") && hasValue){
+            scene.instances = std::atoi(argv[++i]);
+        }else if (!std::strcmp(argv[i], "--mode") && hasValue){
+            const char* name = argv[++i];
+            if (!std::strcmp(name, "jacobi")){
+                scene.mode = SolverMode::Jacobi;
+            }else if (!std::strcmp(name, "gs")){
+                scene.mode = SolverMode::GaussSeidel;
+            }else{
+                printUsage(argv[0]);
+                return 1;
+            }
+        }else if (!std::strcmp(argv[i], "--substeps") && hasValue){
+            scene.substeps = std::atoi(argv[++i]);
+        }else if (!std::strcmp(argv[i], "--iterations") && hasValue){
+            scene.iterations = std::atoi(argv[++i]);
+        }else if (!std::strcmp(argv[i], "--tolerance") && hasValue){
+            scene.tolerance = (float)std::atof(argv[++i]);
+        }else if (!std::strcmp(argv[i], "--levels") && hasValue){
+            scene.levels = std::atoi(argv[++i]);
+        }else if (!std::strcmp(argv[i], "--accel") && hasValue){
+            const char* name = argv[++i];
+            if (!std::strcmp(name, "none")){
+                scene.acceleration = Acceleration::None;
+            }else if (!std::strcmp(name, "chebyshev")){
+                scene.acceleration = Acceleration::Chebyshev;
+            }else if (!std::strcmp(name, "momentum")){
+                scene.acceleration = Acceleration::Momentum;
+            }else{
+                printUsage(argv[0]);
+                return 1;
+            }
+        }else if (!std::strcmp(argv[i], "--norm") && hasValue){
+            const char* name = argv[++i];
+            if (!std::strcmp(name, "rms")){
+                scene.norm = ErrorNorm::Rms;
+            }else if (!std::strcmp(name, "max")){
+                scene.norm = ErrorNorm::Max;
+            }else{
+                printUsage(argv[0]);
+                return 1;
+            }
+        }else if ((family = constraintFamily(argv[i])) >= 0 && hasValue){
+            const char* value = argv[++i];
+            if (!std::strcmp(value, "off")){
+                scene.enabled[family] = false;
+            }else{
+                scene.enabled[family] = true;
+                scene.compliance[family] = (float)std::atof(value);
+            }
+        }else{
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    int steps = scene.steps;
+    const float dt = scene.stepSize;
+    const char* outPath = scene.timings.c_str();
+    const char* tracePath = scene.trace.empty() ? nullptr : scene.trace.c_str();
+    const char* cachePath = scene.record.empty() ? nullptr : scene.record.c_str();
+    const char* checkpointPath = scene.checkpoint.empty() ? nullptr : scene.checkpoint.c_str();
+    if (steps <= 0 || scene.instances <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    //a batch is stepped as a whole; tracing, recording and checkpoints
+    //follow a single solver
+    bool batched = scene.instances > 1;
+    if (batched && (tracePath || cachePath || checkpointPath))
+    {
+        std::fprintf(stderr, "--trace, --record and --checkpoint need a single instance\n");
+        return 1;
+    }
+
+    //the ring keeps only the newest events, about the last two thousand
+    //steps at the default iteration count
+    std::unique_ptr<Profiler> profiler;
+    Solver solver;
+    ClothBatch batch;
+    if (tracePath)
+    {
+        profiler.reset(new Profiler(1 << 20));
+        solver.setProfiler(profiler.get());
+    }
+    if (batched ? !batch.setUp(scene, error) : !applyScene(scene, solver, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    //the cache starts with the initial state, frame k is the state after
+    //k steps
+    SimCacheWriter cache;
+    if (cachePath)
+    {
+        if (!cache.open(cachePath, solver.particles().size(), dt, scene.quantize) ||
+            !cache.append(solver.particles()))
+        {
+            std::fprintf(stderr, "could not open %s for writing\n", cachePath);
+            return 1;
+        }
+    }
+
+    std::vector<double> timings(steps);
+    std::vector<StepStats> stats(steps);
+    std::vector<std::size_t> allocations(steps);
+    long totalIterations = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < steps; i++){
+        std::size_t allocated = allocationCount();
+        auto before = Clock::now();
+        if (batched)
+        {
+            batch.step(dt);
+        }
+        else
+        {
+            solver.step(dt);
+        }
+        std::chrono::duration<double, std::milli> elapsed = Clock::now() - before;
+        timings[i] = elapsed.count();
+        allocations[i] = allocationCount() - allocated;
+        stats[i] = batched ? batch.lastStepStats() : solver.lastStepStats();
+        totalIterations += stats[i].iterations;
+        if (cachePath && !cache.append(solver.particles()))
+        {
+            std::fprintf(stderr, "could not write to %s\n", cachePath);
+            return 1;
+        }
+    }
+    if (!cache.close())
+    {
+        std::fprintf(stderr, "could not write to %s\n", cachePath);
+        return 1;
+    }
+    std::chrono::duration<double, std::milli> total = Clock::now() - start;
+    if (checkpointPath && !solver.saveCheckpoint(checkpointPath))
+    {
+        std::fprintf(stderr, "could not write checkpoint to %s\n", checkpointPath);
+        return 1;
+    }
+
+    std::FILE* out = std::fopen(outPath, "w");
+    if (!out)
+    {
+        std::fprintf(stderr, "could not open %s for writing\n", outPath);
+        return 1;
+    }
+    std::fprintf(out, "step,ms,iterations,max_error,rms_error,allocations,sleeping_tiles\n");
+    for (int i = 0; i < steps; i++){
+        std::fprintf(out, "%d,%.6f,%d,%g,%g,%zu,%d\n", i, timings[i],
+            stats[i].iterations, stats[i].maxError, stats[i].rmsError, allocations[i],
+            stats[i].sleepingTiles);
+    }
+    std::fclose(out);
+
+    if (profiler && !profiler->writeChromeTrace(tracePath))
+    {
+        std::fprintf(stderr, "could not write trace to %s\n", tracePath);
+        return 1;
+    }
+
+    //the first step may still size scratch space for colliders added
+    //after the cloth was built; every later one should allocate nothing
+    std::size_t steadyAllocations = 0;
+    for (int i = 1; i < steps; i++){
+        steadyAllocations += allocations[i];
+    }
+
+    if (batched)
+    {
+        std::printf("%d steps of %zu instances, %zu particles (%s kernel, %d threads) in %.3f ms (%.3f ms/step, %.1f iterations/step per instance)\n",
+            steps, batch.size(), batch.vertexCount(),
+            batch.instance(0).kernelName(), batch.threadCount(), total.count(),
+            total.count() / steps, (double)totalIterations / steps / batch.size());
+    }
+    else
+    {
+        std::printf("%d steps of %zu particles (%s kernel, %d threads) in %.3f ms (%.3f ms/step, %.1f iterations/step)\n",
+            steps, solver.particles().size(), solver.kernelName(),
+            solver.threadCount(), total.count(), total.count() / steps,
+            (double)totalIterations / steps);
+    }
+    std::printf("%zu heap allocations after the first step\n", steadyAllocations);
+    if (scene.sleep.value)
+    {
+        std::printf("%d sleeping tiles after the last step\n",
+            stats[steps - 1].sleepingTiles);
+    }
+    if (!batched && solver.acceleration() != Acceleration::None)
+    {
+        std::printf("spectral radius %.4f, %d substeps fell back to plain iterations\n",
+            solver.spectralRadius(), solver.accelerationFallbacks());
+    }
+    return 0;
+}
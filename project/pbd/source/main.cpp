@@ -1,10 +1,14 @@
 #include "ClothScene.hpp"
+#include "Scene.hpp"
 
 #include <atlas/utils/Application.hpp>
 #include <atlas/utils/WindowSettings.hpp>
 #include <atlas/gl/ErrorCheck.hpp>
 
-int main()
+#include <cstdio>
+
+//pbd [scene file], see data/drape.scene
+int main(int argc, char** argv)
 {
     using atlas::utils::WindowSettings;
     using atlas::utils::ContextVersion;
@@ -12,6 +16,14 @@ int main()
     using atlas::utils::ScenePointer;
     using namespace pbd;
 
+    Scene scene;
+    std::string error;
+    if (argc > 1 && !loadScene(argv[1], scene, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
     atlas::gl::setGLErrorSeverity(
         ATLAS_GL_ERROR_SEVERITY_HIGH | ATLAS_GL_ERROR_SEVERITY_MEDIUM);
 
@@ -22,7 +34,7 @@ int main()
     settings.isMaximized = true;
 
     Application::getInstance().createWindow(settings);
-    Application::getInstance().addScene(ScenePointer(new ClothScene));
+    Application::getInstance().addScene(ScenePointer(new ClothScene(scene)));
     Application::getInstance().runApplication();
 
     return 0;